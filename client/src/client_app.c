@@ -9,6 +9,7 @@
 // --- プロトタイプ宣言 ---
 static void handle_input_commands();
 static void process_command(const char* json_command);
+static int send_in_state(const Message* msg, ClientState pending);
 static void cleanup();
 
 // --- グローバル変数 ---
@@ -85,6 +86,7 @@ static void process_command(const char* json_command) {
     int roomId = -1;
     int row = -1, col = -1;
     int agree = -1;           // 0 or 1 for boolean
+    int moveTimeMs = 0;       // addAi 用 (0 ならサーバーの既定値)
     char serverIp[64] = {0};  // connect 用
     int serverPort = -1;      // connect 用
     char chatMessage[sizeof(((ChatMessageSendRequestData*)0)->message_text)] = {
@@ -125,6 +127,32 @@ static void process_command(const char* json_command) {
                 return;
             }
         }
+    } else if (strcmp(command, "addAi") == 0) {
+        const char* id_ptr = strstr(json_command, "\"roomId\":");
+        const char* time_ptr = strstr(json_command, "\"moveTimeMs\":");
+        if (id_ptr) {
+            sscanf(id_ptr + strlen("\"roomId\":"), "%d", &roomId);
+        } else {
+            roomId = get_my_room_id();
+            if (roomId == -1) {
+                send_error_event("Invalid 'addAi' command: Not in a room.");
+                return;
+            }
+        }
+        if (time_ptr) {
+            sscanf(time_ptr + strlen("\"moveTimeMs\":"), "%d", &moveTimeMs);
+        }
+    } else if (strcmp(command, "analyze") == 0) {
+        const char* id_ptr = strstr(json_command, "\"roomId\":");
+        if (id_ptr) {
+            sscanf(id_ptr + strlen("\"roomId\":"), "%d", &roomId);
+        } else {
+            roomId = get_my_room_id();
+            if (roomId == -1) {
+                send_error_event("Invalid 'analyze' command: Not in a room.");
+                return;
+            }
+        }
     } else if (strcmp(command, "place") == 0) {
         const char* id_ptr = strstr(json_command, "\"roomId\":");
         const char* row_ptr = strstr(json_command, "\"row\":");
@@ -328,17 +356,13 @@ static void process_command(const char* json_command) {
                 msg.data.createRoomReq
                     .roomName[sizeof(msg.data.createRoomReq.roomName) - 1] =
                     '\0';
-                if (send_message_to_server(&msg)) {
-                    set_client_state(STATE_CREATING_ROOM);
-                    send_state_change_event();
-                }
+                // 応答が先に届いても取りこぼさないよう、送信前に状態を遷移させる
+                // (送信に失敗したら send_in_state が元の状態に戻す)
+                send_in_state(&msg, STATE_CREATING_ROOM);
             } else if (strcmp(command, "join") == 0 && roomId != -1) {
                 msg.type = MSG_JOIN_ROOM_REQUEST;
                 msg.data.joinRoomReq.roomId = roomId;
-                if (send_message_to_server(&msg)) {
-                    set_client_state(STATE_JOINING_ROOM);
-                    send_state_change_event();
-                }
+                send_in_state(&msg, STATE_JOINING_ROOM);
             } else {
                 send_error_event("Invalid command '%s' in state Lobby.",
                                  command);
@@ -353,6 +377,13 @@ static void process_command(const char* json_command) {
                     // set_client_state(STATE_STARTING_GAME);
                     // send_state_change_event();
                 }
+            } else if (current_color == 1 && strcmp(command, "addAi") == 0 &&
+                       current_room_id == roomId) {
+                // 成功すると相手参加通知 (MSG_PLAYER_JOINED_NOTICE) が届く
+                msg.type = MSG_ADD_AI_REQUEST;
+                msg.data.addAiReq.roomId = current_room_id;
+                msg.data.addAiReq.moveTimeMs = moveTimeMs;
+                send_message_to_server(&msg);
             } else {
                 send_error_event("Invalid command '%s' in state WaitingInRoom.",
                                  command);
@@ -367,10 +398,7 @@ static void process_command(const char* json_command) {
                     msg.data.placePieceReq.roomId = current_room_id;
                     msg.data.placePieceReq.row = (uint8_t)row;
                     msg.data.placePieceReq.col = (uint8_t)col;
-                    if (send_message_to_server(&msg)) {
-                        set_client_state(STATE_PLACING_PIECE);
-                        send_state_change_event();
-                    }
+                    send_in_state(&msg, STATE_PLACING_PIECE);
                 } else {
                     send_error_event("Invalid coordinates (%d, %d).", row, col);
                 }
@@ -385,10 +413,13 @@ static void process_command(const char* json_command) {
                 msg.type = MSG_REMATCH_REQUEST;
                 msg.data.rematchReq.roomId = current_room_id;
                 msg.data.rematchReq.agree = (uint8_t)agree;
-                if (send_message_to_server(&msg)) {
-                    set_client_state(STATE_SENDING_REMATCH);
-                    send_state_change_event();
-                }
+                send_in_state(&msg, STATE_SENDING_REMATCH);
+            } else if (strcmp(command, "analyze") == 0 &&
+                       current_room_id == roomId) {
+                // 結果は解析応答 (MSG_ANALYZE_GAME_RESPONSE) で届く
+                msg.type = MSG_ANALYZE_GAME_REQUEST;
+                msg.data.analyzeGameReq.roomId = current_room_id;
+                send_message_to_server(&msg);
             } else {
                 send_error_event("Invalid command '%s' in state GameOver.",
                                  command);
@@ -412,6 +443,29 @@ static void process_command(const char* json_command) {
     }
 }
 
+// pending に遷移してから msg を送る。送信に失敗したとき、状態がまだ pending
+// のまま (切断などで変わっていない) なら遷移前の状態に戻す
+// 戻り値: 送信できれば 1、失敗時 0
+static int send_in_state(const Message* msg, ClientState pending) {
+    ClientState previous = get_client_state();
+    set_client_state(pending);
+    send_state_change_event();
+    if (send_message_to_server(msg)) {
+        return 1;
+    }
+
+    pthread_mutex_lock(get_state_mutex());
+    int rolled_back = (get_client_state_unsafe() == pending);
+    if (rolled_back) {
+        set_client_state_unsafe(previous);
+    }
+    pthread_mutex_unlock(get_state_mutex());
+    if (rolled_back) {
+        send_state_change_event();
+    }
+    return 0;
+}
+
 static void cleanup() {
     send_log_event(LOG_INFO, "Starting cleanup...");
     ClientState state = get_client_state();
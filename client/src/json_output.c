@@ -242,6 +242,48 @@ void send_board_update_event_unsafe() {
     send_json_event(json_buffer);
 }
 
+// 盤面差分イベント: 64マスを送らず、着手位置と裏返ったマス (r*8+c) だけを送る
+void send_board_delta_event_unsafe(int seq, uint8_t playerColor, int row,
+                                   int col, uint64_t flips) {
+    char json_buffer[512];
+    char flips_str[256] = "";
+    size_t len = 0;
+
+    for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; ++i) {
+        if (flips & ((uint64_t)1 << i)) {
+            len += snprintf(flips_str + len, sizeof(flips_str) - len, "%s%d",
+                            len ? "," : "", i);
+        }
+    }
+
+    snprintf(json_buffer, sizeof(json_buffer),
+             "{\"type\":\"boardDelta\",\"roomId\":%d,\"seq\":%d,"
+             "\"playerColor\":%d,\"row\":%d,\"col\":%d,\"flips\":[%s]}",
+             get_my_room_id_unsafe(), seq, playerColor, row, col, flips_str);
+    send_json_event(json_buffer);
+}
+
+// 棋譜解析イベント: 解析できた手を着手順に並べる (マスは r*8+c)
+void send_analysis_event_unsafe(const AnalyzeGameResponseData* analysis) {
+    char json_buffer[4096];
+    char moves_str[3584] = "";
+    size_t len = 0;
+
+    for (int i = 0; i < analysis->count && len < sizeof(moves_str); ++i) {
+        const GameAnalysisEntry* e = &analysis->moves[i];
+        len += snprintf(moves_str + len, sizeof(moves_str) - len,
+                        "%s{\"seq\":%d,\"color\":%d,\"played\":%d,"
+                        "\"best\":%d,\"playedDiff\":%d,\"bestDiff\":%d}",
+                        i ? "," : "", e->seq, e->color, e->played, e->best,
+                        e->playedDiff, e->bestDiff);
+    }
+
+    snprintf(json_buffer, sizeof(json_buffer),
+             "{\"type\":\"analysis\",\"roomId\":%d,\"moves\":[%s]}",
+             analysis->roomId, moves_str);
+    send_json_event(json_buffer);
+}
+
 // va_list を受け取るヘルパー関数の実装 (static)
 static void send_server_message_event_unsafe_va(const char* format,
                                                 va_list args) {
@@ -25,6 +25,8 @@ void send_rematch_result_event(uint8_t result);
 // --- 内部用 (Mutexロック済みコンテキスト用) ---
 void send_state_change_event_unsafe();
 void send_board_update_event_unsafe();
+void send_board_delta_event_unsafe(int seq, uint8_t playerColor, int row,
+                                   int col, uint64_t flips);
 void send_server_message_event_unsafe(const char* format, ...);
 void send_error_event_unsafe(const char* format, ...);
 void send_log_event_unsafe(LogLevel level, const char* format, ...);
@@ -32,6 +34,7 @@ void send_your_turn_event_unsafe();
 void send_game_over_event_unsafe(uint8_t winner, const char* message);
 void send_rematch_offer_event_unsafe();
 void send_rematch_result_event_unsafe(uint8_t result);
+void send_analysis_event_unsafe(const AnalyzeGameResponseData* analysis);
 void send_chat_message_received_event_unsafe(int roomId, int senderColor,
                                              const char* senderName,
                                              const char* message,
@@ -66,6 +66,17 @@ int connect_to_server() {
     }
 
     send_log_event(LOG_INFO, "Connected to server");
+
+    // 着手は盤面差分 (MSG_BOARD_DELTA_NOTICE) で受け取るよう設定する
+    Message delta_opt_in;
+    memset(&delta_opt_in, 0, sizeof(delta_opt_in));
+    delta_opt_in.type = MSG_BOARD_SYNC_REQUEST;
+    delta_opt_in.data.boardSyncReq.roomId = -1;
+    delta_opt_in.data.boardSyncReq.wantDelta = 1;
+    if (sendMessage(temp_sockfd, &delta_opt_in) <= 0) {
+        send_log_event(LOG_WARN, "Failed to enable board deltas.");
+    }
+
     set_sockfd(temp_sockfd);
     set_client_state(STATE_CONNECTED);
     send_state_change_event();
@@ -9,6 +9,11 @@ interface CEvent {
   roomId?: number; // stateChange, boardUpdate, etc.
   color?: number; // stateChange
   board?: number[][]; // boardUpdate
+  seq?: number; // boardDelta
+  playerColor?: number; // boardDelta
+  row?: number; // boardDelta
+  col?: number; // boardDelta
+  flips?: number[]; // boardDelta (裏返ったマスの番号 r*8+c)
   message?: string; // serverMessage, error, log, gameOver
   level?: string; // log
   winner?: number; // gameOver
@@ -184,6 +189,25 @@ export const useOthelloGame = () => {
                 console.warn("Received invalid board data:", data.board);
               }
               break;
+            case "boardDelta":
+              // 着手位置と裏返った石だけが届くので、現在の盤面に適用する
+              // (抜けの検知と全盤面の再取得はCクライアント側で行う)
+              if (
+                typeof data.playerColor === "number" &&
+                typeof data.row === "number" &&
+                typeof data.col === "number" &&
+                Array.isArray(data.flips)
+              ) {
+                newState.board[data.row][data.col] = data.playerColor;
+                for (const cell of data.flips) {
+                  newState.board[Math.floor(cell / 8)][cell % 8] =
+                    data.playerColor;
+                }
+                console.log(`Board delta applied (seq ${data.seq})`);
+              } else {
+                console.warn("Received invalid board delta:", data);
+              }
+              break;
             case "serverMessage":
               messageToShow = data.message ?? null;
               break;
@@ -6,15 +6,516 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+// --- エンコード補助 ---
+// バッファ不足は err に記録し、以降の書き込みは無視する
+typedef struct {
+    uint8_t* buf;
+    size_t cap;
+    size_t len;
+    int err;
+} FrameWriter;
+
+static void put_u8(FrameWriter* w, uint8_t v) {
+    if (w->len + 1 > w->cap) {
+        w->err = 1;
+        return;
+    }
+    w->buf[w->len++] = v;
+}
+
+static void put_i32(FrameWriter* w, int32_t v) {
+    uint32_t u = (uint32_t)v;
+    put_u8(w, u >> 24);
+    put_u8(w, u >> 16);
+    put_u8(w, u >> 8);
+    put_u8(w, u);
+}
+
+static void put_i64(FrameWriter* w, int64_t v) {
+    uint64_t u = (uint64_t)v;
+    put_i32(w, (int32_t)(u >> 32));
+    put_i32(w, (int32_t)u);
+}
+
+// 文字列は fieldSize (配列サイズ) 未満の長さに切り詰めて送る
+static void put_str(FrameWriter* w, const char* s, size_t fieldSize) {
+    size_t n = strnlen(s, fieldSize - 1);
+    if (n > 255) n = 255;
+    put_u8(w, (uint8_t)n);
+    if (w->len + n > w->cap) {
+        w->err = 1;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+static void put_board(FrameWriter* w,
+                      const uint8_t board[BOARD_SIZE][BOARD_SIZE]) {
+    uint8_t packed[PACKED_BOARD_SIZE] = {0};
+    for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; ++i) {
+        packed[i / 4] |= (board[i / BOARD_SIZE][i % BOARD_SIZE] & 0x3)
+                         << ((i % 4) * 2);
+    }
+    for (int i = 0; i < PACKED_BOARD_SIZE; ++i) {
+        put_u8(w, packed[i]);
+    }
+}
+
+// --- デコード補助 ---
+// データ不足や不正値は err に記録する
+typedef struct {
+    const uint8_t* buf;
+    size_t len;
+    size_t pos;
+    int err;
+} FrameReader;
+
+static uint8_t get_u8(FrameReader* r) {
+    if (r->pos + 1 > r->len) {
+        r->err = 1;
+        return 0;
+    }
+    return r->buf[r->pos++];
+}
+
+static int32_t get_i32(FrameReader* r) {
+    uint32_t u = (uint32_t)get_u8(r) << 24;
+    u |= (uint32_t)get_u8(r) << 16;
+    u |= (uint32_t)get_u8(r) << 8;
+    u |= get_u8(r);
+    return (int32_t)u;
+}
+
+static int64_t get_i64(FrameReader* r) {
+    uint64_t hi = (uint32_t)get_i32(r);
+    uint64_t lo = (uint32_t)get_i32(r);
+    return (int64_t)((hi << 32) | lo);
+}
+
+static void get_str(FrameReader* r, char* dst, size_t fieldSize) {
+    size_t n = get_u8(r);
+    if (n >= fieldSize || r->pos + n > r->len) {
+        r->err = 1;
+        dst[0] = '\0';
+        return;
+    }
+    memcpy(dst, r->buf + r->pos, n);
+    dst[n] = '\0';
+    r->pos += n;
+}
+
+static void get_board(FrameReader* r, uint8_t board[BOARD_SIZE][BOARD_SIZE]) {
+    for (int i = 0; i < PACKED_BOARD_SIZE; ++i) {
+        uint8_t b = get_u8(r);
+        for (int j = 0; j < 4; ++j) {
+            int cell = i * 4 + j;
+            board[cell / BOARD_SIZE][cell % BOARD_SIZE] = (b >> (j * 2)) & 0x3;
+        }
+    }
+}
+
+// --- エンコード/デコード ---
+
+int encodeMessage(const Message* msg, uint8_t* buf, size_t bufSize) {
+    FrameWriter w = {buf, bufSize, FRAME_HEADER_SIZE, 0};
+    if (bufSize < FRAME_HEADER_SIZE) {
+        return -1;
+    }
+
+    switch (msg->type) {
+        case MSG_CREATE_ROOM_REQUEST:
+            put_str(&w, msg->data.createRoomReq.roomName,
+                    sizeof(msg->data.createRoomReq.roomName));
+            break;
+        case MSG_CREATE_ROOM_RESPONSE:
+            put_u8(&w, msg->data.createRoomResp.success);
+            put_i32(&w, msg->data.createRoomResp.roomId);
+            put_str(&w, msg->data.createRoomResp.message,
+                    sizeof(msg->data.createRoomResp.message));
+            break;
+        case MSG_JOIN_ROOM_REQUEST:
+            put_i32(&w, msg->data.joinRoomReq.roomId);
+            break;
+        case MSG_JOIN_ROOM_RESPONSE:
+            put_u8(&w, msg->data.joinRoomResp.success);
+            put_i32(&w, msg->data.joinRoomResp.roomId);
+            put_str(&w, msg->data.joinRoomResp.message,
+                    sizeof(msg->data.joinRoomResp.message));
+            break;
+        case MSG_LIST_ROOMS_REQUEST:
+            put_i32(&w, msg->data.listRoomsReq.page);
+            put_i32(&w, msg->data.listRoomsReq.knownVersion);
+            break;
+        case MSG_LIST_ROOMS_RESPONSE: {
+            const ListRoomsResponseData* list = &msg->data.listRoomsResp;
+            uint8_t count = list->unchanged ? 0 : list->count;
+            if (count > ROOM_LIST_PAGE_SIZE) {
+                return -1;
+            }
+            put_i32(&w, list->version);
+            put_u8(&w, list->unchanged);
+            put_i32(&w, list->page);
+            put_i32(&w, list->pageCount);
+            put_i32(&w, list->totalRooms);
+            put_u8(&w, count);
+            for (int i = 0; i < count; ++i) {
+                put_i32(&w, list->rooms[i].roomId);
+                put_str(&w, list->rooms[i].roomName,
+                        sizeof(list->rooms[i].roomName));
+                put_u8(&w, list->rooms[i].status);
+                put_u8(&w, list->rooms[i].playerCount);
+            }
+            break;
+        }
+        case MSG_PLAYER_JOINED_NOTICE:
+            put_i32(&w, msg->data.playerJoinedNotice.roomId);
+            break;
+        case MSG_START_GAME_REQUEST:
+            put_i32(&w, msg->data.startGameReq.roomId);
+            break;
+        case MSG_GAME_START_NOTICE:
+            put_i32(&w, msg->data.gameStartNotice.roomId);
+            put_u8(&w, msg->data.gameStartNotice.yourColor);
+            put_board(&w, msg->data.gameStartNotice.board);
+            put_i64(&w, (int64_t)msg->data.gameStartNotice.resumeToken);
+            break;
+        case MSG_PLACE_PIECE_REQUEST:
+            put_i32(&w, msg->data.placePieceReq.roomId);
+            put_u8(&w, msg->data.placePieceReq.row);
+            put_u8(&w, msg->data.placePieceReq.col);
+            break;
+        case MSG_UPDATE_BOARD_NOTICE:
+            put_i32(&w, msg->data.updateBoardNotice.roomId);
+            put_i32(&w, msg->data.updateBoardNotice.seq);
+            put_u8(&w, msg->data.updateBoardNotice.playerColor);
+            put_u8(&w, msg->data.updateBoardNotice.row);
+            put_u8(&w, msg->data.updateBoardNotice.col);
+            put_board(&w, msg->data.updateBoardNotice.board);
+            break;
+        case MSG_INVALID_MOVE_NOTICE:
+            put_i32(&w, msg->data.invalidMoveNotice.roomId);
+            put_str(&w, msg->data.invalidMoveNotice.message,
+                    sizeof(msg->data.invalidMoveNotice.message));
+            break;
+        case MSG_YOUR_TURN_NOTICE:
+            put_i32(&w, msg->data.yourTurnNotice.roomId);
+            break;
+        case MSG_GAME_OVER_NOTICE:
+            put_i32(&w, msg->data.gameOverNotice.roomId);
+            put_u8(&w, msg->data.gameOverNotice.winner);
+            put_str(&w, msg->data.gameOverNotice.message,
+                    sizeof(msg->data.gameOverNotice.message));
+            break;
+        case MSG_REMATCH_REQUEST:
+            put_i32(&w, msg->data.rematchReq.roomId);
+            put_u8(&w, msg->data.rematchReq.agree);
+            break;
+        case MSG_REMATCH_OFFER_NOTICE:
+            put_i32(&w, msg->data.rematchOfferNotice.roomId);
+            break;
+        case MSG_REMATCH_RESULT_NOTICE:
+            put_i32(&w, msg->data.rematchResultNotice.roomId);
+            put_u8(&w, msg->data.rematchResultNotice.result);
+            break;
+        case MSG_ROOM_CLOSED_NOTICE:
+            put_i32(&w, msg->data.roomClosedNotice.roomId);
+            put_str(&w, msg->data.roomClosedNotice.reason,
+                    sizeof(msg->data.roomClosedNotice.reason));
+            break;
+        case MSG_CHAT_MESSAGE_SEND_REQUEST:
+            put_i32(&w, msg->data.chatMessageSendReq.roomId);
+            put_str(&w, msg->data.chatMessageSendReq.message_text,
+                    sizeof(msg->data.chatMessageSendReq.message_text));
+            break;
+        case MSG_CHAT_MESSAGE_BROADCAST_NOTICE: {
+            const ChatMessageBroadcastNoticeData* chat =
+                &msg->data.chatMessageBroadcastNotice;
+            put_i32(&w, chat->roomId);
+            put_u8(&w, chat->sender_player_color);
+            put_str(&w, chat->sender_display_name,
+                    sizeof(chat->sender_display_name));
+            put_str(&w, chat->message_text, sizeof(chat->message_text));
+            put_i64(&w, chat->timestamp);
+            break;
+        }
+        case MSG_ERROR_NOTICE:
+            put_str(&w, msg->data.errorNotice.message,
+                    sizeof(msg->data.errorNotice.message));
+            break;
+        case MSG_BOARD_SYNC_REQUEST:
+            put_i32(&w, msg->data.boardSyncReq.roomId);
+            put_u8(&w, msg->data.boardSyncReq.wantDelta);
+            break;
+        case MSG_BOARD_DELTA_NOTICE:
+            put_i32(&w, msg->data.boardDeltaNotice.roomId);
+            put_i32(&w, msg->data.boardDeltaNotice.seq);
+            put_u8(&w, msg->data.boardDeltaNotice.playerColor);
+            put_u8(&w, msg->data.boardDeltaNotice.row);
+            put_u8(&w, msg->data.boardDeltaNotice.col);
+            put_i64(&w, (int64_t)msg->data.boardDeltaNotice.flips);
+            break;
+        case MSG_ADD_AI_REQUEST:
+            put_i32(&w, msg->data.addAiReq.roomId);
+            put_i32(&w, msg->data.addAiReq.moveTimeMs);
+            break;
+        case MSG_ANALYZE_GAME_REQUEST:
+            put_i32(&w, msg->data.analyzeGameReq.roomId);
+            break;
+        case MSG_ANALYZE_GAME_RESPONSE: {
+            const AnalyzeGameResponseData* a = &msg->data.analyzeGameResp;
+            if (a->count > MAX_ANALYSIS_MOVES) {
+                return -1;
+            }
+            put_i32(&w, a->roomId);
+            put_u8(&w, a->count);
+            for (int i = 0; i < a->count; ++i) {
+                put_u8(&w, a->moves[i].seq);
+                put_u8(&w, a->moves[i].color);
+                put_u8(&w, a->moves[i].played);
+                put_u8(&w, a->moves[i].best);
+                put_u8(&w, (uint8_t)a->moves[i].playedDiff);
+                put_u8(&w, (uint8_t)a->moves[i].bestDiff);
+            }
+            break;
+        }
+        case MSG_RESUME_REQUEST:
+            put_i32(&w, msg->data.resumeReq.roomId);
+            put_i64(&w, (int64_t)msg->data.resumeReq.token);
+            break;
+        case MSG_RESUME_RESPONSE:
+            put_u8(&w, msg->data.resumeResp.success);
+            put_i32(&w, msg->data.resumeResp.roomId);
+            put_u8(&w, msg->data.resumeResp.yourColor);
+            put_str(&w, msg->data.resumeResp.message,
+                    sizeof(msg->data.resumeResp.message));
+            break;
+        default:
+            // ペイロード未定義のタイプはヘッダのみ
+            break;
+    }
+
+    if (w.err || w.len > MAX_FRAME_SIZE) {
+        return -1;
+    }
+    size_t payloadLen = w.len - FRAME_HEADER_SIZE;
+    buf[0] = (uint8_t)(payloadLen >> 8);
+    buf[1] = (uint8_t)payloadLen;
+    buf[2] = (uint8_t)msg->type;
+    return (int)w.len;
+}
+
+int decodeMessage(const uint8_t* buf, size_t len, Message* msg) {
+    if (len < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    size_t payloadLen = ((size_t)buf[0] << 8) | buf[1];
+    size_t frameLen = FRAME_HEADER_SIZE + payloadLen;
+    if (frameLen > MAX_FRAME_SIZE) {
+        return -1;
+    }
+    if (len < frameLen) {
+        return 0;  // フレームの残りを待つ
+    }
+
+    FrameReader r = {buf + FRAME_HEADER_SIZE, payloadLen, 0, 0};
+    memset(msg, 0, sizeof(*msg));
+    msg->type = (MessageType)buf[2];
+
+    switch (msg->type) {
+        case MSG_CREATE_ROOM_REQUEST:
+            get_str(&r, msg->data.createRoomReq.roomName,
+                    sizeof(msg->data.createRoomReq.roomName));
+            break;
+        case MSG_CREATE_ROOM_RESPONSE:
+            msg->data.createRoomResp.success = get_u8(&r);
+            msg->data.createRoomResp.roomId = get_i32(&r);
+            get_str(&r, msg->data.createRoomResp.message,
+                    sizeof(msg->data.createRoomResp.message));
+            break;
+        case MSG_JOIN_ROOM_REQUEST:
+            msg->data.joinRoomReq.roomId = get_i32(&r);
+            break;
+        case MSG_JOIN_ROOM_RESPONSE:
+            msg->data.joinRoomResp.success = get_u8(&r);
+            msg->data.joinRoomResp.roomId = get_i32(&r);
+            get_str(&r, msg->data.joinRoomResp.message,
+                    sizeof(msg->data.joinRoomResp.message));
+            break;
+        case MSG_LIST_ROOMS_REQUEST:
+            msg->data.listRoomsReq.page = get_i32(&r);
+            msg->data.listRoomsReq.knownVersion = get_i32(&r);
+            break;
+        case MSG_LIST_ROOMS_RESPONSE: {
+            ListRoomsResponseData* list = &msg->data.listRoomsResp;
+            list->version = get_i32(&r);
+            list->unchanged = get_u8(&r);
+            list->page = get_i32(&r);
+            list->pageCount = get_i32(&r);
+            list->totalRooms = get_i32(&r);
+            list->count = get_u8(&r);
+            if (list->count > ROOM_LIST_PAGE_SIZE) {
+                r.err = 1;
+                break;
+            }
+            for (int i = 0; i < list->count; ++i) {
+                list->rooms[i].roomId = get_i32(&r);
+                get_str(&r, list->rooms[i].roomName,
+                        sizeof(list->rooms[i].roomName));
+                list->rooms[i].status = get_u8(&r);
+                list->rooms[i].playerCount = get_u8(&r);
+            }
+            break;
+        }
+        case MSG_PLAYER_JOINED_NOTICE:
+            msg->data.playerJoinedNotice.roomId = get_i32(&r);
+            break;
+        case MSG_START_GAME_REQUEST:
+            msg->data.startGameReq.roomId = get_i32(&r);
+            break;
+        case MSG_GAME_START_NOTICE:
+            msg->data.gameStartNotice.roomId = get_i32(&r);
+            msg->data.gameStartNotice.yourColor = get_u8(&r);
+            get_board(&r, msg->data.gameStartNotice.board);
+            msg->data.gameStartNotice.resumeToken = (uint64_t)get_i64(&r);
+            break;
+        case MSG_PLACE_PIECE_REQUEST:
+            msg->data.placePieceReq.roomId = get_i32(&r);
+            msg->data.placePieceReq.row = get_u8(&r);
+            msg->data.placePieceReq.col = get_u8(&r);
+            break;
+        case MSG_UPDATE_BOARD_NOTICE:
+            msg->data.updateBoardNotice.roomId = get_i32(&r);
+            msg->data.updateBoardNotice.seq = get_i32(&r);
+            msg->data.updateBoardNotice.playerColor = get_u8(&r);
+            msg->data.updateBoardNotice.row = get_u8(&r);
+            msg->data.updateBoardNotice.col = get_u8(&r);
+            get_board(&r, msg->data.updateBoardNotice.board);
+            break;
+        case MSG_INVALID_MOVE_NOTICE:
+            msg->data.invalidMoveNotice.roomId = get_i32(&r);
+            get_str(&r, msg->data.invalidMoveNotice.message,
+                    sizeof(msg->data.invalidMoveNotice.message));
+            break;
+        case MSG_YOUR_TURN_NOTICE:
+            msg->data.yourTurnNotice.roomId = get_i32(&r);
+            break;
+        case MSG_GAME_OVER_NOTICE:
+            msg->data.gameOverNotice.roomId = get_i32(&r);
+            msg->data.gameOverNotice.winner = get_u8(&r);
+            get_str(&r, msg->data.gameOverNotice.message,
+                    sizeof(msg->data.gameOverNotice.message));
+            break;
+        case MSG_REMATCH_REQUEST:
+            msg->data.rematchReq.roomId = get_i32(&r);
+            msg->data.rematchReq.agree = get_u8(&r);
+            break;
+        case MSG_REMATCH_OFFER_NOTICE:
+            msg->data.rematchOfferNotice.roomId = get_i32(&r);
+            break;
+        case MSG_REMATCH_RESULT_NOTICE:
+            msg->data.rematchResultNotice.roomId = get_i32(&r);
+            msg->data.rematchResultNotice.result = get_u8(&r);
+            break;
+        case MSG_ROOM_CLOSED_NOTICE:
+            msg->data.roomClosedNotice.roomId = get_i32(&r);
+            get_str(&r, msg->data.roomClosedNotice.reason,
+                    sizeof(msg->data.roomClosedNotice.reason));
+            break;
+        case MSG_CHAT_MESSAGE_SEND_REQUEST:
+            msg->data.chatMessageSendReq.roomId = get_i32(&r);
+            get_str(&r, msg->data.chatMessageSendReq.message_text,
+                    sizeof(msg->data.chatMessageSendReq.message_text));
+            break;
+        case MSG_CHAT_MESSAGE_BROADCAST_NOTICE: {
+            ChatMessageBroadcastNoticeData* chat =
+                &msg->data.chatMessageBroadcastNotice;
+            chat->roomId = get_i32(&r);
+            chat->sender_player_color = get_u8(&r);
+            get_str(&r, chat->sender_display_name,
+                    sizeof(chat->sender_display_name));
+            get_str(&r, chat->message_text, sizeof(chat->message_text));
+            chat->timestamp = get_i64(&r);
+            break;
+        }
+        case MSG_ERROR_NOTICE:
+            get_str(&r, msg->data.errorNotice.message,
+                    sizeof(msg->data.errorNotice.message));
+            break;
+        case MSG_BOARD_SYNC_REQUEST:
+            msg->data.boardSyncReq.roomId = get_i32(&r);
+            msg->data.boardSyncReq.wantDelta = get_u8(&r);
+            break;
+        case MSG_BOARD_DELTA_NOTICE:
+            msg->data.boardDeltaNotice.roomId = get_i32(&r);
+            msg->data.boardDeltaNotice.seq = get_i32(&r);
+            msg->data.boardDeltaNotice.playerColor = get_u8(&r);
+            msg->data.boardDeltaNotice.row = get_u8(&r);
+            msg->data.boardDeltaNotice.col = get_u8(&r);
+            msg->data.boardDeltaNotice.flips = (uint64_t)get_i64(&r);
+            break;
+        case MSG_ADD_AI_REQUEST:
+            msg->data.addAiReq.roomId = get_i32(&r);
+            msg->data.addAiReq.moveTimeMs = get_i32(&r);
+            break;
+        case MSG_ANALYZE_GAME_REQUEST:
+            msg->data.analyzeGameReq.roomId = get_i32(&r);
+            break;
+        case MSG_ANALYZE_GAME_RESPONSE: {
+            AnalyzeGameResponseData* a = &msg->data.analyzeGameResp;
+            a->roomId = get_i32(&r);
+            a->count = get_u8(&r);
+            if (a->count > MAX_ANALYSIS_MOVES) {
+                r.err = 1;
+                break;
+            }
+            for (int i = 0; i < a->count; ++i) {
+                a->moves[i].seq = get_u8(&r);
+                a->moves[i].color = get_u8(&r);
+                a->moves[i].played = get_u8(&r);
+                a->moves[i].best = get_u8(&r);
+                a->moves[i].playedDiff = (int8_t)get_u8(&r);
+                a->moves[i].bestDiff = (int8_t)get_u8(&r);
+            }
+            break;
+        }
+        case MSG_RESUME_REQUEST:
+            msg->data.resumeReq.roomId = get_i32(&r);
+            msg->data.resumeReq.token = (uint64_t)get_i64(&r);
+            break;
+        case MSG_RESUME_RESPONSE:
+            msg->data.resumeResp.success = get_u8(&r);
+            msg->data.resumeResp.roomId = get_i32(&r);
+            msg->data.resumeResp.yourColor = get_u8(&r);
+            get_str(&r, msg->data.resumeResp.message,
+                    sizeof(msg->data.resumeResp.message));
+            break;
+        default:
+            // 未知のタイプ: ペイロードは読み飛ばし、上位層で扱う
+            break;
+    }
+
+    if (r.err) {
+        return -1;
+    }
+    return (int)frameLen;
+}
+
+// --- ソケット送受信 ---
+
 // メッセージ送信関数
 int sendMessage(int sockfd, const Message* msg) {
+    uint8_t frame[MAX_FRAME_SIZE];
+    int frameLen = encodeMessage(msg, frame, sizeof(frame));
+    if (frameLen < 0) {
+        fprintf(stderr, "encodeMessage failed (type: %d)\n", msg->type);
+        return -1;
+    }
+
     ssize_t totalSent = 0;
     ssize_t sentBytes;
-    size_t msgSize = sizeof(Message);  // 送信するメッセージ全体のサイズ
-    const char* msgPtr = (const char*)msg;
-
-    while (totalSent < msgSize) {
-        sentBytes = send(sockfd, msgPtr + totalSent, msgSize - totalSent, 0);
+    while (totalSent < frameLen) {
+        sentBytes = send(sockfd, frame + totalSent, frameLen - totalSent, 0);
         if (sentBytes <= 0) {
             // エラーまたは接続断
             perror("send failed");
@@ -26,16 +527,12 @@ int sendMessage(int sockfd, const Message* msg) {
     return totalSent;
 }
 
-// メッセージ受信関数
-int receiveMessage(int sockfd, Message* msg) {
-    ssize_t totalReceived = 0;
-    ssize_t receivedBytes;
-    size_t msgSize = sizeof(Message);  // 受信するメッセージ全体のサイズ
-    char* msgPtr = (char*)msg;
-
-    while (totalReceived < msgSize) {
-        receivedBytes =
-            recv(sockfd, msgPtr + totalReceived, msgSize - totalReceived, 0);
+// 指定バイト数を受信し切る (戻り値: receiveMessage と同じ規約)
+static int receiveExact(int sockfd, uint8_t* buf, size_t size) {
+    size_t totalReceived = 0;
+    while (totalReceived < size) {
+        ssize_t receivedBytes =
+            recv(sockfd, buf + totalReceived, size - totalReceived, 0);
         if (receivedBytes < 0) {
             // エラー
             perror("recv failed");
@@ -47,7 +544,35 @@ int receiveMessage(int sockfd, Message* msg) {
         }
         totalReceived += receivedBytes;
     }
-    // printf("DEBUG: Received %ld bytes, type: %d\n", totalReceived,
-    // msg->type);
-    return totalReceived;
-}
\ No newline at end of file
+    return (int)totalReceived;
+}
+
+// メッセージ受信関数
+int receiveMessage(int sockfd, Message* msg) {
+    uint8_t frame[MAX_FRAME_SIZE];
+
+    // ヘッダを読んでからペイロード長分だけ読む
+    int result = receiveExact(sockfd, frame, FRAME_HEADER_SIZE);
+    if (result <= 0) {
+        return result;
+    }
+    size_t payloadLen = ((size_t)frame[0] << 8) | frame[1];
+    if (FRAME_HEADER_SIZE + payloadLen > MAX_FRAME_SIZE) {
+        fprintf(stderr, "Received oversized frame (%zu bytes)\n", payloadLen);
+        return -1;
+    }
+    if (payloadLen > 0) {
+        result = receiveExact(sockfd, frame + FRAME_HEADER_SIZE, payloadLen);
+        if (result <= 0) {
+            return result;
+        }
+    }
+
+    int frameLen = decodeMessage(frame, FRAME_HEADER_SIZE + payloadLen, msg);
+    if (frameLen <= 0) {
+        fprintf(stderr, "Received malformed frame (type: %d)\n", frame[2]);
+        return -1;
+    }
+    // printf("DEBUG: Received %d bytes, type: %d\n", frameLen, msg->type);
+    return frameLen;
+}
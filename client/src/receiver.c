@@ -4,6 +4,50 @@
 #include "network.h"
 #include "state.h"
 
+// --- 対局の再開 ---
+// 対局中にサーバーとの接続が切れたら (サーバーの再起動など)、間隔を空けて
+// 再接続を試み、ゲーム開始時に受け取った合言葉で対局の再開を要求する
+#define RESUME_RETRY_COUNT 30        // 再接続を試す回数
+#define RESUME_RETRY_INTERVAL_SEC 1  // 再接続の間隔（秒）
+
+// 戻り値: 再接続して再開を要求できれば 1 (応答は受信ループで処理する)
+static int try_resume_game() {
+    pthread_mutex_lock(get_state_mutex());
+    ClientState current = get_client_state_unsafe();
+    int room_id = get_my_room_id_unsafe();
+    uint64_t token = get_resume_token_unsafe();
+    pthread_mutex_unlock(get_state_mutex());
+
+    if (token == 0 || room_id == -1 ||
+        (current != STATE_MY_TURN && current != STATE_OPPONENT_TURN &&
+         current != STATE_PLACING_PIECE)) {
+        return 0;  // 対局中ではない
+    }
+
+    send_log_event(LOG_INFO,
+                   "Connection lost during the game in room %d. Trying to "
+                   "resume...",
+                   room_id);
+    close_connection();
+    for (int attempt = 1; attempt <= RESUME_RETRY_COUNT; ++attempt) {
+        sleep(RESUME_RETRY_INTERVAL_SEC);
+        if (get_client_state() == STATE_QUITTING) {
+            return 0;
+        }
+        if (connect_to_server() < 0) {
+            continue;
+        }
+        Message req;
+        memset(&req, 0, sizeof(req));
+        req.type = MSG_RESUME_REQUEST;
+        req.data.resumeReq.roomId = room_id;
+        req.data.resumeReq.token = token;
+        return send_message_to_server(&req);
+    }
+    send_error_event("Could not resume the game in room %d.", room_id);
+    return 0;
+}
+
 // --- サーバーからのメッセージ受信スレッド ---
 void* receive_handler(void* arg) {
     Message msg;
@@ -28,6 +72,9 @@ void* receive_handler(void* arg) {
         read_size = receiveMessage(current_sockfd, &msg);
 
         if (read_size <= 0) {
+            if (try_resume_game()) {
+                continue;  // 再接続したソケットで受信を続ける
+            }
             // 接続が切れた場合の処理
             pthread_mutex_lock(get_state_mutex());
             ClientState current = get_client_state_unsafe();  // mutexロック済み
@@ -58,6 +105,7 @@ void process_server_message(const Message* msg) {
     ClientState current = get_client_state_unsafe();
     int current_room_id = get_my_room_id_unsafe();
     uint8_t current_my_color = get_my_color_unsafe();
+    int resync_room_id = -1;  // 差分の欠落を検知した場合に再同期を要求する部屋
 
     // send_log_event_unsafe(LOG_DEBUG, "Processing server msg type %d",
     // msg->type);
@@ -129,6 +177,9 @@ void process_server_message(const Message* msg) {
                     set_my_color_unsafe(msg->data.gameStartNotice.yourColor);
                     set_game_board_unsafe(
                         msg->data.gameStartNotice.board);  // state.cで実装
+                    set_board_seq_unsafe(0);  // 着手番号はゲーム開始で 0
+                    set_resume_token_unsafe(
+                        msg->data.gameStartNotice.resumeToken);
 
                     send_server_message_event_unsafe(
                         "Game Start! You are %s.", (get_my_color_unsafe() == 1)
@@ -158,15 +209,49 @@ void process_server_message(const Message* msg) {
             if (msg->data.updateBoardNotice.roomId == current_room_id) {
                 // 盤面は常に更新
                 set_game_board_unsafe(msg->data.updateBoardNotice.board);
-                send_server_message_event_unsafe(
-                    "Board updated by player %d at (%d, %d).",
-                    msg->data.updateBoardNotice.playerColor,
-                    msg->data.updateBoardNotice.row,
-                    msg->data.updateBoardNotice.col);
+                set_board_seq_unsafe(msg->data.updateBoardNotice.seq);
+                if (msg->data.updateBoardNotice.playerColor == 0) {
+                    // 再同期要求への応答 (着手ではない)
+                    send_log_event_unsafe(
+                        LOG_INFO, "Board resynchronized at move %d.",
+                        msg->data.updateBoardNotice.seq);
+                } else {
+                    send_server_message_event_unsafe(
+                        "Board updated by player %d at (%d, %d).",
+                        msg->data.updateBoardNotice.playerColor,
+                        msg->data.updateBoardNotice.row,
+                        msg->data.updateBoardNotice.col);
+                }
                 send_board_update_event_unsafe();  // 盤面をJSON出力
                 // 状態遷移は YOUR_TURN_NOTICE で行う
             }
             break;
+        case MSG_BOARD_DELTA_NOTICE:
+            if (msg->data.boardDeltaNotice.roomId == current_room_id) {
+                const BoardDeltaNoticeData* delta =
+                    &msg->data.boardDeltaNotice;
+                if (delta->seq != get_board_seq_unsafe() + 1 ||
+                    delta->row >= BOARD_SIZE || delta->col >= BOARD_SIZE) {
+                    // 差分が欠落している -> 全盤面を要求する
+                    send_log_event_unsafe(
+                        LOG_WARN,
+                        "Board delta gap (have %d, got %d). Requesting "
+                        "resync.",
+                        get_board_seq_unsafe(), delta->seq);
+                    resync_room_id = current_room_id;
+                    break;
+                }
+                apply_board_delta_unsafe(delta->playerColor, delta->row,
+                                         delta->col, delta->flips);
+                set_board_seq_unsafe(delta->seq);
+                send_server_message_event_unsafe(
+                    "Board updated by player %d at (%d, %d).",
+                    delta->playerColor, delta->row, delta->col);
+                send_board_delta_event_unsafe(delta->seq, delta->playerColor,
+                                              delta->row, delta->col,
+                                              delta->flips);
+            }
+            break;
         case MSG_YOUR_TURN_NOTICE:
             if (msg->data.yourTurnNotice.roomId == current_room_id) {
                 // 相手ターンだった場合、またはゲーム開始直後(先手)に自分のターンになる
@@ -349,6 +434,30 @@ void process_server_message(const Message* msg) {
                 }
             }
             break;
+        case MSG_ANALYZE_GAME_RESPONSE:
+            if (msg->data.analyzeGameResp.roomId == current_room_id) {
+                send_analysis_event_unsafe(&msg->data.analyzeGameResp);
+            }
+            break;
+        case MSG_RESUME_RESPONSE:
+            if (msg->data.resumeResp.roomId == current_room_id) {
+                if (msg->data.resumeResp.success) {
+                    set_my_color_unsafe(msg->data.resumeResp.yourColor);
+                    // 自分の手番なら続けて YOUR_TURN が届く
+                    set_client_state_unsafe(STATE_OPPONENT_TURN);
+                    send_server_message_event_unsafe(
+                        "Resumed the game in room %d: %s", current_room_id,
+                        msg->data.resumeResp.message);
+                } else {
+                    send_server_message_event_unsafe(
+                        "Failed to resume the game in room %d: %s",
+                        current_room_id, msg->data.resumeResp.message);
+                    reset_room_info_unsafe();
+                    set_client_state_unsafe(STATE_CONNECTED);  // ロビーに戻る
+                }
+                send_state_change_event_unsafe();
+            }
+            break;
         case MSG_ERROR_NOTICE:
             send_error_event_unsafe("Server Error: %s",
                                     msg->data.errorNotice.message);
@@ -362,4 +471,14 @@ void process_server_message(const Message* msg) {
     }
 
     pthread_mutex_unlock(get_state_mutex());
+
+    // 送信は状態ミューテックスを取るため、解放後に行う
+    if (resync_room_id != -1) {
+        Message sync_req;
+        memset(&sync_req, 0, sizeof(sync_req));
+        sync_req.type = MSG_BOARD_SYNC_REQUEST;
+        sync_req.data.boardSyncReq.roomId = resync_room_id;
+        sync_req.data.boardSyncReq.wantDelta = 1;
+        send_message_to_server(&sync_req);
+    }
 }
\ No newline at end of file
@@ -10,6 +10,8 @@ static ClientState g_current_state = STATE_DISCONNECTED;
 static int g_my_room_id = -1;
 static uint8_t g_my_color = 0;
 static uint8_t g_game_board[BOARD_SIZE][BOARD_SIZE];
+static int g_board_seq = 0;  // g_game_board に反映済みの着手番号
+static uint64_t g_resume_token = 0;  // 対局再開用の合言葉 (0 ならなし)
 
 // --- 初期化 (変更なし) ---
 void initialize_state() {
@@ -20,6 +22,8 @@ void initialize_state() {
     g_my_room_id = -1;
     g_my_color = 0;
     memset(g_game_board, 0, sizeof(g_game_board));
+    g_board_seq = 0;
+    g_resume_token = 0;
     pthread_mutex_unlock(&g_state_mutex);
     // printf は削除 (ログは json_output 経由で)
 }
@@ -119,6 +123,21 @@ void get_game_board_unsafe(uint8_t board_copy[BOARD_SIZE][BOARD_SIZE]) {
 void set_game_board_unsafe(const uint8_t new_board[BOARD_SIZE][BOARD_SIZE]) {
     memcpy(g_game_board, new_board, sizeof(g_game_board));
 }
+// 盤面差分の適用 (_unsafe version)
+// (row, col) に color の石を置き、flips のビットが立つマスを color にする
+void apply_board_delta_unsafe(uint8_t color, int row, int col,
+                              uint64_t flips) {
+    g_game_board[row][col] = color;
+    for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; ++i) {
+        if (flips & ((uint64_t)1 << i)) {
+            g_game_board[i / BOARD_SIZE][i % BOARD_SIZE] = color;
+        }
+    }
+}
+int get_board_seq_unsafe() { return g_board_seq; }
+void set_board_seq_unsafe(int seq) { g_board_seq = seq; }
+uint64_t get_resume_token_unsafe() { return g_resume_token; }
+void set_resume_token_unsafe(uint64_t token) { g_resume_token = token; }
 
 // --- Reset Room Info (変更なし) ---
 void reset_room_info() {
@@ -126,12 +145,16 @@ void reset_room_info() {
     g_my_room_id = -1;
     g_my_color = 0;
     memset(g_game_board, 0, sizeof(g_game_board));
+    g_board_seq = 0;
+    g_resume_token = 0;
     pthread_mutex_unlock(&g_state_mutex);
 }
 void reset_room_info_unsafe() {
     g_my_room_id = -1;
     g_my_color = 0;
     memset(g_game_board, 0, sizeof(g_game_board));
+    g_board_seq = 0;
+    g_resume_token = 0;
 }
 
 // --- 状態enumを文字列に変換 (json_output.c から移動) ---
@@ -41,6 +41,14 @@ uint8_t get_my_color_unsafe();
 // ゲーム盤面取得 (mutex保護不要だが _unsafe を追加)
 void get_game_board_unsafe(uint8_t board_copy[BOARD_SIZE][BOARD_SIZE]);
 void set_game_board_unsafe(const uint8_t new_board[BOARD_SIZE][BOARD_SIZE]);
+// 盤面差分 (MSG_BOARD_DELTA_NOTICE) の適用と着手番号
+void apply_board_delta_unsafe(uint8_t color, int row, int col,
+                              uint64_t flips);
+int get_board_seq_unsafe();
+void set_board_seq_unsafe(int seq);
+// 対局再開用の合言葉 (MSG_GAME_START_NOTICE で受け取る)
+uint64_t get_resume_token_unsafe();
+void set_resume_token_unsafe(uint64_t token);
 void reset_room_info_unsafe();
 
 #endif  // STATE_H
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include "ai_eval.h"
+
+#include "logger.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AI_EVAL_HAVE_AVX2 1
+#endif
+
+#define AI_EVAL_MAX_LEN 10     // パターン1つの最大マス数
+#define AI_EVAL_LANES 4        // 1ベクトル (256bit) で扱うパターン数
+#define AI_EVAL_VECTORS 4      // 全パターンを収めるベクトル数
+#define AI_EVAL_INSTANCES 14   // 盤面上のパターンの数
+#define AI_EVAL_NO_SQUARE 64   // 空きの枠 (シフト量 64 なので常に空きと読む)
+#define AI_EVAL_STABLE_WEIGHT 12  // 隅から続く辺の確定石1つあたりの重み
+
+const int ai_square_weights[BOARD_SIZE * BOARD_SIZE] = {
+    100, -20, 10, 5,  5,  10, -20, 100,  //
+    -20, -50, -2, -2, -2, -2, -50, -20,  //
+    10,  -2,  -1, -1, -1, -1, -2,  10,   //
+    5,   -2,  -1, -1, -1, -1, -2,  5,    //
+    5,   -2,  -1, -1, -1, -1, -2,  5,    //
+    10,  -2,  -1, -1, -1, -1, -2,  10,   //
+    -20, -50, -2, -2, -2, -2, -50, -20,  //
+    100, -20, 10, 5,  5,  10, -20, 100,  //
+};
+
+// --- パターンの定義 ---
+
+// パターンの種類 (種類ごとに評価値の表を1つ持つ)
+enum { GROUP_EDGE, GROUP_CORNER, GROUP_LINE2, GROUP_DIAG, GROUP_COUNT };
+
+// 種類ごとの基準のパターン ({行, 列} の列、並びが3進数の桁の順)
+static const struct {
+    int length;
+    int squares[AI_EVAL_MAX_LEN][2];
+} kGroups[GROUP_COUNT] = {
+    // 辺 + X 打ちのマス
+    {10,
+     {{0, 0}, {0, 1}, {0, 2}, {0, 3}, {0, 4}, {0, 5}, {0, 6}, {0, 7},
+      {1, 1}, {1, 6}}},
+    // 隅の 3x3
+    {9,
+     {{0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 1}, {1, 2}, {2, 0}, {2, 1},
+      {2, 2}}},
+    // 2列目
+    {8, {{1, 0}, {1, 1}, {1, 2}, {1, 3}, {1, 4}, {1, 5}, {1, 6}, {1, 7}}},
+    // 対角線
+    {8, {{0, 0}, {1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}, {6, 6}, {7, 7}}},
+};
+
+// 盤面上のパターン: 基準のパターンの種類と、それを写す変換
+// 変換 0-3: 右回りに 0/90/180/270 度回転、4: 左右反転
+static const struct {
+    int group;
+    int transform;
+} kInstances[AI_EVAL_INSTANCES] = {
+    {GROUP_EDGE, 0},   {GROUP_EDGE, 1},   {GROUP_EDGE, 2},
+    {GROUP_EDGE, 3},   {GROUP_CORNER, 0}, {GROUP_CORNER, 1},
+    {GROUP_CORNER, 2}, {GROUP_CORNER, 3}, {GROUP_LINE2, 0},
+    {GROUP_LINE2, 1},  {GROUP_LINE2, 2},  {GROUP_LINE2, 3},
+    {GROUP_DIAG, 0},   {GROUP_DIAG, 4},
+};
+
+// [ベクトル][桁][レーン] ごとのマスの番号 (= シフト量)。
+// レーン i * AI_EVAL_LANES + l が kInstances[...] に対応する
+static uint64_t pattern_shifts[AI_EVAL_VECTORS][AI_EVAL_MAX_LEN]
+                              [AI_EVAL_LANES] __attribute__((aligned(32)));
+
+// 種類ごとの評価値の表 (添字は3進数、手番側から見た値)
+static int16_t* pattern_tables[GROUP_COUNT];
+
+static int (*evaluate_impl)(Bitboard player, Bitboard opponent);
+static const char* impl_name = "scalar";
+
+static int transform_square(int r, int c, int transform) {
+    switch (transform) {
+        case 1:
+            return SQUARE_INDEX(c, BOARD_SIZE - 1 - r);
+        case 2:
+            return SQUARE_INDEX(BOARD_SIZE - 1 - r, BOARD_SIZE - 1 - c);
+        case 3:
+            return SQUARE_INDEX(BOARD_SIZE - 1 - c, r);
+        case 4:
+            return SQUARE_INDEX(r, BOARD_SIZE - 1 - c);
+        default:
+            return SQUARE_INDEX(r, c);
+    }
+}
+
+static int power3(int n) {
+    int p = 1;
+    while (n-- > 0) p *= 3;
+    return p;
+}
+
+// --- 評価値の表の作成 ---
+// 学習済みの重みは無いので、石の並びごとにマスの重みと辺の確定石から作る。
+// 複数のパターンに含まれるマスは、その数で重みを割って二重に数えない
+
+// X 打ち・C 打ちのマスなら対応する隅、それ以外は -1
+static int danger_corner(int sq) {
+    if (ai_square_weights[sq] != -20 && ai_square_weights[sq] != -50) {
+        return -1;
+    }
+    int r = sq / BOARD_SIZE < BOARD_SIZE / 2 ? 0 : BOARD_SIZE - 1;
+    int c = sq % BOARD_SIZE < BOARD_SIZE / 2 ? 0 : BOARD_SIZE - 1;
+    return SQUARE_INDEX(r, c);
+}
+
+// 辺 (states[0..7]) のうち、石のある隅から同じ色で続く石の数の差
+static int edge_stability(const int* states) {
+    int stable[8] = {0};
+    for (int end = 0; end < 2; ++end) {
+        int step = end ? -1 : 1;
+        int i = end ? 7 : 0;
+        int color = states[i];
+        for (; color != 0 && i >= 0 && i < 8 && states[i] == color;
+             i += step) {
+            stable[i] = color;
+        }
+    }
+    int score = 0;
+    for (int i = 0; i < 8; ++i) {
+        score += stable[i] == 1 ? 1 : stable[i] == 2 ? -1 : 0;
+    }
+    return score;
+}
+
+static int build_tables(void) {
+    // マスごとに、いくつのパターンに含まれるか
+    int coverage[BOARD_SIZE * BOARD_SIZE] = {0};
+    for (int i = 0; i < AI_EVAL_INSTANCES; ++i) {
+        int g = kInstances[i].group;
+        for (int j = 0; j < kGroups[g].length; ++j) {
+            coverage[transform_square(kGroups[g].squares[j][0],
+                                      kGroups[g].squares[j][1],
+                                      kInstances[i].transform)]++;
+        }
+    }
+
+    for (int g = 0; g < GROUP_COUNT; ++g) {
+        int length = kGroups[g].length;
+        int size = power3(length);
+        pattern_tables[g] = malloc(size * sizeof(int16_t));
+        if (pattern_tables[g] == NULL) {
+            LOG_ERROR("Failed to allocate evaluation tables: %m");
+            return -1;
+        }
+        int squares[AI_EVAL_MAX_LEN];
+        for (int j = 0; j < length; ++j) {
+            squares[j] = SQUARE_INDEX(kGroups[g].squares[j][0],
+                                      kGroups[g].squares[j][1]);
+        }
+
+        for (int index = 0; index < size; ++index) {
+            int states[AI_EVAL_MAX_LEN];
+            int state_of[BOARD_SIZE * BOARD_SIZE] = {0};
+            for (int j = 0, x = index; j < length; ++j, x /= 3) {
+                states[j] = x % 3;
+                state_of[squares[j]] = states[j];
+            }
+            int value = 0;
+            for (int j = 0; j < length; ++j) {
+                if (states[j] == 0) continue;
+                int weight = ai_square_weights[squares[j]];
+                // 隅が埋まっていれば、その隣は危険なマスではない
+                int corner = danger_corner(squares[j]);
+                if (corner != -1 && state_of[corner] != 0) {
+                    weight = 0;
+                }
+                int share = weight / coverage[squares[j]];
+                value += states[j] == 1 ? share : -share;
+            }
+            if (g == GROUP_EDGE) {
+                value += AI_EVAL_STABLE_WEIGHT * edge_stability(states);
+            }
+            pattern_tables[g][index] = (int16_t)value;
+        }
+    }
+    return 0;
+}
+
+// --- 添字の計算 ---
+
+// 全パターンの添字から評価値を合計する
+static inline int sum_tables(const uint64_t* index) {
+    int sum = 0;
+    for (int i = 0; i < AI_EVAL_INSTANCES; ++i) {
+        sum += pattern_tables[kInstances[i].group][index[i]];
+    }
+    return sum;
+}
+
+static int evaluate_patterns_scalar(Bitboard player, Bitboard opponent) {
+    uint64_t index[AI_EVAL_VECTORS * AI_EVAL_LANES];
+    for (int i = 0; i < AI_EVAL_INSTANCES; ++i) {
+        int v = i / AI_EVAL_LANES;
+        int l = i % AI_EVAL_LANES;
+        uint64_t x = 0;
+        for (int j = AI_EVAL_MAX_LEN - 1; j >= 0; --j) {
+            uint64_t s = pattern_shifts[v][j][l];
+            x *= 3;
+            if (s < AI_EVAL_NO_SQUARE) {
+                x += ((player >> s) & 1) + 2 * ((opponent >> s) & 1);
+            }
+        }
+        index[i] = x;
+    }
+    return sum_tables(index);
+}
+
+#ifdef AI_EVAL_HAVE_AVX2
+// 4パターン分の添字をまとめて計算する。シフト量 64 以上のレーンは
+// _mm256_srlv_epi64 が 0 を返すので、空きの枠は分岐なしで空きと読める
+__attribute__((target("avx2"))) static int evaluate_patterns_avx2(
+    Bitboard player, Bitboard opponent) {
+    uint64_t index[AI_EVAL_VECTORS * AI_EVAL_LANES]
+        __attribute__((aligned(32)));
+    __m256i p = _mm256_set1_epi64x((long long)player);
+    __m256i o = _mm256_set1_epi64x((long long)opponent);
+    __m256i one = _mm256_set1_epi64x(1);
+    for (int v = 0; v < AI_EVAL_VECTORS; ++v) {
+        __m256i x = _mm256_setzero_si256();
+        for (int j = AI_EVAL_MAX_LEN - 1; j >= 0; --j) {
+            __m256i s = _mm256_load_si256((const __m256i*)pattern_shifts[v][j]);
+            __m256i bp = _mm256_and_si256(_mm256_srlv_epi64(p, s), one);
+            __m256i bo = _mm256_and_si256(_mm256_srlv_epi64(o, s), one);
+            __m256i digit = _mm256_add_epi64(bp, _mm256_add_epi64(bo, bo));
+            x = _mm256_add_epi64(x, _mm256_add_epi64(x, x));  // x *= 3
+            x = _mm256_add_epi64(x, digit);
+        }
+        _mm256_store_si256((__m256i*)&index[v * AI_EVAL_LANES], x);
+    }
+    return sum_tables(index);
+}
+#endif
+
+void ai_eval_init(void) {
+    for (int v = 0; v < AI_EVAL_VECTORS; ++v) {
+        for (int j = 0; j < AI_EVAL_MAX_LEN; ++j) {
+            for (int l = 0; l < AI_EVAL_LANES; ++l) {
+                int i = v * AI_EVAL_LANES + l;
+                pattern_shifts[v][j][l] = AI_EVAL_NO_SQUARE;
+                if (i >= AI_EVAL_INSTANCES) continue;
+                int g = kInstances[i].group;
+                if (j < kGroups[g].length) {
+                    pattern_shifts[v][j][l] = transform_square(
+                        kGroups[g].squares[j][0], kGroups[g].squares[j][1],
+                        kInstances[i].transform);
+                }
+            }
+        }
+    }
+    if (build_tables() < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    evaluate_impl = evaluate_patterns_scalar;
+    impl_name = "scalar";
+#ifdef AI_EVAL_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        evaluate_impl = evaluate_patterns_avx2;
+        impl_name = "avx2";
+    }
+#endif
+    LOG_INFO("AI evaluation: %d patterns (%s).", AI_EVAL_INSTANCES, impl_name);
+}
+
+const char* ai_eval_impl_name(void) { return impl_name; }
+
+int ai_evaluate(Bitboard player, Bitboard opponent) {
+    int mobility =
+        __builtin_popcountll(bitboard_legal_moves(player, opponent)) -
+        __builtin_popcountll(bitboard_legal_moves(opponent, player));
+    return evaluate_impl(player, opponent) + AI_MOBILITY_WEIGHT * mobility;
+}
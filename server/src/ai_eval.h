@@ -0,0 +1,27 @@
+#ifndef AI_EVAL_H
+#define AI_EVAL_H
+
+#include "game_logic.h"
+
+// --- AI の局面評価 ---
+// 盤面を辺・隅・2列目・対角線のパターンに分け、各パターンの石の並び
+// (空き・手番側・相手の3値) を3進数の添字にして評価値の表を引き、合計する。
+// 同じ形のパターン (盤面を回転・反転したもの) は同じ表を使う。
+// 添字の計算は AVX2 で4パターンずつまとめて行い、AVX2 の無い CPU では
+// 同じ計算をスカラーで行う (起動時に CPUID で選ぶ)。
+
+#define AI_MOBILITY_WEIGHT 10  // 合法手1つあたりの重み
+
+// マスごとの重み (隅を高く、隅の隣を低く評価する。手の並べ替えにも使う)
+extern const int ai_square_weights[BOARD_SIZE * BOARD_SIZE];
+
+// 評価値の表を作り、添字計算の実装を選ぶ (起動時に1回呼ぶ)
+void ai_eval_init(void);
+
+// 選ばれた添字計算の実装の名前 ("avx2" / "scalar")
+const char* ai_eval_impl_name(void);
+
+// 手番側から見た静的評価 (パターンの評価値の合計 + 合法手の数の差)
+int ai_evaluate(Bitboard player, Bitboard opponent);
+
+#endif  // AI_EVAL_H
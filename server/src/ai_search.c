@@ -0,0 +1,310 @@
+#include "ai_search.h"
+
+#include <time.h>
+
+#include "ai_eval.h"
+#include "book.h"
+#include "endgame.h"
+#include "transposition.h"
+
+#define AI_INFINITY (AI_WIN_SCORE * 2)  // どの評価値よりも大きい値
+#define AI_TIME_CHECK_INTERVAL 1024  // 時間切れを確認する局面数の間隔 (2の冪)
+#define AI_ORDER_MOBILITY_DEPTH 3  // この深さ以上では相手の合法手数で並べ替える
+#define AI_TT_MIN_DEPTH 2  // 置換表を使う最小の深さ (浅い局面は読み直す方が速い)
+#define AI_ENDGAME_BUDGET_PERCENT 75  // 終盤の読み切りに使う持ち時間の割合
+
+// 1回の ai_search の作業領域
+typedef struct {
+    uint64_t deadline_ms;  // これを過ぎたら探索を打ち切る
+    const int* stop;       // 1 になったら打ち切る (ヘルパー用、NULL なら無し)
+    uint64_t nodes;
+    int aborted;  // 1 なら時間切れ (以降の評価値は使わない)
+    // 置換表の参照回数 (探索の終わりに累計へ足す)
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    uint64_t tt_stores;
+} SearchContext;
+
+uint64_t ai_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// --- 評価 ---
+
+// player の合法手の数
+static inline int mobility(Bitboard player, Bitboard opponent) {
+    return __builtin_popcountll(bitboard_legal_moves(player, opponent));
+}
+
+// 最終石差を評価値に直す (勝敗を最優先し、同じ勝ちなら石差の大きい方を選ぶ)
+static int score_from_diff(int diff) {
+    if (diff > 0) return AI_WIN_SCORE + diff;
+    if (diff < 0) return -AI_WIN_SCORE + diff;
+    return 0;
+}
+
+// 終局の評価
+static int final_score(Bitboard player, Bitboard opponent) {
+    return score_from_diff(__builtin_popcountll(player) -
+                           __builtin_popcountll(opponent));
+}
+
+// --- 手の並べ替え ---
+
+// moves を有望な順に out に並べる。first は最初に試す手 (-1 なら無し)
+// 戻り値: 手の数
+static int order_moves(Bitboard player, Bitboard opponent, Bitboard moves,
+                       int first, int depth, int* out) {
+    int keys[64];
+    int n = 0;
+    for (Bitboard b = moves; b; b &= b - 1) {
+        int sq = __builtin_ctzll(b);
+        int key = ai_square_weights[sq];
+        if (sq == first) {
+            key = AI_INFINITY;
+        } else if (depth >= AI_ORDER_MOBILITY_DEPTH) {
+            // 相手の合法手が少なくなる手ほど先に試す
+            Bitboard flips = bitboard_flips(player, opponent, sq);
+            Bitboard next_player = player | flips | ((Bitboard)1 << sq);
+            Bitboard next_opponent = opponent & ~flips;
+            key -= AI_MOBILITY_WEIGHT * mobility(next_opponent, next_player);
+        }
+        // 挿入ソート (合法手は高々30手程度)
+        int i = n++;
+        while (i > 0 && keys[i - 1] < key) {
+            keys[i] = keys[i - 1];
+            out[i] = out[i - 1];
+            --i;
+        }
+        keys[i] = key;
+        out[i] = sq;
+    }
+    return n;
+}
+
+// --- 探索 ---
+
+// 手番 color (1:黒, 2:白) の player が square に置き flips を裏返した後の
+// ハッシュ (手番も相手に移る)
+static inline uint64_t child_hash(uint64_t hash, int color, int square,
+                                  Bitboard flips) {
+    return zobrist_move(hash, color, square, flips) ^ zobrist_side_key;
+}
+
+// player (色 color) の手番で depth 手読んだ評価値を返す (negamax)
+// hash: 手番込みの局面のハッシュ
+// passed: 直前の手がパスだったか (連続パスなら終局)
+static int negamax(SearchContext* ctx, Bitboard player, Bitboard opponent,
+                   int color, uint64_t hash, int depth, int alpha, int beta,
+                   int passed) {
+    if ((++ctx->nodes & (AI_TIME_CHECK_INTERVAL - 1)) == 0 &&
+        (ai_now_ms() >= ctx->deadline_ms ||
+         (ctx->stop && __atomic_load_n(ctx->stop, __ATOMIC_RELAXED)))) {
+        ctx->aborted = 1;
+    }
+    if (ctx->aborted) {
+        return 0;
+    }
+
+    Bitboard moves = bitboard_legal_moves(player, opponent);
+    if (moves == 0) {
+        if (passed) {
+            return final_score(player, opponent);
+        }
+        // パス (深さは消費しない)
+        return -negamax(ctx, opponent, player, 3 - color,
+                        hash ^ zobrist_side_key, depth, -beta, -alpha, 1);
+    }
+    if (depth == 0) {
+        return ai_evaluate(player, opponent);  // ai_eval.c
+    }
+
+    // 置換表: 十分深く読んだ値があれば使い、無くても最善手は先に試す
+    int use_tt = depth >= AI_TT_MIN_DEPTH;
+    int tt_move = -1;
+    int alpha_orig = alpha;
+    if (use_tt) {
+        TtResult tt;
+        ctx->tt_probes++;
+        if (tt_probe(hash, &tt)) {
+            ctx->tt_hits++;
+            if (tt.move != TT_NO_MOVE) {
+                tt_move = tt.move;
+            }
+            if (tt.depth >= depth &&
+                (tt.bound == TT_BOUND_EXACT ||
+                 (tt.bound == TT_BOUND_LOWER && tt.score >= beta) ||
+                 (tt.bound == TT_BOUND_UPPER && tt.score <= alpha))) {
+                return tt.score;
+            }
+        }
+    }
+
+    int order[64];
+    int n = order_moves(player, opponent, moves, tt_move, depth, order);
+    int best = -AI_INFINITY;
+    int best_move = TT_NO_MOVE;
+    for (int i = 0; i < n; ++i) {
+        int sq = order[i];
+        Bitboard flips = bitboard_flips(player, opponent, sq);
+        int score = -negamax(ctx, opponent & ~flips,
+                             player | flips | ((Bitboard)1 << sq), 3 - color,
+                             child_hash(hash, color, sq, flips), depth - 1,
+                             -beta, -alpha, 0);
+        if (ctx->aborted) {
+            return 0;
+        }
+        if (score > best) {
+            best = score;
+            best_move = sq;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) break;  // βカット
+            }
+        }
+    }
+
+    if (use_tt) {
+        int bound = (best <= alpha_orig) ? TT_BOUND_UPPER
+                    : (best >= beta)     ? TT_BOUND_LOWER
+                                         : TT_BOUND_EXACT;
+        tt_store(hash, depth, bound, best, best_move);
+        ctx->tt_stores++;
+    }
+    return best;
+}
+
+// ルート局面を depth 手読み、最善手を *best_move に返す
+// 時間切れの場合も、読み終えた手の中での最善手を返す (無ければ -1)
+// rotate: 手を試す順をずらす数 (ヘルパーごとに別の手から読ませる)
+static int search_root(SearchContext* ctx, Bitboard player, Bitboard opponent,
+                       int color, uint64_t hash, int depth, int first,
+                       int rotate, int* best_move) {
+    int order[64];
+    int n = order_moves(player, opponent,
+                        bitboard_legal_moves(player, opponent), first, depth,
+                        order);
+    int alpha = -AI_INFINITY;
+    *best_move = -1;
+    for (int i = 0; i < n; ++i) {
+        int sq = order[(i + rotate) % n];
+        Bitboard flips = bitboard_flips(player, opponent, sq);
+        int score = -negamax(ctx, opponent & ~flips,
+                             player | flips | ((Bitboard)1 << sq), 3 - color,
+                             child_hash(hash, color, sq, flips), depth - 1,
+                             -AI_INFINITY, -alpha, 0);
+        if (ctx->aborted) {
+            break;
+        }
+        if (score > alpha) {
+            alpha = score;
+            *best_move = sq;
+        }
+    }
+    return alpha;
+}
+
+void ai_search(Bitboard player, Bitboard opponent, int color, uint64_t hash,
+               int time_budget_ms, AiSearchResult* result) {
+    Bitboard moves = bitboard_legal_moves(player, opponent);
+    memset(result, 0, sizeof(*result));
+    result->move = moves ? __builtin_ctzll(moves) : -1;
+    if (moves == 0 || (moves & (moves - 1)) == 0) {
+        return;  // パス、または合法手が1つだけ
+    }
+
+    uint64_t start = ai_now_ms();
+    SearchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.deadline_ms = start + time_budget_ms;
+    if (color == 2) {
+        hash ^= zobrist_side_key;  // 置換表・定石のキーは手番込み
+    }
+
+    // 定石にある局面は読まずに答える
+    BookEntry book;
+    if (book_probe(hash, &book) && book.move < 64 &&
+        (moves >> book.move) & 1) {
+        result->move = book.move;
+        result->score = book.score;
+        result->depth = book.depth;
+        result->from_book = 1;
+        return;
+    }
+
+    tt_new_search();
+
+    int empties = 64 - __builtin_popcountll(player | opponent);
+    if (empties <= endgame_empties) {
+        // 終盤は持ち時間の大半を使って読み切りを試み、間に合わなければ
+        // 残りの時間で通常の反復深化を行う
+        EndgameResult eg;
+        uint64_t eg_deadline =
+            start + (uint64_t)time_budget_ms * AI_ENDGAME_BUDGET_PERCENT / 100;
+        int solved = endgame_solve(player, opponent, eg_deadline, &eg);
+        ctx.nodes += eg.nodes;
+        if (solved) {
+            result->move = eg.move;
+            result->score = score_from_diff(eg.score);
+            result->depth = empties;
+            result->nodes = ctx.nodes;
+            return;
+        }
+    }
+
+    int max_depth = empties < AI_MAX_DEPTH ? empties : AI_MAX_DEPTH;
+    for (int depth = 1; depth <= max_depth; ++depth) {
+        int move;
+        int score = search_root(&ctx, player, opponent, color, hash, depth,
+                                result->move, 0, &move);
+        if (ctx.aborted) {
+            // 前回の最善手を最初に読んでいるので、それを上回った手は採用できる
+            if (move != -1) {
+                result->move = move;
+            }
+            break;
+        }
+        result->move = move;
+        result->score = score;
+        result->depth = depth;
+        // 次の深さは今回の数倍かかるので、残り時間が半分を切ったらやめる
+        if (ai_now_ms() - start >= (uint64_t)time_budget_ms / 2) {
+            break;
+        }
+    }
+    result->nodes = ctx.nodes;
+    result->tt_probes = ctx.tt_probes;
+    result->tt_hits = ctx.tt_hits;
+    tt_add_stats(ctx.tt_probes, ctx.tt_hits, ctx.tt_stores);
+}
+
+uint64_t ai_search_helper(Bitboard player, Bitboard opponent, int color,
+                          uint64_t hash, uint64_t deadline_ms,
+                          int helper_index, const int* stop) {
+    SearchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.deadline_ms = deadline_ms;
+    ctx.stop = stop;
+    if (color == 2) {
+        hash ^= zobrist_side_key;
+    }
+
+    // メインと同じ深さを同じ順で読むと置換表の結果を待つだけになるので、
+    // 奇数番目のヘルパーは1手深い所から始め、ルートの手の順もずらす
+    int empties = 64 - __builtin_popcountll(player | opponent);
+    int max_depth = empties < AI_MAX_DEPTH ? empties : AI_MAX_DEPTH;
+    int first = -1;
+    for (int depth = 1 + (helper_index & 1); depth <= max_depth; ++depth) {
+        int move;
+        search_root(&ctx, player, opponent, color, hash, depth, first,
+                    helper_index, &move);
+        if (ctx.aborted) {
+            break;
+        }
+        first = move;
+    }
+    tt_add_stats(ctx.tt_probes, ctx.tt_hits, ctx.tt_stores);
+    return ctx.nodes;
+}
@@ -0,0 +1,47 @@
+#ifndef AI_SEARCH_H
+#define AI_SEARCH_H
+
+#include "game_logic.h"
+
+// --- AI の指し手探索 ---
+// ビットボード上の negamax (alpha-beta) を反復深化で深くしていき、
+// 持ち時間を使い切った時点で最後に読み切った深さの最善手を返す。
+// 読んだ局面は Zobrist ハッシュをキーに置換表 (transposition.c) に残し、
+// 同じ局面の読み直しと、前の深さの最善手からの並べ替えに使う。
+// 同じ局面を複数のスレッドで探索するときは (Lazy SMP)、1つのスレッドが
+// ai_search で手を決め、残りは ai_search_helper で置換表を埋めて手伝う
+// 定石 (book.c) にある局面は探索せずにその手を返す
+// 空きマスが endgame_empties 以下なら、まず終局まで読み切る (endgame.c)
+// 探索は呼び出し元のスレッドで行う (ai_worker.c のワーカーから呼ぶ)
+
+#define AI_MAX_DEPTH 60     // 反復深化の最大深さ (空きマス数で打ち切る)
+#define AI_WIN_SCORE 10000  // 終局の評価値 (勝ちなら AI_WIN_SCORE + 石差)
+
+// 探索結果
+typedef struct {
+    int move;            // 最善手のマス (0-63)、合法手がなければ -1
+    int score;           // 手番側から見た評価値
+    int depth;           // 読み切った深さ
+    uint64_t nodes;      // 探索した局面数
+    uint64_t tt_probes;  // 置換表を引いた回数
+    uint64_t tt_hits;    // そのうち局面が見つかった回数
+    int from_book;       // 1 なら定石 (book.c) から答えた
+} AiSearchResult;
+
+// 現在時刻 (CLOCK_MONOTONIC のミリ秒)。探索の締め切りの計算に使う
+uint64_t ai_now_ms(void);
+
+// 色 color (1:黒, 2:白) の player の手番で time_budget_ms ミリ秒まで探索し、
+// result に最善手を返す。hash は石の配置のハッシュ (GameState.hash)
+// 合法手が1つだけなら探索せずに返す
+void ai_search(Bitboard player, Bitboard opponent, int color, uint64_t hash,
+               int time_budget_ms, AiSearchResult* result);
+
+// ai_search の探索を手伝う (Lazy SMP のヘルパー)
+// 同じ局面を置換表を共有しながら読むだけで、結果の手は返さない
+// deadline_ms を過ぎるか *stop が 1 になるまで読む。戻り値: 探索した局面数
+uint64_t ai_search_helper(Bitboard player, Bitboard opponent, int color,
+                          uint64_t hash, uint64_t deadline_ms,
+                          int helper_index, const int* stop);
+
+#endif  // AI_SEARCH_H
@@ -0,0 +1,332 @@
+#include "ai_worker.h"
+
+#include "ai_search.h"
+#include "endgame.h"
+#include "logger.h"
+#include "transposition.h"
+
+// 要求の種類
+typedef enum {
+    AI_JOB_MOVE,     // AI の着手
+    AI_JOB_ANALYSIS  // 終局後の棋譜解析
+} AiJobType;
+
+// 思考要求 (キューの1要素)
+typedef struct AiJob {
+    AiJobType type;
+    int roomId;
+    // AI_JOB_MOVE
+    int move_seq;
+    int color;
+    Bitboard player;
+    Bitboard opponent;
+    uint64_t hash;
+    int time_budget_ms;
+    // AI_JOB_ANALYSIS
+    int client_sock;
+    int move_count;
+    uint8_t moves[BOARD_SIZE * BOARD_SIZE];
+    struct AiJob* next;
+    // 並列探索の状態 (AI_JOB_MOVE、queue_mutex で保護)
+    unsigned int search_id;  // 探索ごとの通し番号
+    uint64_t deadline_ms;    // ヘルパーの締め切り
+    int threads;             // 探索中のスレッド数 (メイン込み)
+    int peak_threads;        // 同時に探索したスレッド数の最大
+    int next_helper;         // 次に加わるヘルパーの番号
+    uint64_t helper_nodes;   // ヘルパーが探索した局面数の合計
+} AiJob;
+
+// ワーカースレッド1本分の状態 (queue_mutex で保護)
+typedef struct {
+    int stop;                  // 1 ならヘルパーの探索をやめる (__atomic)
+    AiJob* leading;            // メインとして探索中で、ヘルパーを受け付ける要求
+    AiJob* helping;            // ヘルパーとして手伝っている要求
+    unsigned int skip_search;  // 読み終えたのでもう手伝わない探索の番号
+} AiWorker;
+
+// 要求の FIFO キュー
+typedef struct {
+    AiJob* head;
+    AiJob* tail;
+} AiJobQueue;
+
+// 着手の要求と棋譜解析の要求は別のキューに積み、着手を先に取り出す
+// (解析はワーカーを数秒占有するため、AI の持ち時間切れを起こさないように)
+static AiJobQueue move_queue = {NULL, NULL};
+static AiJobQueue analysis_queue = {NULL, NULL};
+static int queue_length = 0;      // 両方のキューで待っている要求の数
+static int analysis_running = 0;  // 棋譜解析を実行中のワーカー数
+static int analysis_limit = 1;    // 棋譜解析に同時に使うワーカー数の上限
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+// ヘルパーが探索から抜けたことをメインに知らせる
+static pthread_cond_t helper_cond = PTHREAD_COND_INITIALIZER;
+
+static AiWorker* workers = NULL;
+static int worker_count = 0;
+static unsigned int next_search_id = 1;
+
+static AiMoveCallback move_callback = NULL;
+static AiAnalysisCallback analysis_callback = NULL;
+
+// 置換表のヒット率 (%)
+static double hit_rate(uint64_t hits, uint64_t probes) {
+    return probes ? 100.0 * hits / probes : 0.0;
+}
+
+// ヘルパーを受け付けている探索のうち、スレッド数が最も少ないもの
+// (queue_mutex ロック中に呼ぶ)
+static AiJob* least_loaded_search(const AiWorker* self) {
+    AiJob* best = NULL;
+    for (int i = 0; i < worker_count; ++i) {
+        AiJob* job = workers[i].leading;
+        if (job != NULL && job->search_id != self->skip_search &&
+            (best == NULL || job->threads < best->threads)) {
+            best = job;
+        }
+    }
+    return best;
+}
+
+// ヘルパーとして探索している全ワーカーを呼び戻す (queue_mutex ロック中)
+static void recall_helpers(const AiJob* only) {
+    for (int i = 0; i < worker_count; ++i) {
+        if (workers[i].helping != NULL &&
+            (only == NULL || workers[i].helping == only)) {
+            __atomic_store_n(&workers[i].stop, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// job の探索にヘルパーとして加わり、メインが終えるか呼び戻されるまで読む
+// (queue_mutex ロック中に呼び、ロック中で戻る)
+static void help_search(AiWorker* self, AiJob* job) {
+    int helper_index = ++job->next_helper;
+    job->threads++;
+    if (job->threads > job->peak_threads) {
+        job->peak_threads = job->threads;
+    }
+    self->helping = job;
+    __atomic_store_n(&self->stop, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&queue_mutex);
+
+    uint64_t nodes =
+        ai_search_helper(job->player, job->opponent, job->color, job->hash,
+                         job->deadline_ms, helper_index, &self->stop);
+
+    pthread_mutex_lock(&queue_mutex);
+    if (!__atomic_load_n(&self->stop, __ATOMIC_RELAXED)) {
+        self->skip_search = job->search_id;  // 最大深さまで読み終えた
+    }
+    job->helper_nodes += nodes;
+    job->threads--;
+    self->helping = NULL;
+    pthread_cond_broadcast(&helper_cond);
+}
+
+static void run_move(AiWorker* self, AiJob* job) {
+    // 分岐が1つしかない局面と、置換表を使わない完全読みの局面は1スレッドで読む
+    Bitboard moves = bitboard_legal_moves(job->player, job->opponent);
+    int empties = 64 - __builtin_popcountll(job->player | job->opponent);
+    int parallel = worker_count > 1 && (moves & (moves - 1)) != 0 &&
+                   empties > endgame_empties;
+
+    pthread_mutex_lock(&queue_mutex);
+    job->search_id = next_search_id++;
+    job->deadline_ms = ai_now_ms() + job->time_budget_ms;
+    job->threads = 1;
+    job->peak_threads = 1;
+    job->next_helper = 0;
+    job->helper_nodes = 0;
+    if (parallel) {
+        self->leading = job;
+        pthread_cond_broadcast(&queue_cond);  // 空いているワーカーを呼ぶ
+    }
+    pthread_mutex_unlock(&queue_mutex);
+
+    AiSearchResult result;
+    ai_search(job->player, job->opponent, job->color, job->hash,
+              job->time_budget_ms, &result);
+
+    // ヘルパーを止め、全員が job から離れるのを待つ
+    pthread_mutex_lock(&queue_mutex);
+    self->leading = NULL;
+    recall_helpers(job);
+    while (job->threads > 1) {
+        pthread_cond_wait(&helper_cond, &queue_mutex);
+    }
+    pthread_mutex_unlock(&queue_mutex);
+
+    TtStats total;
+    tt_get_stats(&total);
+    LOG_INFO("AI: room %d move %d -> square %d (score %d, depth %d, %llu "
+             "nodes, %d threads, TT hit %.1f%%, total %.1f%%)%s",
+             job->roomId, job->move_seq, result.move, result.score,
+             result.depth,
+             (unsigned long long)(result.nodes + job->helper_nodes),
+             job->peak_threads, hit_rate(result.tt_hits, result.tt_probes),
+             hit_rate(total.hits, total.probes),
+             result.from_book ? " [book]" : "");
+
+    move_callback(job->roomId, job->move_seq, result.move);
+}
+
+static void run_analysis(const AiJob* job) {
+    GameAnalysisEntry entries[MAX_ANALYSIS_MOVES];
+    uint64_t start = ai_now_ms();
+    int count =
+        endgame_analyze_game(job->moves, job->move_count,
+                             start + AI_ANALYSIS_TIME_MS, entries,
+                             MAX_ANALYSIS_MOVES);
+    LOG_INFO("AI: analyzed room %d (%d moves) in %llu ms.", job->roomId, count,
+             (unsigned long long)(ai_now_ms() - start));
+
+    analysis_callback(job->client_sock, job->roomId, entries, count);
+}
+
+// 要求をキューの末尾に積み、待っているワーカーを1つ起こす
+static void enqueue_job(AiJobQueue* queue, AiJob* job) {
+    job->next = NULL;
+    pthread_mutex_lock(&queue_mutex);
+    if (queue->tail != NULL) {
+        queue->tail->next = job;
+    } else {
+        queue->head = job;
+    }
+    queue->tail = job;
+    ++queue_length;
+    // 着手の要求なら、ヘルパーを呼び戻して新しい要求を受け持たせ、
+    // 残りは配分し直す。解析は探索が終わってから空いたワーカーが受け持つ
+    if (queue == &move_queue) {
+        recall_helpers(NULL);
+    }
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+// 次に受け持つ要求を取り出す (queue_mutex ロック中に呼ぶ)
+// 着手を優先し、解析は実行中の数が上限未満のときだけ取り出す
+// 戻り値: 受け持てる要求がなければ NULL
+static AiJob* dequeue_job(void) {
+    AiJobQueue* queue = &move_queue;
+    if (queue->head == NULL) {
+        if (analysis_running >= analysis_limit) {
+            return NULL;
+        }
+        queue = &analysis_queue;
+    }
+    AiJob* job = queue->head;
+    if (job == NULL) {
+        return NULL;
+    }
+    queue->head = job->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    --queue_length;
+    if (job->type == AI_JOB_ANALYSIS) {
+        ++analysis_running;
+    }
+    return job;
+}
+
+// 新しい要求を優先して受け持ち、無ければ最も手薄な探索を手伝う
+static void* ai_worker_main(void* arg) {
+    AiWorker* self = arg;
+    pthread_mutex_lock(&queue_mutex);
+    while (1) {
+        AiJob* job = dequeue_job();
+        if (job == NULL) {
+            AiJob* search = least_loaded_search(self);
+            if (search != NULL) {
+                help_search(self, search);
+            } else {
+                pthread_cond_wait(&queue_cond, &queue_mutex);
+            }
+            continue;
+        }
+        pthread_mutex_unlock(&queue_mutex);
+
+        int is_analysis = (job->type == AI_JOB_ANALYSIS);
+        if (is_analysis) {
+            run_analysis(job);
+        } else {
+            run_move(self, job);
+        }
+        free(job);
+        pthread_mutex_lock(&queue_mutex);
+        if (is_analysis) {
+            --analysis_running;
+        }
+    }
+    return NULL;
+}
+
+int ai_worker_queue_depth(void) {
+    pthread_mutex_lock(&queue_mutex);
+    int depth = queue_length;
+    pthread_mutex_unlock(&queue_mutex);
+    return depth;
+}
+
+int ai_worker_start(int threads, AiMoveCallback callback,
+                    AiAnalysisCallback analysis) {
+    move_callback = callback;
+    analysis_callback = analysis;
+    workers = calloc(threads, sizeof(AiWorker));
+    if (workers == NULL) {
+        LOG_ERROR("Failed to allocate AI workers: %m");
+        return -1;
+    }
+    worker_count = threads;
+    // 少なくとも1本は着手のために空けておく (1本しかなければ共用する)
+    analysis_limit = (threads > 1) ? threads - 1 : 1;
+    for (int i = 0; i < threads; ++i) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, ai_worker_main, &workers[i]) != 0) {
+            LOG_ERROR("Failed to create AI worker thread: %m");
+            return -1;
+        }
+        pthread_detach(tid);
+    }
+    LOG_INFO("AI workers started (%d threads).", threads);
+    return 0;
+}
+
+int ai_request_move(int roomId, int move_seq, int color, Bitboard player,
+                    Bitboard opponent, uint64_t hash, int time_budget_ms) {
+    AiJob* job = malloc(sizeof(AiJob));
+    if (job == NULL) {
+        LOG_ERROR("Failed to allocate AI job: %m");
+        return -1;
+    }
+    job->type = AI_JOB_MOVE;
+    job->roomId = roomId;
+    job->move_seq = move_seq;
+    job->color = color;
+    job->player = player;
+    job->opponent = opponent;
+    job->hash = hash;
+    job->time_budget_ms = time_budget_ms;
+    enqueue_job(&move_queue, job);
+    return 0;
+}
+
+int ai_request_analysis(int client_sock, int roomId, const uint8_t* moves,
+                        int count) {
+    if (count < 0 || count > BOARD_SIZE * BOARD_SIZE) {
+        return -1;
+    }
+    AiJob* job = malloc(sizeof(AiJob));
+    if (job == NULL) {
+        LOG_ERROR("Failed to allocate AI job: %m");
+        return -1;
+    }
+    job->type = AI_JOB_ANALYSIS;
+    job->roomId = roomId;
+    job->client_sock = client_sock;
+    job->move_count = count;
+    memcpy(job->moves, moves, count);
+    enqueue_job(&analysis_queue, job);
+    return 0;
+}
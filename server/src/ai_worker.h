@@ -0,0 +1,49 @@
+#ifndef AI_WORKER_H
+#define AI_WORKER_H
+
+#include "game_logic.h"
+
+// --- AI の思考スレッド ---
+// AI の手番になった部屋は思考要求をキューに積み、専用のワーカースレッドが
+// 探索する。探索は数百ミリ秒以上かかるため、リアクタスレッドでは行わない。
+// 結果はワーカースレッドからコールバックで返す。
+// 終局後の棋譜解析 (endgame.c の完全読み) も同じスレッドで行うが、
+// 着手の要求を先に処理し、ワーカーが2本以上あれば1本は解析に使わない。
+
+#define DEFAULT_AI_THREADS 2          // ワーカースレッド数 (既定値)
+#define DEFAULT_AI_MOVE_TIME_MS 1000  // 1手の思考時間 (既定値)
+#define AI_MIN_MOVE_TIME_MS 50        // 要求で指定できる思考時間の下限
+#define AI_MAX_MOVE_TIME_MS 10000     // 要求で指定できる思考時間の上限
+#define AI_ANALYSIS_TIME_MS 5000      // 1回の棋譜解析に使う時間の上限
+
+// 探索結果を受け取る関数 (ワーカースレッドから、ロックなしで呼ばれる)
+// move_seq は要求時の着手番号。部屋側で照合し、古ければ捨てること
+// square は着手するマス (0-63)、合法手がなければ -1
+typedef void (*AiMoveCallback)(int roomId, int move_seq, int square);
+
+// 棋譜解析の結果を受け取る関数 (ワーカースレッドから、ロックなしで呼ばれる)
+// client_sock は要求元。部屋側で要求元がまだ部屋にいるか確かめること
+typedef void (*AiAnalysisCallback)(int client_sock, int roomId,
+                                   const GameAnalysisEntry* entries,
+                                   int count);
+
+// ワーカースレッドを起動する。戻り値: 失敗時 -1
+int ai_worker_start(int threads, AiMoveCallback callback,
+                    AiAnalysisCallback analysis_callback);
+
+// 思考要求をキューに積む (room_mutex ロック中でもよい)
+// player/opponent は AI (色 color) と相手の石、hash は GameState.hash
+// 戻り値: 失敗時 -1
+int ai_request_move(int roomId, int move_seq, int color, Bitboard player,
+                    Bitboard opponent, uint64_t hash, int time_budget_ms);
+
+// 棋譜解析要求をキューに積む (room_mutex ロック中でもよい)
+// moves/count は GameState.move_history/move_seq
+// 戻り値: 失敗時 -1
+int ai_request_analysis(int client_sock, int roomId, const uint8_t* moves,
+                        int count);
+
+// キューで待っている要求の数 (着手と解析の合計、計測値用)
+int ai_worker_queue_depth(void);
+
+#endif  // AI_WORKER_H
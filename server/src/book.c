@@ -0,0 +1,105 @@
+#include "book.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+// mmap した定石 (起動後は読み取り専用なのでロックは不要)
+static const BookEntry* book_entries = NULL;
+static size_t book_count = 0;
+
+int book_open(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open opening book: %m");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        LOG_ERROR("Failed to stat opening book: %m");
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(BookHeader)) {
+        LOG_ERROR("Opening book %s is too small.", path);
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // マッピングはファイルを閉じても残る
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Failed to mmap opening book: %m");
+        return -1;
+    }
+
+    const BookHeader* header = map;
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(header->magic)) != 0 ||
+        (size_t)st.st_size !=
+            sizeof(BookHeader) + header->entry_count * sizeof(BookEntry)) {
+        LOG_ERROR("Opening book %s is corrupt.", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    // 二分探索は飛び飛びに読むので先読みを抑える
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    book_entries = (const BookEntry*)(header + 1);
+    book_count = header->entry_count;
+    LOG_INFO("Opening book: %zu positions (%s).", book_count, path);
+    return 0;
+}
+
+int book_probe(uint64_t key, BookEntry* out) {
+    size_t lo = 0;
+    size_t hi = book_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint64_t k = book_entries[mid].key;
+        if (k == key) {
+            *out = book_entries[mid];
+            return 1;
+        }
+        if (k < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    uint64_t ka = ((const BookEntry*)a)->key;
+    uint64_t kb = ((const BookEntry*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+int book_write(const char* path, BookEntry* entries, size_t count) {
+    qsort(entries, count, sizeof(BookEntry), compare_entries);
+
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) {
+        LOG_ERROR("Failed to create opening book: %m");
+        return -1;
+    }
+    BookHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+    header.entry_count = (uint32_t)count;
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(entries, sizeof(BookEntry), count, fp) == count;
+    if (fclose(fp) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        LOG_ERROR("Failed to write opening book: %m");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- 定石ファイル ---
+// 序盤の局面ごとの最善手を、局面のキーでソートした固定長レコードの配列として
+// 保存したファイル。起動時に mmap して二分探索で引くだけなので、ヒープは
+// 使わず、同じファイルを開いた複数のプロセスはページキャッシュを共有する。
+// キーは置換表と同じ手番込みの Zobrist ハッシュ
+// (zobrist_hash(黒, 白)、白番なら ^ zobrist_side_key)。
+// 数値はすべてリトルエンディアン (作成したマシンのネイティブ形式) で書く。
+
+#define BOOK_MAGIC "OTHBOOK1"  // ファイル先頭の識別子 (8 バイト)
+
+// ファイルヘッダ (16 バイト)
+typedef struct {
+    char magic[8];         // BOOK_MAGIC
+    uint32_t entry_count;  // 後に続く BookEntry の数
+    uint32_t reserved;
+} BookHeader;
+
+// 1局面分のレコード (16 バイト、key の昇順に並べる)
+typedef struct {
+    uint64_t key;      // 手番込みの局面のハッシュ
+    int16_t score;     // 手番側から見た評価値 (ai_search の評価値)
+    uint8_t move;      // 最善手のマス (0-63)
+    uint8_t depth;     // 作成時に読んだ深さ
+    uint32_t reserved;
+} BookEntry;
+
+_Static_assert(sizeof(BookHeader) == 16, "BookHeader must be 16 bytes");
+_Static_assert(sizeof(BookEntry) == 16, "BookEntry must be 16 bytes");
+
+// 定石ファイルを mmap する (起動時に1回呼ぶ)。戻り値: 失敗時 -1
+int book_open(const char* path);
+
+// key の局面を探し、あれば out に書いて 1 を返す (定石が無ければ常に 0)
+int book_probe(uint64_t key, BookEntry* out);
+
+// entries を key でソートし、定石ファイルとして書き出す (作成ツール用)
+// 戻り値: 失敗時 -1
+int book_write(const char* path, BookEntry* entries, size_t count);
+
+#endif  // BOOK_H
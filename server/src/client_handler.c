@@ -1,29 +1,30 @@
 #include "client_handler.h"
 
-#include <time.h>  // time() 関数を使うために必要
+#include <sys/random.h>  // getrandom (再開用の合言葉)
+#include <time.h>        // time() 関数を使うために必要
 
+#include "ai_worker.h"
 #include "client_management.h"
+#include "event_loop.h"
+#include "game_log.h"
 #include "game_logic.h"  // ゲームロジック関数を使用
+#include "lobby.h"
+#include "logger.h"
+#include "metrics.h"
 #include "room_management.h"
 
 // --- メッセージハンドラ ---
 
 void handle_create_room_request(int client_sock, const Message* msg) {
-    printf("Received CREATE_ROOM request from client sockfd %d\n", client_sock);
+    LOG_DEBUG("Received CREATE_ROOM request from client sockfd %d",
+              client_sock);
 
     // 既に部屋に入っている場合は作成できない
-    pthread_mutex_lock(&clients_mutex);
-    int client_idx = find_client_index(client_sock);
-    int current_room_id = -1;
-    if (client_idx != -1) {
-        current_room_id = clients[client_idx].roomId;
-    }
-    pthread_mutex_unlock(&clients_mutex);
+    int current_room_id = get_client_room_id(client_sock);
 
     if (current_room_id != -1) {
-        fprintf(
-            stderr,
-            "Client sockfd %d tried to create room while already in room %d.\n",
+        LOG_ERROR(
+            "Client sockfd %d tried to create room while already in room %d.",
             client_sock, current_room_id);
         Message response;
         response.type = MSG_CREATE_ROOM_RESPONSE;
@@ -32,7 +33,7 @@ void handle_create_room_request(int client_sock, const Message* msg) {
         snprintf(response.data.createRoomResp.message,
                  sizeof(response.data.createRoomResp.message),
                  "You are already in a room (%d).", current_room_id);
-        sendMessage(client_sock, &response);
+        send_to_client(client_sock, &response);
         return;
     }
 
@@ -55,29 +56,20 @@ void handle_create_room_request(int client_sock, const Message* msg) {
                  sizeof(response.data.createRoomResp.message),
                  "Failed to create room (server full or error?).");
     }
-    sendMessage(client_sock, &response);
+    send_to_client(client_sock, &response);
 }
 
 // TODO: 部屋参加リクエスト処理
 void handle_join_room_request(int client_sock, const Message* msg) {
-    printf("Received JOIN_ROOM request from client sockfd %d for room %d\n",
-           client_sock,
-           msg->data.joinRoomReq
-               .roomId);  // joinRoomReq は protocol.h で定義が必要
+    LOG_DEBUG("Received JOIN_ROOM request from client sockfd %d for room %d",
+              client_sock, msg->data.joinRoomReq.roomId);
 
     // 既に部屋に入っている場合は参加できない
-    pthread_mutex_lock(&clients_mutex);
-    int client_idx = find_client_index(client_sock);
-    int current_room_id = -1;
-    if (client_idx != -1) {
-        current_room_id = clients[client_idx].roomId;
-    }
-    pthread_mutex_unlock(&clients_mutex);
+    int current_room_id = get_client_room_id(client_sock);
 
     if (current_room_id != -1) {
-        fprintf(
-            stderr,
-            "Client sockfd %d tried to join room while already in room %d.\n",
+        LOG_ERROR(
+            "Client sockfd %d tried to join room while already in room %d.",
             client_sock, current_room_id);
         // エラー応答
         Message response;
@@ -88,7 +80,7 @@ void handle_join_room_request(int client_sock, const Message* msg) {
         snprintf(response.data.joinRoomResp.message,
                  sizeof(response.data.joinRoomResp.message),
                  "You are already in a room (%d).", current_room_id);
-        sendMessage(client_sock, &response);
+        send_to_client(client_sock, &response);
         return;
     }
 
@@ -121,7 +113,7 @@ void handle_join_room_request(int client_sock, const Message* msg) {
                      result);
         }
     }
-    sendMessage(client_sock, &response);
+    send_to_client(client_sock, &response);
 
     // 参加成功した場合、参加者自身にも PlayerJoinedNotice を送る (任意)
     // または、参加成功応答に相手の情報を載せるなど
@@ -130,64 +122,114 @@ void handle_join_room_request(int client_sock, const Message* msg) {
     }
 }
 
+// --- AI 追加要求 ---
+// 待機中の部屋にプレイヤー2として AI を座らせ、作成者に参加を通知する
+void handle_add_ai_request(int client_sock, const Message* msg) {
+    int roomId = msg->data.addAiReq.roomId;
+    int move_time_ms = msg->data.addAiReq.moveTimeMs;
+    LOG_DEBUG("Received ADD_AI request for room %d from client sockfd %d",
+              roomId, client_sock);
+
+    // 思考時間は既定値・上下限に丸める
+    if (move_time_ms <= 0) {
+        move_time_ms = DEFAULT_AI_MOVE_TIME_MS;
+    } else if (move_time_ms < AI_MIN_MOVE_TIME_MS) {
+        move_time_ms = AI_MIN_MOVE_TIME_MS;
+    } else if (move_time_ms > AI_MAX_MOVE_TIME_MS) {
+        move_time_ms = AI_MAX_MOVE_TIME_MS;
+    }
+
+    int result = add_ai_player(client_sock, roomId, move_time_ms);
+    if (result == roomId) {
+        // 人間の参加と同じく、作成者に参加を通知する
+        Message notify_msg;
+        notify_msg.type = MSG_PLAYER_JOINED_NOTICE;
+        notify_msg.data.playerJoinedNotice.roomId = roomId;
+        send_to_client(client_sock, &notify_msg);
+        return;
+    }
+
+    Message err_msg;
+    err_msg.type = MSG_ERROR_NOTICE;
+    if (result == -1) {
+        snprintf(err_msg.data.errorNotice.message,
+                 sizeof(err_msg.data.errorNotice.message), "Room %d not found.",
+                 roomId);
+    } else if (result == -3) {
+        snprintf(err_msg.data.errorNotice.message,
+                 sizeof(err_msg.data.errorNotice.message),
+                 "Only the room creator (Player 1) can add an AI opponent.");
+    } else {
+        snprintf(err_msg.data.errorNotice.message,
+                 sizeof(err_msg.data.errorNotice.message),
+                 "Room %d already has an opponent or is playing.", roomId);
+    }
+    send_to_client(client_sock, &err_msg);
+}
+
+// 対局開始時に席ごとの再開用の合言葉を発行する (room_mutex ロック中に呼ぶ)
+// 再起動後の MSG_RESUME_REQUEST で照合する。AI の席には発行しない
+static void issue_resume_tokens(Room* room) {
+    int socks[2] = {room->player1_sock, room->player2_sock};
+    for (int i = 0; i < 2; ++i) {
+        uint64_t token = 0;
+        if (socks[i] != AI_PLAYER_SOCK &&
+            getrandom(&token, sizeof(token), 0) != sizeof(token)) {
+            LOG_ERROR("Failed to generate resume token: %m");
+            token = 0;  // 0 は照合しないので再開できないだけ
+        }
+        room->resume_token[i] = token;
+    }
+}
+
 void handle_start_game_request(int client_sock, const Message* msg) {
     int roomId = msg->data.startGameReq.roomId;
-    printf("Received START_GAME request for room %d from client sockfd %d\n",
-           roomId, client_sock);
-
-    pthread_mutex_lock(&rooms_mutex);
-    int room_idx = find_room_index(roomId);
-    if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
-        fprintf(stderr, "Error: Room %d not found for start game request.\n",
-                roomId);
+    LOG_DEBUG("Received START_GAME request for room %d from client sockfd %d",
+              roomId, client_sock);
+
+    Room* room = acquire_room(roomId);  // room_mutex をロックして取得
+    if (room == NULL) {
+        LOG_ERROR("Error: Room %d not found for start game request.", roomId);
         Message err_msg;
         err_msg.type = MSG_ERROR_NOTICE;
         snprintf(err_msg.data.errorNotice.message,
                  sizeof(err_msg.data.errorNotice.message), "Room %d not found.",
                  roomId);
-        sendMessage(client_sock, &err_msg);
+        send_to_client(client_sock, &err_msg);
         return;
     }
 
-    pthread_mutex_lock(&rooms[room_idx].room_mutex);
-    pthread_mutex_unlock(&rooms_mutex);  // リストロック解除
-
-    Room* room = &rooms[room_idx];  // ポインタ取得
-
     // ゲーム開始条件のチェック
     // 1. リクエスト者がプレイヤー1であること
     // 2. 部屋にプレイヤー2が存在すること
     // 3. 部屋の状態が待機中(ROOM_WAITING)であること
     if (room->player1_sock != client_sock) {
         pthread_mutex_unlock(&room->room_mutex);
-        fprintf(stderr, "Error: Client sockfd %d is not player 1 in room %d.\n",
-                client_sock, roomId);
+        LOG_ERROR("Error: Client sockfd %d is not player 1 in room %d.",
+                  client_sock, roomId);
         Message err_msg;
         err_msg.type = MSG_ERROR_NOTICE;
         snprintf(err_msg.data.errorNotice.message,
                  sizeof(err_msg.data.errorNotice.message),
                  "Only the room creator (Player 1) can start the game.");
-        sendMessage(client_sock, &err_msg);
+        send_to_client(client_sock, &err_msg);
         return;
     }
     if (room->player2_sock == -1) {
         pthread_mutex_unlock(&room->room_mutex);
-        fprintf(stderr, "Error: Player 2 has not joined room %d yet.\n",
-                roomId);
+        LOG_ERROR("Error: Player 2 has not joined room %d yet.", roomId);
         Message err_msg;
         err_msg.type = MSG_ERROR_NOTICE;
         snprintf(err_msg.data.errorNotice.message,
                  sizeof(err_msg.data.errorNotice.message),
                  "Waiting for opponent to join.");
-        sendMessage(client_sock, &err_msg);
+        send_to_client(client_sock, &err_msg);
         return;
     }
     if (room->status != ROOM_WAITING) {
         pthread_mutex_unlock(&room->room_mutex);
-        fprintf(stderr,
-                "Error: Room %d is not in WAITING state (current: %d).\n",
-                roomId, room->status);
+        LOG_ERROR("Error: Room %d is not in WAITING state (current: %d).",
+                  roomId, room->status);
         Message err_msg;
         err_msg.type = MSG_ERROR_NOTICE;
         snprintf(err_msg.data.errorNotice.message,
@@ -195,14 +237,17 @@ void handle_start_game_request(int client_sock, const Message* msg) {
                  "Cannot start game in current room state (%d). Game might be "
                  "ongoing or over.",
                  room->status);
-        sendMessage(client_sock, &err_msg);
+        send_to_client(client_sock, &err_msg);
         return;
     }
 
     // ゲーム状態を初期化し、部屋の状態をPLAYINGに変更
     room->status = ROOM_PLAYING;
+    lobby_mark_dirty();  // 部屋一覧に状態の変化を反映
     initialize_game_state(&room->gameState);  // game_logic.c の関数を使用
+    issue_resume_tokens(room);
     room->last_action_time = time(NULL);
+    arm_room_timer(room, TURN_TIMEOUT_SEC);  // 黒番の持ち時間
 
     // 両プレイヤーにゲーム開始を通知
     Message start_notice;
@@ -213,175 +258,178 @@ void handle_start_game_request(int client_sock, const Message* msg) {
 
     // プレイヤー1 (黒) への通知
     start_notice.data.gameStartNotice.yourColor = 1;  // あなたは黒
-    sendMessage(room->player1_sock, &start_notice);
+    start_notice.data.gameStartNotice.resumeToken = room->resume_token[0];
+    send_to_client(room->player1_sock, &start_notice);
 
     // プレイヤー2 (白) への通知
     start_notice.data.gameStartNotice.yourColor = 2;  // あなたは白
-    sendMessage(room->player2_sock, &start_notice);
+    start_notice.data.gameStartNotice.resumeToken = room->resume_token[1];
+    send_to_client(room->player2_sock, &start_notice);
 
     // 最初のプレイヤー(黒番)に手番通知
     Message turn_notice;
     turn_notice.type = MSG_YOUR_TURN_NOTICE;
     turn_notice.data.yourTurnNotice.roomId = roomId;
     if (room->gameState.currentTurn == 1) {
-        sendMessage(room->player1_sock, &turn_notice);
+        send_to_client(room->player1_sock, &turn_notice);
     } else {  // 通常は黒番(1)から始まるはずだが念のため
-        sendMessage(room->player2_sock, &turn_notice);
+        send_to_client(room->player2_sock, &turn_notice);
     }
 
-    printf("Game started in room %d.\n", roomId);
+    LOG_INFO("Game started in room %d.", roomId);
 
     pthread_mutex_unlock(&room->room_mutex);
 }
 
-void handle_place_piece_request(int client_sock, const Message* msg) {
-    int roomId = msg->data.placePieceReq.roomId;
-    uint8_t row = msg->data.placePieceReq.row;
-    uint8_t col = msg->data.placePieceReq.col;
-
-    printf(
-        "Received PLACE_PIECE request for room %d from client sockfd %d at "
-        "(%d, %d)\n",
-        roomId, client_sock, row, col);
-
-    pthread_mutex_lock(&rooms_mutex);
-    int room_idx = find_room_index(roomId);
-    if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
-        fprintf(stderr, "Error: Room %d not found for place piece request.\n",
-                roomId);
-        return;
+// ゲーム終了と再戦の提案を両プレイヤーに通知する (room_mutex は解放して呼ぶ)
+// headline: 勝敗の前に付ける文言 ("Game Over!" など)
+static void notify_game_over(int roomId, int winner, const char* headline,
+                             int p1_sock, int p2_sock) {
+    Message gameover_msg;
+    gameover_msg.type = MSG_GAME_OVER_NOTICE;
+    gameover_msg.data.gameOverNotice.roomId = roomId;
+    gameover_msg.data.gameOverNotice.winner = winner;
+    if (winner == 1)
+        snprintf(gameover_msg.data.gameOverNotice.message,
+                 sizeof(gameover_msg.data.gameOverNotice.message),
+                 "%s Black wins.", headline);
+    else if (winner == 2)
+        snprintf(gameover_msg.data.gameOverNotice.message,
+                 sizeof(gameover_msg.data.gameOverNotice.message),
+                 "%s White wins.", headline);
+    else
+        snprintf(gameover_msg.data.gameOverNotice.message,
+                 sizeof(gameover_msg.data.gameOverNotice.message),
+                 "%s It's a draw.", headline);
+
+    Message rematch_offer_msg;
+    rematch_offer_msg.type = MSG_REMATCH_OFFER_NOTICE;
+    rematch_offer_msg.data.rematchOfferNotice.roomId = roomId;
+
+    if (p1_sock != -1) {
+        send_to_client(p1_sock, &gameover_msg);
+        send_to_client(p1_sock, &rematch_offer_msg);
     }
+    if (p2_sock != -1) {
+        send_to_client(p2_sock, &gameover_msg);
+        send_to_client(p2_sock, &rematch_offer_msg);
+    }
+    LOG_INFO("Sent game over and rematch offer notices for room %d.", roomId);
+}
 
-    pthread_mutex_lock(&rooms[room_idx].room_mutex);
-    pthread_mutex_unlock(&rooms_mutex);
+// 再戦の返答をリセットする (room_mutex ロック中に呼ぶ)
+// AI は常に再戦に同意する
+static void reset_rematch_votes(Room* room) {
+    room->player1_rematch_agree = 0;
+    room->player2_rematch_agree =
+        (room->player2_sock == AI_PLAYER_SOCK) ? 1 : 0;
+}
 
-    Room* room = &rooms[room_idx];
+// AI (白番) の思考を要求する (room_mutex ロック中に呼ぶ)
+// 結果は ai_worker.c のワーカーから handle_ai_move で返る
+static void request_ai_move(Room* room) {
+    const GameState* gs = &room->gameState;
+    if (ai_request_move(room->roomId, gs->move_seq, 2, gs->white, gs->black,
+                        gs->hash, room->ai_move_time_ms) == -1) {
+        LOG_ERROR("Error: Failed to request AI move in room %d.", room->roomId);
+    }
+}
 
-    // 1. Check if playing
-    if (room->status != ROOM_PLAYING) {
-        pthread_mutex_unlock(&room->room_mutex);
-        fprintf(stderr, "Error: Room %d is not in playing state (%d).\n",
-                roomId, room->status);
-        Message err_msg;
-        err_msg.type = MSG_INVALID_MOVE_NOTICE;
-        err_msg.data.invalidMoveNotice.roomId = roomId;
-        snprintf(err_msg.data.invalidMoveNotice.message,
-                 sizeof(err_msg.data.invalidMoveNotice.message),
-                 "Game is not currently playing in this room.");
-        sendMessage(client_sock, &err_msg);
+// color の手番を通知する (room_mutex ロック中に呼び、ロックしたまま戻る)
+// 手番が AI なら通知の代わりに思考を要求する
+static void notify_turn_locked(Room* room, int roomId, int color) {
+    int target_sock = (color == 1) ? room->player1_sock : room->player2_sock;
+    if (target_sock == AI_PLAYER_SOCK) {
+        request_ai_move(room);
         return;
     }
+    if (target_sock == -1) {
+        LOG_ERROR(
+            "Error: Could not find socket for next turn player %d in room "
+            "%d.",
+            color, roomId);
+        return;  // 相手がいない？致命的なエラーの可能性
+    }
 
-    // 2. Check if it's sender's turn
-    pthread_mutex_lock(&clients_mutex);
-    int client_idx = find_client_index(client_sock);
-    int playerColor = (client_idx != -1) ? clients[client_idx].playerColor : 0;
-    pthread_mutex_unlock(&clients_mutex);
+    Message turn_notice;
+    turn_notice.type = MSG_YOUR_TURN_NOTICE;
+    turn_notice.data.yourTurnNotice.roomId = roomId;
 
-    if (playerColor == 0 || playerColor != room->gameState.currentTurn) {
-        pthread_mutex_unlock(&room->room_mutex);
-        fprintf(stderr,
-                "Error: Not client sockfd %d's turn in room %d (turn=%d, "
-                "clientColor=%d).\n",
-                client_sock, roomId, room->gameState.currentTurn, playerColor);
-        Message err_msg;
-        err_msg.type = MSG_INVALID_MOVE_NOTICE;
-        err_msg.data.invalidMoveNotice.roomId = roomId;
-        snprintf(err_msg.data.invalidMoveNotice.message,
-                 sizeof(err_msg.data.invalidMoveNotice.message),
-                 "It's not your turn.");
-        sendMessage(client_sock, &err_msg);
-        return;
-    }
+    LOG_DEBUG("Sent YOUR_TURN notice to player %d (sockfd %d) in room %d.",
+              color, target_sock, roomId);
 
-    // 3. Check if move is valid
-    if (!is_valid_move(&room->gameState, playerColor, row, col)) {
-        pthread_mutex_unlock(&room->room_mutex);
-        fprintf(
-            stderr,
-            "Error: Invalid move by client sockfd %d in room %d at (%d, %d).\n",
-            client_sock, roomId, row, col);
-        Message err_msg;
-        err_msg.type = MSG_INVALID_MOVE_NOTICE;
-        err_msg.data.invalidMoveNotice.roomId = roomId;
-        snprintf(err_msg.data.invalidMoveNotice.message,
-                 sizeof(err_msg.data.invalidMoveNotice.message),
-                 "Invalid move at (%d, %d).", row, col);
-        sendMessage(client_sock, &err_msg);
-        return;
-    }
+    // send_to_client は送信キューに積むだけで待たないので、ロックしたまま送る
+    // (途中でアンロックすると、その間に部屋が閉じられ別の対局に使われうる)
+    send_to_client(target_sock, &turn_notice);
+}
 
+// 検証済みの着手を盤面に反映し、通知・終局判定・手番交代まで行う
+// (room_mutex ロック中に呼び、戻る前にアンロックする)
+// 人間の着手 (handle_place_piece_request) と AI の着手 (handle_ai_move)
+// の共通部分
+static void play_move(Room* room, int roomId, int playerColor, int row,
+                      int col) {
     // 4. Update board
     update_board(&room->gameState, playerColor, row, col);
-    printf("Board updated in room %d after move by player %d at (%d,%d).\n",
-           roomId, playerColor, row, col);
+    metrics_add(METRIC_MOVES, 1);
+    LOG_DEBUG("Board updated in room %d after move by player %d at (%d,%d).",
+              roomId, playerColor, row, col);
 
     // 5. Broadcast board update
+    // 差分通知を希望するクライアントには着手位置と裏返った石だけを送る
     Message update_msg;
     update_msg.type = MSG_UPDATE_BOARD_NOTICE;
     update_msg.data.updateBoardNotice.roomId = roomId;
+    update_msg.data.updateBoardNotice.seq = room->gameState.move_seq;
     update_msg.data.updateBoardNotice.playerColor = playerColor;
     update_msg.data.updateBoardNotice.row = row;
     update_msg.data.updateBoardNotice.col = col;
     memcpy(update_msg.data.updateBoardNotice.board, room->gameState.board,
            sizeof(room->gameState.board));
 
+    Message delta_msg;
+    delta_msg.type = MSG_BOARD_DELTA_NOTICE;
+    delta_msg.data.boardDeltaNotice.roomId = roomId;
+    delta_msg.data.boardDeltaNotice.seq = room->gameState.move_seq;
+    delta_msg.data.boardDeltaNotice.playerColor = playerColor;
+    delta_msg.data.boardDeltaNotice.row = row;
+    delta_msg.data.boardDeltaNotice.col = col;
+    delta_msg.data.boardDeltaNotice.flips = room->gameState.last_flips;
+
+    // 送信中もロックを保持する (notify_turn_locked と同じ理由)
     int p1_sock_temp = room->player1_sock;
     int p2_sock_temp = room->player2_sock;
-    pthread_mutex_unlock(&room->room_mutex);  // Unlock before sending
-
-    printf("Broadcasting board update to room %d.\n", roomId);
-    if (p1_sock_temp != -1) sendMessage(p1_sock_temp, &update_msg);
-    if (p2_sock_temp != -1) sendMessage(p2_sock_temp, &update_msg);
-
-    pthread_mutex_lock(&room->room_mutex);  // Re-lock
+    LOG_DEBUG("Broadcasting board update to room %d.", roomId);
+    if (p1_sock_temp != -1) {
+        send_to_client(p1_sock_temp, client_wants_board_delta(p1_sock_temp)
+                                         ? &delta_msg
+                                         : &update_msg);
+    }
+    if (p2_sock_temp != -1) {
+        send_to_client(p2_sock_temp, client_wants_board_delta(p2_sock_temp)
+                                         ? &delta_msg
+                                         : &update_msg);
+    }
 
     // 6. Check game over
     int winner = check_game_over(&room->gameState);
     if (winner != 0) {
         room->status = ROOM_GAMEOVER;
+        game_log_append(room, winner, GAME_LOG_END_NORMAL);
+        metrics_add(METRIC_GAMES_FINISHED, 1);
+        lobby_mark_dirty();
         room->last_action_time = time(NULL);
-        room->player1_rematch_agree = 0;
-        room->player2_rematch_agree = 0;
+        reset_rematch_votes(room);
+        arm_room_timer(room, REMATCH_TIMEOUT_SEC);  // 再戦の受付期限
 
-        printf("Game over in room %d. Winner code: %d\n", roomId, winner);
-
-        Message gameover_msg;
-        gameover_msg.type = MSG_GAME_OVER_NOTICE;
-        gameover_msg.data.gameOverNotice.roomId = roomId;
-        gameover_msg.data.gameOverNotice.winner = winner;
-        if (winner == 1)
-            snprintf(gameover_msg.data.gameOverNotice.message,
-                     sizeof(gameover_msg.data.gameOverNotice.message),
-                     "Game Over! Black wins.");
-        else if (winner == 2)
-            snprintf(gameover_msg.data.gameOverNotice.message,
-                     sizeof(gameover_msg.data.gameOverNotice.message),
-                     "Game Over! White wins.");
-        else
-            snprintf(gameover_msg.data.gameOverNotice.message,
-                     sizeof(gameover_msg.data.gameOverNotice.message),
-                     "Game Over! It's a draw.");
-
-        Message rematch_offer_msg;
-        rematch_offer_msg.type = MSG_REMATCH_OFFER_NOTICE;
-        rematch_offer_msg.data.rematchOfferNotice.roomId = roomId;
+        LOG_INFO("Game over in room %d. Winner code: %d", roomId, winner);
 
         p1_sock_temp = room->player1_sock;
         p2_sock_temp = room->player2_sock;
         pthread_mutex_unlock(&room->room_mutex);  // Unlock before sending
 
-        if (p1_sock_temp != -1) {
-            sendMessage(p1_sock_temp, &gameover_msg);
-            sendMessage(p1_sock_temp, &rematch_offer_msg);
-        }
-        if (p2_sock_temp != -1) {
-            sendMessage(p2_sock_temp, &gameover_msg);
-            sendMessage(p2_sock_temp, &rematch_offer_msg);
-        }
-        printf("Sent game over and rematch offer notices for room %d.\n",
-               roomId);
+        notify_game_over(roomId, winner, "Game Over!", p1_sock_temp,
+                         p2_sock_temp);
         return;  // Game over, exit handler
 
     } else {
@@ -391,8 +439,8 @@ void handle_place_piece_request(int client_sock, const Message* msg) {
 
         // 8. Check if next player must pass
         if (!has_valid_moves(&room->gameState, nextTurnPlayer)) {
-            printf("Player %d has no valid moves in room %d. Passing turn.\n",
-                   nextTurnPlayer, roomId);
+            LOG_INFO("Player %d has no valid moves in room %d. Passing turn.",
+                     nextTurnPlayer, roomId);
 
             // ターンを元のプレイヤー(currentTurnPlayer)に戻す
             // gameState.currentTurn は変更しない（まだ nextTurnPlayer のパス）
@@ -400,124 +448,175 @@ void handle_place_piece_request(int client_sock, const Message* msg) {
             if (!has_valid_moves(&room->gameState, currentTurnPlayer)) {
                 // 両者打てないのでゲーム終了へ
                 // (check_game_overで検知済みのはず)
-                printf(
-                    "Player %d also has no valid moves. Game should end "
-                    "(detected after pass).\n",
-                    currentTurnPlayer);
+                LOG_INFO("Player %d also has no valid moves. Game should end "
+                         "(detected after pass).",
+                         currentTurnPlayer);
                 // このケースは通常、check_game_over で既に検出されているはず
                 // 万が一のためのフォールバックとして再度チェック＆終了処理も可能
-                pthread_mutex_unlock(
-                    &room->room_mutex);  // ★★★ Fallback game over needs unlock
-                                         // before potential send/close_room ★★★
                 winner = check_game_over(&room->gameState);  // 再チェック
                 if (winner != 0) {
-                    // ゲームオーバー処理（6.
-                    // とほぼ同じだが、ロック状態が異なるので注意）
                     room->status = ROOM_GAMEOVER;  // 状態だけ更新
-                                                   // (ロックの外からなので注意)
-                    printf(
+                    lobby_mark_dirty();
+                    LOG_INFO(
                         "Force Game over in room %d after double pass. Winner "
-                        "code: %d\n",
+                        "code: %d",
                         roomId, winner);
                     // 通知などは省略するか、別途実装
                     // close_room(roomId, "Game ended due to double pass."); //
                     // 必要なら
                 } else {
                     // ここに来るのは想定外
-                    fprintf(stderr,
-                            "Error: Double pass detected but check_game_over "
-                            "returned 0.\n");
+                    LOG_ERROR(
+                        "Error: Double pass detected but check_game_over "
+                        "returned 0.");
                 }
+                pthread_mutex_unlock(&room->room_mutex);
                 return;  // ダブルパス or フォールバック終了
 
             } else {
                 // 元のプレイヤー(currentTurnPlayer)にターンが戻る
+                metrics_add(METRIC_PASSES, 1);
                 room->gameState.currentTurn =
                     currentTurnPlayer;  // ターンを正式に戻す
-                printf(
-                    "Returning turn to player %d (sockfd %d) in room %d after "
-                    "opponent pass.\n",
-                    currentTurnPlayer, client_sock, roomId);
-
-                Message turn_notice;
-                turn_notice.type = MSG_YOUR_TURN_NOTICE;
-                turn_notice.data.yourTurnNotice.roomId = roomId;
-
-                pthread_mutex_unlock(
-                    &room->room_mutex);  // Unlock before sending
-                sendMessage(client_sock,
-                            &turn_notice);  // 自分自身(打った人)に通知
-                pthread_mutex_lock(&room->room_mutex);  // Re-lock
+                LOG_INFO(
+                    "Returning turn to player %d in room %d after opponent "
+                    "pass.",
+                    currentTurnPlayer, roomId);
+                notify_turn_locked(room, roomId,
+                                   currentTurnPlayer);  // 打った人に通知
             }
         } else {
             // 9. 通常のターン交代: 次のプレイヤー(nextTurnPlayer)に通知
             room->gameState.currentTurn = nextTurnPlayer;  // ターンを交代
-            int target_sock = -1;
-            if (nextTurnPlayer == 1 && room->player1_sock != -1) {
-                target_sock = room->player1_sock;
-            } else if (nextTurnPlayer == 2 && room->player2_sock != -1) {
-                target_sock = room->player2_sock;
-            }
-
-            if (target_sock != -1) {
-                Message turn_notice;
-                turn_notice.type = MSG_YOUR_TURN_NOTICE;
-                turn_notice.data.yourTurnNotice.roomId = roomId;
-
-                printf(
-                    "Sent YOUR_TURN notice to player %d (sockfd %d) in room "
-                    "%d.\n",
-                    nextTurnPlayer, target_sock, roomId);
-
-                pthread_mutex_unlock(
-                    &room->room_mutex);  // Unlock before sending
-                sendMessage(target_sock, &turn_notice);
-                pthread_mutex_lock(&room->room_mutex);  // Re-lock
-            } else {
-                fprintf(stderr,
-                        "Error: Could not find socket for next turn player %d "
-                        "in room %d.\n",
-                        nextTurnPlayer, roomId);
-                // 相手がいない？致命的なエラーの可能性
-            }
+            notify_turn_locked(room, roomId, nextTurnPlayer);
         }
     }
 
     room->last_action_time = time(NULL);
+    arm_room_timer(room, TURN_TIMEOUT_SEC);  // 次の手番の持ち時間
     pthread_mutex_unlock(&room->room_mutex);  // Function end unlock
 }
 
+
+void handle_place_piece_request(int client_sock, const Message* msg) {
+    int roomId = msg->data.placePieceReq.roomId;
+    uint8_t row = msg->data.placePieceReq.row;
+    uint8_t col = msg->data.placePieceReq.col;
+
+    LOG_DEBUG(
+        "Received PLACE_PIECE request for room %d from client sockfd %d at "
+        "(%d, %d)",
+        roomId, client_sock, row, col);
+
+    // 着手処理は部屋固有のロックのみで行う (rooms_mutex は取らない)
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        LOG_ERROR("Error: Room %d not found for place piece request.", roomId);
+        return;
+    }
+
+    // 1. Check if playing
+    if (room->status != ROOM_PLAYING) {
+        pthread_mutex_unlock(&room->room_mutex);
+        LOG_ERROR("Error: Room %d is not in playing state (%d).", roomId,
+                  room->status);
+        metrics_add(METRIC_INVALID_MOVES, 1);
+        Message err_msg;
+        err_msg.type = MSG_INVALID_MOVE_NOTICE;
+        err_msg.data.invalidMoveNotice.roomId = roomId;
+        snprintf(err_msg.data.invalidMoveNotice.message,
+                 sizeof(err_msg.data.invalidMoveNotice.message),
+                 "Game is not currently playing in this room.");
+        send_to_client(client_sock, &err_msg);
+        return;
+    }
+
+    // 2. Check if it's sender's turn (色はロックなしで参照)
+    int playerColor = get_client_player_color(client_sock);
+
+    if (playerColor == 0 || playerColor != room->gameState.currentTurn) {
+        pthread_mutex_unlock(&room->room_mutex);
+        LOG_ERROR("Error: Not client sockfd %d's turn in room %d (turn=%d, "
+                  "clientColor=%d).",
+                  client_sock, roomId, room->gameState.currentTurn,
+                  playerColor);
+        metrics_add(METRIC_INVALID_MOVES, 1);
+        Message err_msg;
+        err_msg.type = MSG_INVALID_MOVE_NOTICE;
+        err_msg.data.invalidMoveNotice.roomId = roomId;
+        snprintf(err_msg.data.invalidMoveNotice.message,
+                 sizeof(err_msg.data.invalidMoveNotice.message),
+                 "It's not your turn.");
+        send_to_client(client_sock, &err_msg);
+        return;
+    }
+
+    // 3. Check if move is valid
+    if (!is_valid_move(&room->gameState, playerColor, row, col)) {
+        pthread_mutex_unlock(&room->room_mutex);
+        LOG_ERROR(
+            "Error: Invalid move by client sockfd %d in room %d at (%d, %d).",
+            client_sock, roomId, row, col);
+        metrics_add(METRIC_INVALID_MOVES, 1);
+        Message err_msg;
+        err_msg.type = MSG_INVALID_MOVE_NOTICE;
+        err_msg.data.invalidMoveNotice.roomId = roomId;
+        snprintf(err_msg.data.invalidMoveNotice.message,
+                 sizeof(err_msg.data.invalidMoveNotice.message),
+                 "Invalid move at (%d, %d).", row, col);
+        send_to_client(client_sock, &err_msg);
+        return;
+    }
+
+    play_move(room, roomId, playerColor, row, col);
+}
+
+// --- AI の着手 ---
+// ai_worker.c のワーカースレッドから呼ばれる
+// 思考中に局面が変わっていなければ (着手番号が同じなら) 着手する
+void handle_ai_move(int roomId, int move_seq, int square) {
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        return;  // 思考中に閉鎖された
+    }
+    // 思考中に再戦で局面が作り直された場合も、その局面への要求は別に出ている
+    if (room->status != ROOM_PLAYING ||
+        room->player2_sock != AI_PLAYER_SOCK ||
+        room->gameState.currentTurn != 2 ||
+        room->gameState.move_seq != move_seq || square < 0 ||
+        !is_valid_move(&room->gameState, 2, square / BOARD_SIZE,
+                       square % BOARD_SIZE)) {
+        pthread_mutex_unlock(&room->room_mutex);
+        LOG_INFO("Discarding stale AI move for room %d (move %d).", roomId,
+                 move_seq);
+        return;
+    }
+
+    play_move(room, roomId, 2, square / BOARD_SIZE, square % BOARD_SIZE);
+}
+
 void handle_rematch_request(int client_sock, const Message* msg) {
     int roomId = msg->data.rematchReq.roomId;
     int agree =
         msg->data.rematchReq
             .agree;  // 1: Yes, 0: No (protocol.hに合わせる: 1=Yes, 0=No)
 
-    printf(
+    LOG_DEBUG(
         "Received REMATCH request from client sockfd %d for room %d (Agree: "
-        "%d)\n",
+        "%d)",
         client_sock, roomId, agree);
 
-    pthread_mutex_lock(&rooms_mutex);
-    int room_idx = find_room_index(roomId);
-    if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
-        fprintf(stderr, "Error: Room %d not found for rematch request.\n",
-                roomId);
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        LOG_ERROR("Error: Room %d not found for rematch request.", roomId);
         return;
     }
 
-    pthread_mutex_lock(&rooms[room_idx].room_mutex);
-    pthread_mutex_unlock(&rooms_mutex);  // リストロック解除
-
-    Room* room = &rooms[room_idx];
-
     if (room->status != ROOM_GAMEOVER && room->status != ROOM_REMATCHING) {
         pthread_mutex_unlock(&room->room_mutex);
-        fprintf(stderr,
-                "Error: Room %d is not in game over/rematching state for "
-                "rematch (current: %d).\n",
-                roomId, room->status);
+        LOG_ERROR("Error: Room %d is not in game over/rematching state for "
+                  "rematch (current: %d).",
+                  roomId, room->status);
         // エラー通知を送っても良い
         return;
     }
@@ -538,19 +637,20 @@ void handle_rematch_request(int client_sock, const Message* msg) {
     } else {
         // 部屋のプレイヤーではない
         pthread_mutex_unlock(&room->room_mutex);
-        fprintf(stderr, "Error: Client sockfd %d is not a player in room %d.\n",
-                client_sock, roomId);
+        LOG_ERROR("Error: Client sockfd %d is not a player in room %d.",
+                  client_sock, roomId);
         return;
     }
 
     if (player_slot == 0) {  // 既に返答済みだった場合
         pthread_mutex_unlock(&room->room_mutex);
-        printf("Client sockfd %d already responded for rematch in room %d.\n",
-               client_sock, roomId);
+        LOG_INFO("Client sockfd %d already responded for rematch in room %d.",
+                 client_sock, roomId);
         return;
     }
 
     room->status = ROOM_REMATCHING;       // 状態を更新
+    lobby_mark_dirty();
     room->last_action_time = time(NULL);  // タイムアウト用時間更新
 
     // 両者の同意状況を確認
@@ -567,23 +667,25 @@ void handle_rematch_request(int client_sock, const Message* msg) {
 
     if (p1_agree == 2 || p2_agree == 2) {  // どちらかが No (値が2)
         result_msg.data.rematchResultNotice.result = 0;  // Disagreed
-        printf("Rematch disagreed in room %d.\n", roomId);
+        LOG_INFO("Rematch disagreed in room %d.", roomId);
         pthread_mutex_unlock(&room->room_mutex);  // close_room の前にアンロック
 
         // 両者に通知
-        if (p1_sock != -1) sendMessage(p1_sock, &result_msg);
-        if (p2_sock != -1) sendMessage(p2_sock, &result_msg);
+        if (p1_sock != -1) send_to_client(p1_sock, &result_msg);
+        if (p2_sock != -1) send_to_client(p2_sock, &result_msg);
 
         close_room(roomId, "Rematch declined by a player.");  // 部屋を閉じる
 
     } else if (p1_agree == 1 && p2_agree == 1) {         // 両者が Yes (値が1)
         result_msg.data.rematchResultNotice.result = 1;  // Agreed
-        printf("Rematch agreed in room %d. Starting new game.\n", roomId);
+        LOG_INFO("Rematch agreed in room %d. Starting new game.", roomId);
 
         // --- ゲームを再開する処理 ---
         room->status = ROOM_PLAYING;
+        lobby_mark_dirty();
         // ゲーム状態を再初期化
         initialize_game_state(&room->gameState);
+        issue_resume_tokens(room);
         // TODO: 先手後手交代が必要な場合は gameState.currentTurn を設定
         // 例: room->gameState.currentTurn = ( previous_first_player == 1 ) ? 2
         // : 1; 今回は常に黒番から開始とする
@@ -592,10 +694,11 @@ void handle_rematch_request(int client_sock, const Message* msg) {
         room->last_action_time = time(NULL);
         room->player1_rematch_agree = 0;  // リセット
         room->player2_rematch_agree = 0;
+        arm_room_timer(room, TURN_TIMEOUT_SEC);  // 再戦の黒番の持ち時間
 
         // 再戦結果通知を送信
-        if (p1_sock != -1) sendMessage(p1_sock, &result_msg);
-        if (p2_sock != -1) sendMessage(p2_sock, &result_msg);
+        if (p1_sock != -1) send_to_client(p1_sock, &result_msg);
+        if (p2_sock != -1) send_to_client(p2_sock, &result_msg);
 
         // 新しいゲーム開始通知を送信
         Message start_notice;
@@ -606,61 +709,337 @@ void handle_rematch_request(int client_sock, const Message* msg) {
 
         // Player1 (黒と仮定) への通知
         start_notice.data.gameStartNotice.yourColor = 1;
-        if (p1_sock != -1) sendMessage(p1_sock, &start_notice);
+        start_notice.data.gameStartNotice.resumeToken = room->resume_token[0];
+        if (p1_sock != -1) send_to_client(p1_sock, &start_notice);
         // Player2 (白と仮定) への通知
         start_notice.data.gameStartNotice.yourColor = 2;
-        if (p2_sock != -1) sendMessage(p2_sock, &start_notice);
+        start_notice.data.gameStartNotice.resumeToken = room->resume_token[1];
+        if (p2_sock != -1) send_to_client(p2_sock, &start_notice);
 
         // 最初のプレイヤーに手番通知
         Message turn_notice;
         turn_notice.type = MSG_YOUR_TURN_NOTICE;
         turn_notice.data.yourTurnNotice.roomId = roomId;
         if (room->gameState.currentTurn == 1 && p1_sock != -1) {
-            sendMessage(p1_sock, &turn_notice);
+            send_to_client(p1_sock, &turn_notice);
         } else if (room->gameState.currentTurn == 2 && p2_sock != -1) {
-            sendMessage(p2_sock, &turn_notice);
+            send_to_client(p2_sock, &turn_notice);
         }
 
         pthread_mutex_unlock(&room->room_mutex);
 
     } else {
-        // まだ片方しか返答していない -> 何もしない (タイムアウト待ち)
-        printf(
-            "Waiting for opponent's rematch response in room %d (P1:%d, "
-            "P2:%d).\n",
-            roomId, p1_agree, p2_agree);
+        // まだ片方しか返答していない -> 何もしない
+        // (ゲーム終了時に設定した再戦受付のタイマーで期限切れを処理する)
+        LOG_INFO("Waiting for opponent's rematch response in room %d (P1:%d, "
+                 "P2:%d).",
+                 roomId, p1_agree, p2_agree);
         pthread_mutex_unlock(&room->room_mutex);
-        // TODO: タイムアウト処理の実装が必要
-        // (別スレッドで定期的にチェック or イベントドリブン)
     }
 }
 
+// --- 部屋のタイムアウト ---
+// タイマースレッドから呼ばれる。部屋の状態に応じて期限切れを処理する
+// 待機中: 部屋を閉じる / 対戦中: 手番側の時間切れ負け /
+// 再戦受付中: 結果 2 (Timeout) を通知して部屋を閉じる
+void handle_room_timeout(int roomId, unsigned int seq) {
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        return;  // 閉鎖済み
+    }
+    if (!timer_is_current(&room->timer, seq)) {
+        pthread_mutex_unlock(&room->room_mutex);
+        return;  // 満了処理の間に設定し直された
+    }
+
+    int p1_sock = room->player1_sock;
+    int p2_sock = room->player2_sock;
+
+    switch (room->status) {
+        case ROOM_WAITING:
+            pthread_mutex_unlock(&room->room_mutex);
+            LOG_INFO("Room %d timed out while waiting.", roomId);
+            close_room(roomId, "Room timed out while waiting for a game.");
+            break;
+
+        case ROOM_PLAYING: {
+            // 手番のプレイヤーの時間切れ負け
+            int loser = room->gameState.currentTurn;
+            int winner = (loser == 1) ? 2 : 1;
+            room->status = ROOM_GAMEOVER;
+            game_log_append(room, winner, GAME_LOG_END_TIMEOUT);
+            metrics_add(METRIC_GAMES_FINISHED, 1);
+            lobby_mark_dirty();
+            room->last_action_time = time(NULL);
+            reset_rematch_votes(room);
+            arm_room_timer(room, REMATCH_TIMEOUT_SEC);
+            pthread_mutex_unlock(&room->room_mutex);
+
+            LOG_INFO("Player %d ran out of time in room %d. Winner code: %d",
+                     loser, roomId, winner);
+            notify_game_over(roomId, winner, "Time up!", p1_sock, p2_sock);
+            break;
+        }
+
+        case ROOM_GAMEOVER:
+        case ROOM_REMATCHING: {
+            pthread_mutex_unlock(&room->room_mutex);
+            LOG_INFO("Rematch offer timed out in room %d.", roomId);
+
+            Message result_msg;
+            result_msg.type = MSG_REMATCH_RESULT_NOTICE;
+            result_msg.data.rematchResultNotice.roomId = roomId;
+            result_msg.data.rematchResultNotice.result = 2;  // Timeout
+            if (p1_sock != -1) send_to_client(p1_sock, &result_msg);
+            if (p2_sock != -1) send_to_client(p2_sock, &result_msg);
+
+            close_room(roomId, "Rematch timed out.");
+            break;
+        }
+
+        case ROOM_SUSPENDED:
+            pthread_mutex_unlock(&room->room_mutex);
+            LOG_INFO("Players did not return to restored room %d.", roomId);
+            close_room(roomId, "Opponent did not return after server restart.");
+            break;
+
+        default:
+            pthread_mutex_unlock(&room->room_mutex);
+            break;
+    }
+}
+
+// --- 部屋一覧要求 ---
+// 部屋一覧のスナップショットから要求されたページを返す (部屋のロックは不要)
+void handle_list_rooms_request(int client_sock, const Message* msg) {
+    lobby_send_page(client_sock, msg->data.listRoomsReq.page,
+                    msg->data.listRoomsReq.knownVersion);
+}
+
+// --- 盤面同期要求 ---
+// 差分通知の受信設定を更新し、参加中の部屋が指定されていれば全盤面を再送する
+void handle_board_sync_request(int client_sock, const Message* msg) {
+    int roomId = msg->data.boardSyncReq.roomId;
+
+    set_client_board_delta(client_sock, msg->data.boardSyncReq.wantDelta);
+
+    if (roomId == -1) return;  // 設定変更のみ
+    if (roomId != get_client_room_id(client_sock)) {
+        LOG_ERROR(
+            "Error: Board sync for room %d from client sockfd %d which is "
+            "not in that room.",
+            roomId, client_sock);
+        return;
+    }
+
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        return;
+    }
+    if (room->status != ROOM_PLAYING && room->status != ROOM_GAMEOVER &&
+        room->status != ROOM_SUSPENDED) {
+        pthread_mutex_unlock(&room->room_mutex);
+        return;  // 盤面がまだない
+    }
+
+    Message sync_msg;
+    memset(&sync_msg, 0, sizeof(sync_msg));
+    sync_msg.type = MSG_UPDATE_BOARD_NOTICE;
+    sync_msg.data.updateBoardNotice.roomId = roomId;
+    sync_msg.data.updateBoardNotice.seq = room->gameState.move_seq;
+    sync_msg.data.updateBoardNotice.playerColor = 0;  // 再同期
+    memcpy(sync_msg.data.updateBoardNotice.board, room->gameState.board,
+           sizeof(room->gameState.board));
+    pthread_mutex_unlock(&room->room_mutex);
+
+    LOG_DEBUG("Resending board (seq %d) of room %d to client sockfd %d.",
+              sync_msg.data.updateBoardNotice.seq, roomId, client_sock);
+    send_to_client(client_sock, &sync_msg);
+}
+
+// --- 棋譜解析 ---
+// 終局した部屋の棋譜をワーカースレッドに渡し、終盤の手を完全読みで採点する
+void handle_analyze_game_request(int client_sock, const Message* msg) {
+    int roomId = msg->data.analyzeGameReq.roomId;
+    LOG_DEBUG("Received ANALYZE_GAME request for room %d from client sockfd %d",
+              roomId, client_sock);
+
+    Message err_msg;
+    err_msg.type = MSG_ERROR_NOTICE;
+    if (roomId != get_client_room_id(client_sock)) {
+        snprintf(err_msg.data.errorNotice.message,
+                 sizeof(err_msg.data.errorNotice.message),
+                 "You are not in room %d.", roomId);
+        send_to_client(client_sock, &err_msg);
+        return;
+    }
+
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        return;
+    }
+    if (room->status != ROOM_GAMEOVER && room->status != ROOM_REMATCHING) {
+        pthread_mutex_unlock(&room->room_mutex);
+        snprintf(err_msg.data.errorNotice.message,
+                 sizeof(err_msg.data.errorNotice.message),
+                 "Room %d has no finished game to analyze.", roomId);
+        send_to_client(client_sock, &err_msg);
+        return;
+    }
+    // 解析はワーカーを数秒占有するので、1部屋につき同時に1件までにする
+    if (room->analysis_pending) {
+        pthread_mutex_unlock(&room->room_mutex);
+        snprintf(err_msg.data.errorNotice.message,
+                 sizeof(err_msg.data.errorNotice.message),
+                 "Analysis of room %d is already in progress.", roomId);
+        send_to_client(client_sock, &err_msg);
+        return;
+    }
+    int queued = ai_request_analysis(client_sock, roomId,
+                                     room->gameState.move_history,
+                                     room->gameState.move_seq);
+    room->analysis_pending = (queued == 0);
+    pthread_mutex_unlock(&room->room_mutex);
+
+    if (queued < 0) {
+        snprintf(err_msg.data.errorNotice.message,
+                 sizeof(err_msg.data.errorNotice.message),
+                 "Failed to start analysis of room %d.", roomId);
+        send_to_client(client_sock, &err_msg);
+    }
+}
+
+// ai_worker.c のワーカースレッドから呼ばれる
+// 部屋の解析中フラグを下ろし、要求元が解析中に部屋を出ていなければ結果を送る
+void handle_analysis_result(int client_sock, int roomId,
+                            const GameAnalysisEntry* entries, int count) {
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        return;  // 解析中に閉鎖された
+    }
+    room->analysis_pending = 0;
+    int in_room =
+        room->player1_sock == client_sock || room->player2_sock == client_sock;
+    pthread_mutex_unlock(&room->room_mutex);
+    if (!in_room) {
+        LOG_INFO("Discarding analysis of room %d for client sockfd %d.", roomId,
+                 client_sock);
+        return;
+    }
+
+    Message resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.type = MSG_ANALYZE_GAME_RESPONSE;
+    resp.data.analyzeGameResp.roomId = roomId;
+    resp.data.analyzeGameResp.count = (uint8_t)count;
+    memcpy(resp.data.analyzeGameResp.moves, entries,
+           count * sizeof(*entries));
+    send_to_client(client_sock, &resp);
+}
+
+// --- 対局再開 ---
+// 再起動で復元した部屋 (ROOM_SUSPENDED) の空席を、ゲーム開始時に発行した
+// 合言葉で取り戻す。全席がそろったら対局を再開し、手番側に通知する
+void handle_resume_request(int client_sock, const Message* msg) {
+    int roomId = msg->data.resumeReq.roomId;
+    uint64_t token = msg->data.resumeReq.token;
+    LOG_DEBUG("Received RESUME request for room %d from client sockfd %d",
+              roomId, client_sock);
+
+    Message response;
+    memset(&response, 0, sizeof(response));
+    response.type = MSG_RESUME_RESPONSE;
+    response.data.resumeResp.roomId = roomId;
+
+    Room* room = NULL;
+    int color = 0;
+    if (get_client_room_id(client_sock) == -1) {
+        room = acquire_room(roomId);
+    }
+    if (room != NULL && room->status == ROOM_SUSPENDED && token != 0) {
+        if (room->player1_sock == -1 && token == room->resume_token[0]) {
+            color = 1;
+        } else if (room->player2_sock == -1 &&
+                   token == room->resume_token[1]) {
+            color = 2;
+        }
+    }
+    if (color == 0 || set_client_room(client_sock, roomId, color) == -1) {
+        if (room != NULL) {
+            pthread_mutex_unlock(&room->room_mutex);
+        }
+        snprintf(response.data.resumeResp.message,
+                 sizeof(response.data.resumeResp.message),
+                 "No game to resume in room %d.", roomId);
+        send_to_client(client_sock, &response);
+        return;
+    }
+
+    if (color == 1) {
+        room->player1_sock = client_sock;
+    } else {
+        room->player2_sock = client_sock;
+    }
+    int ready = room->player1_sock != -1 && room->player2_sock != -1;
+    if (ready) {
+        room->status = ROOM_PLAYING;
+        room->last_action_time = time(NULL);
+        arm_room_timer(room, TURN_TIMEOUT_SEC);  // 手番側の持ち時間
+    }
+    lobby_mark_dirty();  // 参加人数・状態が変わる
+
+    response.data.resumeResp.success = 1;
+    response.data.resumeResp.yourColor = color;
+    snprintf(response.data.resumeResp.message,
+             sizeof(response.data.resumeResp.message),
+             ready ? "Game resumed." : "Waiting for opponent to return.");
+
+    Message sync_msg;
+    memset(&sync_msg, 0, sizeof(sync_msg));
+    sync_msg.type = MSG_UPDATE_BOARD_NOTICE;
+    sync_msg.data.updateBoardNotice.roomId = roomId;
+    sync_msg.data.updateBoardNotice.seq = room->gameState.move_seq;
+    sync_msg.data.updateBoardNotice.playerColor = 0;  // 再同期
+    memcpy(sync_msg.data.updateBoardNotice.board, room->gameState.board,
+           sizeof(room->gameState.board));
+    int move_seq = room->gameState.move_seq;
+    pthread_mutex_unlock(&room->room_mutex);
+
+    LOG_INFO("Client sockfd %d resumed as player %d in room %d (move %d).",
+             client_sock, color, roomId, move_seq);
+    send_to_client(client_sock, &response);
+    send_to_client(client_sock, &sync_msg);
+    if (!ready) {
+        return;
+    }
+
+    // 盤面を送ってから手番を通知する (その間に進んでいなければ)
+    room = acquire_room(roomId);
+    if (room == NULL) {
+        return;
+    }
+    if (room->status == ROOM_PLAYING && room->gameState.move_seq == move_seq) {
+        notify_turn_locked(room, roomId, room->gameState.currentTurn);
+    }
+    pthread_mutex_unlock(&room->room_mutex);
+}
+
 // --- クライアント切断処理 ---
 void handle_disconnect(int client_sock) {
-    printf("Client sockfd %d disconnected.\n", client_sock);
+    LOG_INFO("Client sockfd %d disconnected.", client_sock);
+    metrics_add(METRIC_DISCONNECTS, 1);
 
     // クライアントがどの部屋にいたか確認
-    pthread_mutex_lock(&clients_mutex);
-    int client_idx = find_client_index(client_sock);
-    int roomId = -1;
-    if (client_idx != -1) {
-        roomId = clients[client_idx].roomId;
-    }
-    pthread_mutex_unlock(&clients_mutex);
+    int roomId = get_client_room_id(client_sock);
 
     // クライアントリストから削除 (ソケットはまだ閉じない)
     remove_client(client_sock);
 
     // もし部屋に参加していたら、部屋の処理を行う
     if (roomId != -1) {
-        pthread_mutex_lock(&rooms_mutex);
-        int room_idx = find_room_index(roomId);
+        Room* room = acquire_room(roomId);
 
-        if (room_idx != -1) {
-            pthread_mutex_lock(&rooms[room_idx].room_mutex);
-            pthread_mutex_unlock(&rooms_mutex);  // リストロック解除
-
-            Room* room = &rooms[room_idx];
+        if (room != NULL) {
             int opponent_sock = -1;
             int disconnected_player_slot = 0;  // 1 or 2
 
@@ -674,8 +1053,14 @@ void handle_disconnect(int client_sock) {
                 disconnected_player_slot = 2;
             }
 
-            printf("Client sockfd %d (Player %d) disconnected from room %d.\n",
-                   client_sock, disconnected_player_slot, roomId);
+            LOG_INFO("Client sockfd %d (Player %d) disconnected from room %d.",
+                     client_sock, disconnected_player_slot, roomId);
+
+            // 対局の途中なら、そこまでの棋譜を勝敗なしで残す
+            if (room->status == ROOM_PLAYING) {
+                game_log_append(room, 0, GAME_LOG_END_DISCONNECT);
+                metrics_add(METRIC_GAMES_FINISHED, 1);
+            }
 
             // 部屋の状態に応じて処理
             if (room->status == ROOM_WAITING || room->status == ROOM_PLAYING ||
@@ -683,10 +1068,9 @@ void handle_disconnect(int client_sock) {
                 room->status == ROOM_REMATCHING) {
                 // 相手がいたら部屋閉鎖通知を送る
                 if (opponent_sock != -1) {
-                    printf(
-                        "Notifying opponent sockfd %d in room %d about "
-                        "disconnect.\n",
-                        opponent_sock, roomId);
+                    LOG_INFO("Notifying opponent sockfd %d in room %d about "
+                             "disconnect.",
+                             opponent_sock, roomId);
                     pthread_mutex_unlock(
                         &room->room_mutex);  // 通知前にアンロック
 
@@ -696,16 +1080,10 @@ void handle_disconnect(int client_sock) {
                     snprintf(close_msg.data.roomClosedNotice.reason,
                              sizeof(close_msg.data.roomClosedNotice.reason),
                              "Opponent disconnected.");
-                    sendMessage(opponent_sock, &close_msg);
+                    send_to_client(opponent_sock, &close_msg);
 
                     // 相手クライアントの roomId もリセット
-                    pthread_mutex_lock(&clients_mutex);
-                    int opp_client_idx = find_client_index(opponent_sock);
-                    if (opp_client_idx != -1) {
-                        clients[opp_client_idx].roomId = -1;
-                        clients[opp_client_idx].playerColor = 0;
-                    }
-                    pthread_mutex_unlock(&clients_mutex);
+                    set_client_room(opponent_sock, -1, 0);
 
                     // 部屋を閉じる
                     close_room(
@@ -715,116 +1093,110 @@ void handle_disconnect(int client_sock) {
                 } else {
                     // 相手がいなかった場合 (WAITING状態だったなど)
                     pthread_mutex_unlock(&room->room_mutex);
-                    printf("Closing empty room %d after player disconnect.\n",
-                           roomId);
+                    LOG_INFO("Closing empty room %d after player disconnect.",
+                             roomId);
                     close_room(roomId,
                                "Player disconnected.");  // 部屋を閉じるだけ
                 }
+            } else if (room->status == ROOM_SUSPENDED) {
+                // 復元した部屋は合言葉で戻れるよう、席を空けたまま残す
+                pthread_mutex_unlock(&room->room_mutex);
+                LOG_INFO("Room %d keeps waiting for players to return.",
+                         roomId);
             } else {
                 // ROOM_EMPTY のはずだが、念のため
                 pthread_mutex_unlock(&room->room_mutex);
-                printf("Room %d status was %d during disconnect handling.\n",
-                       roomId, room->status);
+                LOG_INFO("Room %d status was %d during disconnect handling.",
+                         roomId, room->status);
                 // 必要なら close_room を呼ぶ
             }
 
         } else {
-            pthread_mutex_unlock(&rooms_mutex);  // 部屋が見つからなかった場合
-            fprintf(stderr,
-                    "Warning: Disconnected client sockfd %d was associated "
-                    "with room %d, but room not found in list.\n",
-                    client_sock, roomId);
+            LOG_WARN("Warning: Disconnected client sockfd %d was associated "
+                     "with room %d, but room not found in list.",
+                     client_sock, roomId);
         }
     }
 
     // ソケットを閉じる
     close(client_sock);
-    printf("Socket for client sockfd %d closed.\n", client_sock);
+    LOG_DEBUG("Socket for client sockfd %d closed.", client_sock);
 
-    // スレッド終了
-    // pthread_exit(NULL); // handle_client ループの終了で自動的に終了する
 }
 
-// --- クライアント処理スレッド ---
-void* handle_client(void* arg) {
-    // ClientInfo* client_info = (ClientInfo*)arg; //
-    // add_clientで渡されたポインタ ただし、client_info
-    // は共有メモリclients[]の一部なので、直接使うのは危険 sockfd
-    // を引数として受け取る方が安全
-    int client_sock = *(int*)arg;  // main から sockfd のポインタを受け取る
-    free(arg);                     // main で malloc したメモリを解放
-
-    // スレッドをデタッチする場合（メインスレッドで join しない場合）
-    pthread_detach(pthread_self());
-
-    Message msg;
-    int read_size;
-
-    // 受信ループ
-    while ((read_size = receiveMessage(client_sock, &msg)) > 0) {
-        // 受信成功
-        printf("Received message type %d from client sockfd %d\n", msg.type,
-               client_sock);
-
-        // メッセージタイプに基づいて処理を分岐
-        switch (msg.type) {
-            case MSG_CREATE_ROOM_REQUEST:
-                handle_create_room_request(client_sock, &msg);
-                break;
-            case MSG_JOIN_ROOM_REQUEST:
-                handle_join_room_request(client_sock, &msg);
-                break;
-            case MSG_START_GAME_REQUEST:
-                handle_start_game_request(client_sock, &msg);
-                break;
-            case MSG_PLACE_PIECE_REQUEST:
-                handle_place_piece_request(client_sock, &msg);
-                break;
-            case MSG_REMATCH_REQUEST:
-                handle_rematch_request(client_sock, &msg);
-                break;
-            case MSG_CHAT_MESSAGE_SEND_REQUEST:
-                ChatMessageSendRequestData* req_data =
-                    &msg.data.chatMessageSendReq;
-                // sender_sock
-                // はメッセージを受信したクライアントのソケットディスクリプタ
-                handle_chat_message(client_sock, req_data->roomId,
-                                    req_data->message_text);
-                break;
-            // 他のクライアントからのリクエストタイプもここに追加
-            // case MSG_LIST_ROOMS_REQUEST:
-            //     handle_list_rooms_request(client_sock, &msg); // 要実装
-            //     break;
-            // case MSG_PING:
-            //     handle_ping(client_sock, &msg); // 要実装 (PONGを返す)
-            //     break;
-            default:
-                fprintf(
-                    stderr,
-                    "Unknown message type %d received from client sockfd %d\n",
-                    msg.type, client_sock);
-                // 不明なメッセージに対するエラー応答など (任意)
-                Message err_msg;
-                err_msg.type = MSG_ERROR_NOTICE;
-                snprintf(err_msg.data.errorNotice.message,
-                         sizeof(err_msg.data.errorNotice.message),
-                         "Unknown message type: %d", msg.type);
-                sendMessage(client_sock, &err_msg);
-                break;
+// --- 受信メッセージ処理 ---
+// イベントループが受信バッファから取り出したメッセージを1件ずつ渡す
+void process_client_message(int client_sock, Message* msg) {
+    LOG_DEBUG("Received message type %d from client sockfd %d", msg->type,
+              client_sock);
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    int type = msg->type;  // ハンドラが msg を書き換えても記録には影響しない
+
+    // メッセージタイプに基づいて処理を分岐
+    switch (msg->type) {
+        case MSG_CREATE_ROOM_REQUEST:
+            handle_create_room_request(client_sock, msg);
+            break;
+        case MSG_JOIN_ROOM_REQUEST:
+            handle_join_room_request(client_sock, msg);
+            break;
+        case MSG_START_GAME_REQUEST:
+            handle_start_game_request(client_sock, msg);
+            break;
+        case MSG_PLACE_PIECE_REQUEST:
+            handle_place_piece_request(client_sock, msg);
+            break;
+        case MSG_REMATCH_REQUEST:
+            handle_rematch_request(client_sock, msg);
+            break;
+        case MSG_CHAT_MESSAGE_SEND_REQUEST: {
+            ChatMessageSendRequestData* req_data =
+                &msg->data.chatMessageSendReq;
+            // 受信側で終端を保証してから渡す
+            req_data->message_text[sizeof(req_data->message_text) - 1] = '\0';
+            // sender_sock
+            // はメッセージを受信したクライアントのソケットディスクリプタ
+            handle_chat_message(client_sock, req_data->roomId,
+                                req_data->message_text);
+            break;
+        }
+        // 他のクライアントからのリクエストタイプもここに追加
+        case MSG_BOARD_SYNC_REQUEST:
+            handle_board_sync_request(client_sock, msg);
+            break;
+        case MSG_LIST_ROOMS_REQUEST:
+            handle_list_rooms_request(client_sock, msg);
+            break;
+        case MSG_ADD_AI_REQUEST:
+            handle_add_ai_request(client_sock, msg);
+            break;
+        case MSG_ANALYZE_GAME_REQUEST:
+            handle_analyze_game_request(client_sock, msg);
+            break;
+        case MSG_RESUME_REQUEST:
+            handle_resume_request(client_sock, msg);
+            break;
+        // case MSG_PING:
+        //     handle_ping(client_sock, msg); // 要実装 (PONGを返す)
+        //     break;
+        default: {
+            LOG_ERROR("Unknown message type %d received from client sockfd %d",
+                      msg->type, client_sock);
+            // 不明なメッセージに対するエラー応答など (任意)
+            Message err_msg;
+            err_msg.type = MSG_ERROR_NOTICE;
+            snprintf(err_msg.data.errorNotice.message,
+                     sizeof(err_msg.data.errorNotice.message),
+                     "Unknown message type: %d", msg->type);
+            send_to_client(client_sock, &err_msg);
+            break;
         }
     }
 
-    // receiveMessage が 0 以下を返した場合 (接続断またはエラー)
-    if (read_size == 0) {
-        printf("Client sockfd %d connection closed gracefully.\n", client_sock);
-    } else {  // read_size < 0
-        perror("recv error in handler thread");
-        fprintf(stderr, "Receive error from client sockfd %d.\n", client_sock);
-    }
-
-    // 切断処理
-    handle_disconnect(client_sock);
-
-    printf("Client handler thread for sockfd %d exiting.\n", client_sock);
-    return NULL;  // スレッド終了
-}
\ No newline at end of file
+    struct timespec finished;
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    metrics_record_handler(
+        type, (uint64_t)(finished.tv_sec - started.tv_sec) * 1000000000ULL +
+                  (finished.tv_nsec - started.tv_nsec));
+}
@@ -5,8 +5,8 @@
 
 // --- 関数プロトタイプ ---
 
-// クライアント処理スレッド関数
-void* handle_client(void* arg);
+// 受信したメッセージをタイプごとのハンドラに振り分ける (イベントループから呼ぶ)
+void process_client_message(int client_sock, Message* msg);
 
 // メッセージハンドラ関数
 void handle_create_room_request(int client_sock, const Message* msg);
@@ -15,7 +15,19 @@ void handle_join_room_request(int client_sock,
 void handle_start_game_request(int client_sock, const Message* msg);
 void handle_place_piece_request(int client_sock, const Message* msg);
 void handle_rematch_request(int client_sock, const Message* msg);
+void handle_board_sync_request(int client_sock, const Message* msg);
+void handle_list_rooms_request(int client_sock, const Message* msg);
+void handle_add_ai_request(int client_sock, const Message* msg);
+void handle_analyze_game_request(int client_sock, const Message* msg);
+void handle_resume_request(int client_sock, const Message* msg);
 void handle_disconnect(int client_sock);
+// 部屋のタイマーが満了したときに呼ばれる (timer_wheel.c のスレッドから)
+void handle_room_timeout(int roomId, unsigned int seq);
+// AI の探索結果を受け取り、着手する (ai_worker.c のスレッドから)
+void handle_ai_move(int roomId, int move_seq, int square);
+// 棋譜解析の結果を要求元に送る (ai_worker.c のスレッドから)
+void handle_analysis_result(int client_sock, int roomId,
+                            const GameAnalysisEntry* entries, int count);
 // 他に必要なメッセージハンドラがあれば追加
 
 #endif  // CLIENT_HANDLER_H
\ No newline at end of file
@@ -1,101 +1,170 @@
 #include "client_management.h"
 
+#include "logger.h"
+#include "metrics.h"  // ロックの待ち時間
+#include "slab_pool.h"
+
 // --- グローバル変数定義 ---
-ClientInfo clients[MAX_CLIENTS];
 pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// クライアント情報の置き場 (添字は接続中は変わらない)
+static SlabPool client_pool;
+static int free_client_head = -1;  // 空きリストの先頭 (clients_mutex で保護)
+
+// 添字 index のクライアント情報を返す (ロック不要)
+static inline ClientInfo* client_at(int index) {
+    return (ClientInfo*)slab_pool_at(&client_pool, index);
+}
+
+// プール伸長時に新しい要素を空きスロットとして初期化する
+static void init_client_slot(void* elem, int index) {
+    ClientInfo* client = elem;
+    client->sockfd = -1;  // -1は空きスロットを示す
+    client->roomId = -1;
+    client->playerColor = 0;
+    client->wants_board_delta = 0;
+    client->conn = NULL;
+    client->next_free = free_client_head;
+    free_client_head = index;
+}
+
 // --- クライアントリスト初期化 ---
-void initialize_clients() {
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        clients[i].sockfd = -1;  // -1は空きスロットを示す
-        clients[i].roomId = -1;
-        clients[i].playerColor = 0;
+int initialize_clients(int max_clients) {
+    if (max_clients > CLIENT_FD_TABLE_SIZE) {
+        max_clients = CLIENT_FD_TABLE_SIZE;  // fd 表より多くは登録できない
     }
+    metrics_lock(&clients_mutex, METRIC_LOCK_CLIENTS);
+    int result = slab_pool_init(&client_pool, sizeof(ClientInfo),
+                                CLIENT_POOL_CHUNK, max_clients);
+    free_client_head = -1;
     pthread_mutex_unlock(&clients_mutex);
-    printf("Client list initialized.\n");
+    if (result == 0) {
+        LOG_INFO("Client list initialized (max %d clients).", max_clients);
+    }
+    return result;
 }
 
 // --- クライアント管理 ---
+// sockfd からクライアント情報の添字を直接引く (表の値は 添字+1、0 なら未登録)
+// 書き込みは clients_mutex 下で行い、読み出しはロックなしで行う
+static int client_index_by_fd[CLIENT_FD_TABLE_SIZE];
+
 int find_client_index(int sockfd) {
-    // clients_mutex は呼び出し元でロック/アンロックされる想定が多いが、
-    // この関数単体で使われる可能性も考慮し、ここではロックしない。
-    // 必要なら呼び出し側でロックする。
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (clients[i].sockfd == sockfd) {
-            return i;
-        }
+    // O(1) の表引きなので、clients_mutex の有無に関係なく呼べる
+    if (sockfd < 0 || sockfd >= CLIENT_FD_TABLE_SIZE) {
+        return -1;
     }
-    return -1;  // 見つからない
+    return __atomic_load_n(&client_index_by_fd[sockfd], __ATOMIC_ACQUIRE) - 1;
 }
 
-// sockfdからClientInfoポインタを取得 (clients_mutexで保護)
+// sockfdからClientInfoポインタを取得 (ロックは取らない)
+// 注意: ポインタ経由の書き込みは clients_mutex を取ってから行うこと
 ClientInfo* get_client_info(int sockfd) {
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (clients[i].sockfd == sockfd) {
-            // 見つかった場合、mutexをアンロックせずにポインタを返す
-            // 呼び出し元が使い終わったらアンロックする必要があるか、
-            // またはコピーを返すか、設計による。
-            // ここでは単純化のため、ロックしたままポインタを返す。
-            // ただし、デッドロックのリスクがあるので注意。
-            // より安全なのはインデックスを返し、呼び出し元で再度ロックしてアクセス。
-            // もしくは、必要な情報をコピーして返す。
-            // ここではインデックスを返す find_client_index を使うことを推奨。
-            // この関数は例として残すが、利用は慎重に。
-            //
-            // find_client_index を使う実装に変更:
-            int index = find_client_index(sockfd);
-            if (index != -1) {
-                pthread_mutex_unlock(&clients_mutex);  // アンロックしてから返す
-                return &clients[index];  // ポインタを返す場合は注意が必要
-            } else {
-                pthread_mutex_unlock(&clients_mutex);
-                return NULL;
-            }
-            // 元の実装（ロックしたまま返すのは危険）
-            // pthread_mutex_unlock(&clients_mutex); // これは間違い
-            // return &clients[i];
-        }
-    }
-    pthread_mutex_unlock(&clients_mutex);
-    return NULL;  // 見つからない
+    int index = find_client_index(sockfd);
+    return (index != -1) ? client_at(index) : NULL;
 }
 
-int add_client(int sockfd, struct sockaddr_in addr) {
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (clients[i].sockfd == -1) {
-            clients[i].sockfd = sockfd;
-            clients[i].addr = addr;
-            clients[i].roomId = -1;  // 初期状態はロビー
-            clients[i].playerColor = 0;
-            clients[i].thread_id =
-                pthread_self();  // スレッドIDを記録（オプション）
-            pthread_mutex_unlock(&clients_mutex);
-            printf("Client %d added (sockfd: %d).\n", i, sockfd);
-            return i;  // 追加したインデックスを返す
-        }
+int add_client(int sockfd, struct sockaddr_in addr,
+               struct Connection* conn) {
+    if (sockfd < 0 || sockfd >= CLIENT_FD_TABLE_SIZE) {
+        LOG_ERROR("Failed to add client: sockfd %d out of range.", sockfd);
+        return -1;
     }
+    metrics_lock(&clients_mutex, METRIC_LOCK_CLIENTS);
+    // 空きスロットがなければプールを伸ばす (上限に達していれば満員)
+    if (free_client_head == -1 &&
+        slab_pool_grow(&client_pool, init_client_slot) == -1) {
+        pthread_mutex_unlock(&clients_mutex);
+        LOG_ERROR("Failed to add client: server full.");
+        return -1;  // 満員
+    }
+    int i = free_client_head;
+    ClientInfo* client = client_at(i);
+    free_client_head = client->next_free;
+
+    client->sockfd = sockfd;
+    client->addr = addr;
+    client->roomId = -1;  // 初期状態はロビー
+    client->playerColor = 0;
+    client->wants_board_delta = 0;  // 既定は全盤面で通知
+    client->conn = conn;  // 送信時に使う入出力コンテキスト
+    client->next_free = -1;
+    // 情報を書き終えてから fd 表に公開する
+    __atomic_store_n(&client_index_by_fd[sockfd], i + 1, __ATOMIC_RELEASE);
     pthread_mutex_unlock(&clients_mutex);
-    fprintf(stderr, "Failed to add client: server full.\n");
-    return -1;  // 満員
+    LOG_DEBUG("Client %d added (sockfd: %d).", i, sockfd);
+    return i;  // 追加したインデックスを返す
 }
 
 void remove_client(int sockfd) {
-    pthread_mutex_lock(&clients_mutex);
+    metrics_lock(&clients_mutex, METRIC_LOCK_CLIENTS);
     int index = find_client_index(sockfd);  // mutex内で呼ぶ
     if (index != -1) {
-        printf("Removing client %d (sockfd: %d).\n", index,
-               clients[index].sockfd);
-        clients[index].sockfd = -1;  // スロットを空ける
-        clients[index].roomId = -1;
-        clients[index].playerColor = 0;
+        ClientInfo* client = client_at(index);
+        LOG_DEBUG("Removing client %d (sockfd: %d).", index, client->sockfd);
+        __atomic_store_n(&client_index_by_fd[sockfd], 0, __ATOMIC_RELEASE);
+        client->sockfd = -1;  // スロットを空ける
+        client->roomId = -1;
+        client->playerColor = 0;
+        client->wants_board_delta = 0;
+        client->conn = NULL;
         // 必要なら他の情報もクリア
+        client->next_free = free_client_head;
+        free_client_head = index;
     } else {
-        fprintf(stderr,
-                "Attempted to remove non-existent client (sockfd: %d).\n",
-                sockfd);
+        LOG_ERROR("Attempted to remove non-existent client (sockfd: %d).",
+                  sockfd);
     }
     pthread_mutex_unlock(&clients_mutex);
-}
\ No newline at end of file
+}
+
+// --- ロックなしの参照 ---
+// 各フィールドは clients_mutex 下でアトミックに書き換えられるため、
+// 読み出し側はロックを取らずに最新の値を得られる
+
+int get_client_room_id(int sockfd) {
+    int index = find_client_index(sockfd);
+    return (index != -1) ? __atomic_load_n(&client_at(index)->roomId,
+                                           __ATOMIC_ACQUIRE)
+                         : -1;
+}
+
+int get_client_player_color(int sockfd) {
+    int index = find_client_index(sockfd);
+    return (index != -1) ? __atomic_load_n(&client_at(index)->playerColor,
+                                           __ATOMIC_ACQUIRE)
+                         : 0;
+}
+
+// 着手を差分通知 (MSG_BOARD_DELTA_NOTICE) で受け取るか
+int client_wants_board_delta(int sockfd) {
+    int index = find_client_index(sockfd);
+    return (index != -1) ? __atomic_load_n(&client_at(index)->wants_board_delta,
+                                           __ATOMIC_ACQUIRE)
+                         : 0;
+}
+
+// --- 更新 (clients_mutexで保護) ---
+
+// 参加中の部屋と色を設定する。戻り値: クライアントの添字、見つからなければ -1
+int set_client_room(int sockfd, int roomId, int playerColor) {
+    metrics_lock(&clients_mutex, METRIC_LOCK_CLIENTS);
+    int index = find_client_index(sockfd);
+    if (index != -1) {
+        __atomic_store_n(&client_at(index)->roomId, roomId, __ATOMIC_RELEASE);
+        __atomic_store_n(&client_at(index)->playerColor, playerColor,
+                         __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&clients_mutex);
+    return index;
+}
+
+void set_client_board_delta(int sockfd, int wantDelta) {
+    metrics_lock(&clients_mutex, METRIC_LOCK_CLIENTS);
+    int index = find_client_index(sockfd);
+    if (index != -1) {
+        __atomic_store_n(&client_at(index)->wants_board_delta,
+                         wantDelta ? 1 : 0, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&clients_mutex);
+}
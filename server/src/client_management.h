@@ -4,15 +4,29 @@
 #include "server_common.h"  // 共通定義をインクルード
 
 // --- グローバル変数 (extern宣言) ---
-extern ClientInfo clients[MAX_CLIENTS];
 extern pthread_mutex_t clients_mutex;
 
+// --- 定数定義 ---
+#define CLIENT_FD_TABLE_SIZE 65536  // fd -> clients[] 添字の表の大きさ
+
 // --- 関数プロトタイプ ---
-void initialize_clients();  // クライアントリスト初期化関数名を変更
-int find_client_index(int sockfd);
-int add_client(int sockfd, struct sockaddr_in addr);
+// クライアントリストを初期化する (max_clients: 同時接続数の上限)
+// クライアント情報は接続が増えるたびに CLIENT_POOL_CHUNK 単位で確保する
+// 戻り値: 失敗時 -1
+int initialize_clients(int max_clients);
+int find_client_index(int sockfd);  // fd 表による O(1) 参照 (ロック不要)
+int add_client(int sockfd, struct sockaddr_in addr, struct Connection* conn);
 void remove_client(int sockfd);
 ClientInfo* get_client_info(
     int sockfd);  // sockfdからClientInfoポインタを取得するヘルパー関数 (追加)
 
+// ロックなしの参照 (見つからなければ roomId は -1、色・差分希望は 0)
+int get_client_room_id(int sockfd);
+int get_client_player_color(int sockfd);
+int client_wants_board_delta(int sockfd);  // 差分通知を希望しているか
+
+// clients_mutex を取って更新する
+int set_client_room(int sockfd, int roomId, int playerColor);
+void set_client_board_delta(int sockfd, int wantDelta);
+
 #endif  // CLIENT_MANAGEMENT_H
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "endgame.h"
+
+#include "ai_search.h"
+
+#define ENDGAME_INFINITY 65  // どの石差よりも大きい値
+#define ENDGAME_TIME_CHECK_INTERVAL 4096  // 時間切れを確認する局面数の間隔
+#define ENDGAME_PARITY_EMPTIES 6  // 空きがこれ以下ならパリティ順で並べる
+
+int endgame_empties = DEFAULT_ENDGAME_EMPTIES;
+
+// 盤の4分の1ずつの区画 (左上・右上・左下・右下)
+static const Bitboard kQuadrants[4] = {
+    0x000000000F0F0F0FULL,
+    0x00000000F0F0F0F0ULL,
+    0x0F0F0F0F00000000ULL,
+    0xF0F0F0F000000000ULL,
+};
+
+// 1回の完全読みの作業領域
+typedef struct {
+    uint64_t deadline_ms;  // これを過ぎたら探索を打ち切る
+    uint64_t nodes;
+    int aborted;  // 1 なら時間切れ (以降の値は使わない)
+} EndgameContext;
+
+// 手番側から見た石差
+static inline int disc_diff(Bitboard player, Bitboard opponent) {
+    return __builtin_popcountll(player) - __builtin_popcountll(opponent);
+}
+
+// 空きマスが奇数個の区画をまとめたマスク
+// 奇数区画に先に打つと、その区画の最後の1マスを自分が埋めやすい
+static Bitboard odd_regions(Bitboard empty) {
+    Bitboard odd = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (__builtin_popcountll(empty & kQuadrants[i]) & 1) {
+            odd |= kQuadrants[i];
+        }
+    }
+    return odd;
+}
+
+// moves を試す順に out に並べる。戻り値: 手の数
+static int order_moves(Bitboard player, Bitboard opponent, Bitboard moves,
+                       Bitboard empty, int* out) {
+    Bitboard odd = odd_regions(empty);
+    int n = 0;
+    if (__builtin_popcountll(empty) <= ENDGAME_PARITY_EMPTIES) {
+        // 空きが少なければ並べ替えの手間の方が高くつくので、パリティ順のみ
+        for (Bitboard b = moves & odd; b; b &= b - 1) {
+            out[n++] = __builtin_ctzll(b);
+        }
+        for (Bitboard b = moves & ~odd; b; b &= b - 1) {
+            out[n++] = __builtin_ctzll(b);
+        }
+        return n;
+    }
+
+    // fastest-first: 相手の合法手が少なくなる手ほど先に試す (同数なら奇数区画)
+    int keys[64];
+    for (Bitboard b = moves; b; b &= b - 1) {
+        int sq = __builtin_ctzll(b);
+        Bitboard flips = bitboard_flips(player, opponent, sq);
+        Bitboard next_player = player | flips | ((Bitboard)1 << sq);
+        Bitboard next_opponent = opponent & ~flips;
+        int key = 2 * __builtin_popcountll(
+                          bitboard_legal_moves(next_opponent, next_player)) +
+                  ((odd >> sq) & 1 ? 0 : 1);
+        // 挿入ソート (昇順)
+        int i = n++;
+        while (i > 0 && keys[i - 1] > key) {
+            keys[i] = keys[i - 1];
+            out[i] = out[i - 1];
+            --i;
+        }
+        keys[i] = key;
+        out[i] = sq;
+    }
+    return n;
+}
+
+// 空きが square の1マスだけの局面の最終石差 (合法手の生成を省く)
+static int solve_last(Bitboard player, Bitboard opponent, int square) {
+    int diff = disc_diff(player, opponent);
+    Bitboard flips = bitboard_flips(player, opponent, square);
+    if (flips) {
+        return diff + 2 * __builtin_popcountll(flips) + 1;
+    }
+    flips = bitboard_flips(opponent, player, square);  // 手番側はパス
+    if (flips) {
+        return diff - 2 * __builtin_popcountll(flips) - 1;
+    }
+    return diff;  // どちらも打てずに終局
+}
+
+// player の手番の局面の最終石差を返す (alpha-beta)
+// passed: 直前の手がパスだったか (連続パスなら終局)
+static int solve(EndgameContext* ctx, Bitboard player, Bitboard opponent,
+                 int alpha, int beta, int passed) {
+    if ((++ctx->nodes & (ENDGAME_TIME_CHECK_INTERVAL - 1)) == 0 &&
+        ai_now_ms() >= ctx->deadline_ms) {
+        ctx->aborted = 1;
+    }
+    if (ctx->aborted) {
+        return 0;
+    }
+
+    Bitboard empty = ~(player | opponent);
+    if (empty == 0) {
+        return disc_diff(player, opponent);
+    }
+    if ((empty & (empty - 1)) == 0) {
+        return solve_last(player, opponent, __builtin_ctzll(empty));
+    }
+
+    Bitboard moves = bitboard_legal_moves(player, opponent);
+    if (moves == 0) {
+        if (passed) {
+            return disc_diff(player, opponent);
+        }
+        return -solve(ctx, opponent, player, -beta, -alpha, 1);
+    }
+
+    int order[64];
+    int n = order_moves(player, opponent, moves, empty, order);
+    int best = -ENDGAME_INFINITY;
+    for (int i = 0; i < n; ++i) {
+        int sq = order[i];
+        Bitboard flips = bitboard_flips(player, opponent, sq);
+        int score = -solve(ctx, opponent & ~flips,
+                           player | flips | ((Bitboard)1 << sq), -beta,
+                           -alpha, 0);
+        if (ctx->aborted) {
+            return 0;
+        }
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) break;  // βカット
+            }
+        }
+    }
+    return best;
+}
+
+int endgame_solve(Bitboard player, Bitboard opponent, uint64_t deadline_ms,
+                  EndgameResult* result) {
+    EndgameContext ctx = {deadline_ms, 0, 0};
+    Bitboard moves = bitboard_legal_moves(player, opponent);
+    result->move = -1;
+    if (moves == 0) {
+        result->score = solve(&ctx, player, opponent, -ENDGAME_INFINITY,
+                              ENDGAME_INFINITY, 0);
+    } else {
+        int order[64];
+        int n = order_moves(player, opponent, moves, ~(player | opponent),
+                            order);
+        int alpha = -ENDGAME_INFINITY;
+        for (int i = 0; i < n; ++i) {
+            int sq = order[i];
+            Bitboard flips = bitboard_flips(player, opponent, sq);
+            int score = -solve(&ctx, opponent & ~flips,
+                               player | flips | ((Bitboard)1 << sq),
+                               -ENDGAME_INFINITY, -alpha, 0);
+            if (ctx.aborted) {
+                break;
+            }
+            if (score > alpha) {
+                alpha = score;
+                result->move = sq;
+            }
+        }
+        result->score = alpha;
+    }
+    result->nodes = ctx.nodes;
+    return !ctx.aborted;
+}
+
+// --- 棋譜解析 ---
+
+// 解析対象の局面 (着手の直前)
+typedef struct {
+    Bitboard player;  // 着手した側の石
+    Bitboard opponent;
+    uint8_t seq;
+    uint8_t color;
+    uint8_t played;
+} AnalysisPosition;
+
+int endgame_analyze_game(const uint8_t* moves, int count, uint64_t deadline_ms,
+                         GameAnalysisEntry* out, int max_entries) {
+    // 着手列を再生し、終盤の局面を集める (打てない側はパスしたとみなす)
+    AnalysisPosition positions[BOARD_SIZE * BOARD_SIZE];
+    int n = 0;
+    GameState gs;
+    initialize_game_state(&gs);
+    int color = 1;
+    for (int i = 0; i < count; ++i) {
+        int r = moves[i] / BOARD_SIZE;
+        int c = moves[i] % BOARD_SIZE;
+        if (!is_valid_move(&gs, color, r, c)) {
+            color = 3 - color;
+            if (!is_valid_move(&gs, color, r, c)) {
+                break;  // 棋譜が壊れている
+            }
+        }
+        Bitboard player = (color == 1) ? gs.black : gs.white;
+        Bitboard opponent = (color == 1) ? gs.white : gs.black;
+        if (64 - __builtin_popcountll(player | opponent) <= endgame_empties) {
+            positions[n++] = (AnalysisPosition){player, opponent, i + 1,
+                                                color, moves[i]};
+        }
+        update_board(&gs, color, r, c);
+        color = 3 - color;
+    }
+
+    // 終局に近い (読みの軽い) 局面から読み、時間切れになったらそこまで
+    int first = n > max_entries ? n - max_entries : 0;
+    int solved_from = n;
+    for (int i = n - 1; i >= first; --i) {
+        const AnalysisPosition* pos = &positions[i];
+        GameAnalysisEntry* e = &out[i - first];
+        EndgameResult best;
+        if (!endgame_solve(pos->player, pos->opponent, deadline_ms, &best)) {
+            break;
+        }
+        e->seq = pos->seq;
+        e->color = pos->color;
+        e->played = pos->played;
+        e->best = (uint8_t)best.move;
+        e->bestDiff = (int8_t)best.score;
+        if (best.move == pos->played) {
+            e->playedDiff = e->bestDiff;
+        } else {
+            EndgameContext ctx = {deadline_ms, 0, 0};
+            Bitboard flips =
+                bitboard_flips(pos->player, pos->opponent, pos->played);
+            Bitboard next_player =
+                pos->player | flips | ((Bitboard)1 << pos->played);
+            int score = -solve(&ctx, pos->opponent & ~flips, next_player,
+                               -ENDGAME_INFINITY, ENDGAME_INFINITY, 0);
+            if (ctx.aborted) {
+                break;
+            }
+            e->playedDiff = (int8_t)score;
+        }
+        solved_from = i;
+    }
+
+    int solved = n - solved_from;
+    if (solved > 0 && solved_from != first) {
+        memmove(out, &out[solved_from - first], solved * sizeof(*out));
+    }
+    return solved;
+}
@@ -0,0 +1,38 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "game_logic.h"
+
+// --- 終盤の完全読み ---
+// 空きマスが endgame_empties 以下になったら、評価関数を使わずに終局まで
+// 読み切って正確な最終石差を求める。手の並べ替えは、空きが多いうちは
+// 相手の合法手が最も少なくなる手から (fastest-first)、少なくなったら
+// 空きが奇数個の区画 (盤の4分の1) の手から (パリティ) 試す。
+
+#define DEFAULT_ENDGAME_EMPTIES 14  // 完全読みを始める空きマス数 (既定値)
+#define ENDGAME_MAX_EMPTIES 24      // 設定できる上限
+
+// 完全読みを始める空きマス数 (起動時に --endgame-empties で設定)
+extern int endgame_empties;
+
+// 完全読みの結果
+typedef struct {
+    int move;        // 最善手 (0-63)、合法手がなければ -1
+    int score;       // 最善を尽くしたときの最終石差 (手番側から見た値)
+    uint64_t nodes;  // 探索した局面数
+} EndgameResult;
+
+// player の手番の局面を終局まで読み切る
+// deadline_ms (CLOCK_MONOTONIC のミリ秒) を過ぎたら打ち切る
+// 戻り値: 読み切れれば 1、時間切れなら 0
+int endgame_solve(Bitboard player, Bitboard opponent, uint64_t deadline_ms,
+                  EndgameResult* result);
+
+// 終局した対局の着手列 moves (マスの番号、パスは含まない) を再生し、
+// 空きマスが endgame_empties 以下の局面について、打った手と最善手の
+// 最終石差を out に着手順に書く (終局に近い局面から読み、時間切れで打ち切る)
+// 戻り値: 書いた件数
+int endgame_analyze_game(const uint8_t* moves, int count, uint64_t deadline_ms,
+                         GameAnalysisEntry* out, int max_entries);
+
+#endif  // ENDGAME_H
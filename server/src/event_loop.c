@@ -0,0 +1,477 @@
+#define _GNU_SOURCE  // accept4
+#include "event_loop.h"
+
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+
+#include "client_handler.h"
+#include "client_management.h"
+#include "logger.h"
+#include "metrics.h"
+
+// --- データ構造定義 ---
+
+// 接続ごとの入出力コンテキスト
+// リアクタが1つ参照を保持し、send_to_client が一時的に参照を借りる。
+// 参照が0になった時点で解放する。
+struct Connection {
+    int fd;          // ソケットディスクリプタ (切断後は -1)
+    int refcount;    // 参照カウント (__atomic で操作)
+    uint8_t rbuf[CONN_READ_BUF_SIZE];  // 受信途中のバイト列
+    size_t rlen;
+    uint8_t* wbuf;  // 未送信のバイト列 (送信キュー)
+    size_t wlen;
+    size_t wcap;
+    int overflowed;               // 送信キューがあふれ、切断待ち
+    unsigned long dropped;        // 破棄したメッセージ数
+    pthread_mutex_t write_mutex;  // wbuf と fd の書き込み側を保護
+};
+
+// リアクタ (epoll インスタンス1つにつき1スレッド)
+typedef struct {
+    int id;
+    int epfd;
+    int listen_fd;  // このリアクタが待ち受けるソケット (-1なら無し)
+    pthread_t thread_id;
+} Reactor;
+
+static Reactor* reactors = NULL;
+static int reactor_count = 0;
+static unsigned int next_reactor = 0;  // 共有リスナ使用時の振り分け用
+
+// --- 接続オブジェクト管理 ---
+
+static Connection* connection_new(int fd) {
+    Connection* conn = calloc(1, sizeof(Connection));
+    if (conn == NULL) {
+        return NULL;
+    }
+    conn->fd = fd;
+    conn->refcount = 1;  // リアクタの参照
+    if (pthread_mutex_init(&conn->write_mutex, NULL) != 0) {
+        free(conn);
+        return NULL;
+    }
+    return conn;
+}
+
+static void connection_release(Connection* conn) {
+    if (__atomic_sub_fetch(&conn->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_destroy(&conn->write_mutex);
+        free(conn->wbuf);
+        free(conn);
+    }
+}
+
+// wbuf の内容を送れるだけ送る (write_mutex ロック中に呼ぶ)
+// 戻り値: 0 成功 (送り切れなかった分は EPOLLOUT で再送), -1 致命的エラー
+static int flush_write_buffer_locked(Connection* conn) {
+    size_t sent_total = 0;
+    while (sent_total < conn->wlen && conn->fd != -1) {
+        ssize_t n = send(conn->fd, conn->wbuf + sent_total,
+                         conn->wlen - sent_total, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            sent_total += n;
+            metrics_add(METRIC_BYTES_OUT, n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;  // カーネルバッファが満杯。残りは EPOLLOUT 時に送る
+        } else {
+            LOG_ERROR("send failed: %m");
+            conn->wlen = 0;  // 送信不能。切断はリアクタ側で検知する
+            return -1;
+        }
+    }
+    if (sent_total > 0) {
+        memmove(conn->wbuf, conn->wbuf + sent_total, conn->wlen - sent_total);
+        conn->wlen -= sent_total;
+    }
+    return 0;
+}
+
+// wbuf にバイト列を追加する (write_mutex ロック中に呼ぶ)
+static int append_write_buffer_locked(Connection* conn, const void* data,
+                                      size_t len) {
+    if (conn->wlen + len > conn->wcap) {
+        size_t new_cap = conn->wcap ? conn->wcap : CONN_WRITE_BUF_INITIAL;
+        while (new_cap < conn->wlen + len) {
+            new_cap *= 2;
+        }
+        uint8_t* new_buf = realloc(conn->wbuf, new_cap);
+        if (new_buf == NULL) {
+            LOG_ERROR("Failed to grow write buffer: %m");
+            return -1;
+        }
+        conn->wbuf = new_buf;
+        conn->wcap = new_cap;
+    }
+    memcpy(conn->wbuf + conn->wlen, data, len);
+    conn->wlen += len;
+    return 0;
+}
+
+// キューが混んでいるときに破棄してよいメッセージか
+// (ゲーム進行に必要な通知は破棄せず、あふれたら切断する)
+static int is_droppable_message(MessageType type) {
+    return type == MSG_CHAT_MESSAGE_BROADCAST_NOTICE;
+}
+
+// エンコード済みフレーム列を sockfd の送信キューに積み、送れる分だけ送る
+// droppable: キューが SOFT_LIMIT を超えていれば破棄してよいか
+static int enqueue_frames(int sockfd, const uint8_t* frames, size_t len,
+                          int droppable) {
+    if (sockfd == AI_PLAYER_SOCK) {
+        return 0;  // AI の席には送信先がない (手番は ai_worker.c へ渡す)
+    }
+    // sockfd から接続を引き、参照を借りる
+    metrics_lock(&clients_mutex, METRIC_LOCK_CLIENTS);
+    ClientInfo* client = get_client_info(sockfd);
+    Connection* conn = (client != NULL) ? client->conn : NULL;
+    if (conn != NULL) {
+        __atomic_add_fetch(&conn->refcount, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&clients_mutex);
+
+    if (conn == NULL) {
+        LOG_ERROR("send_to_client: client sockfd %d not found.", sockfd);
+        return -1;
+    }
+
+    int result = -1;
+    pthread_mutex_lock(&conn->write_mutex);
+    size_t queued = conn->wlen + len;
+    if (conn->fd == -1 || conn->overflowed) {
+        result = -1;  // 切断済み・切断待ち
+    } else if (queued > CONN_WRITE_BUF_HARD_LIMIT) {
+        // 受信が追いつかないクライアントは切断する。close はリアクタに任せ、
+        // ここでは shutdown で EPOLLRDHUP を起こすだけにする
+        LOG_ERROR("send_to_client: send queue overflow for client sockfd %d "
+                  "(%zu bytes). Disconnecting.",
+                  sockfd, queued);
+        conn->overflowed = 1;
+        conn->wlen = 0;
+        shutdown(conn->fd, SHUT_RDWR);
+        result = -1;
+    } else if (queued > CONN_WRITE_BUF_SOFT_LIMIT && droppable) {
+        if (conn->dropped++ % 100 == 0) {
+            LOG_ERROR("send_to_client: client sockfd %d is slow (%zu bytes "
+                      "queued), dropped %lu message(s).",
+                      sockfd, queued, conn->dropped);
+        }
+        result = 0;
+    } else if (append_write_buffer_locked(conn, frames, len) == 0 &&
+               flush_write_buffer_locked(conn) == 0) {
+        result = (int)len;
+    }
+    pthread_mutex_unlock(&conn->write_mutex);
+
+    connection_release(conn);
+    return result;
+}
+
+int send_to_client(int sockfd, const Message* msg) {
+    uint8_t frame[MAX_FRAME_SIZE];
+    int frame_len = encodeMessage(msg, frame, sizeof(frame));
+    if (frame_len < 0) {
+        LOG_ERROR("send_to_client: failed to encode message type %d.",
+                  msg->type);
+        return -1;
+    }
+    return enqueue_frames(sockfd, frame, frame_len,
+                          is_droppable_message(msg->type));
+}
+
+int send_frames_to_client(int sockfd, const uint8_t* frames, size_t len,
+                          int droppable) {
+    if (len == 0) {
+        return 0;
+    }
+    return enqueue_frames(sockfd, frames, len, droppable);
+}
+
+// --- ソケット補助 ---
+
+static int create_listen_socket(int port, int reuse_port) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0) {
+        LOG_ERROR("socket creation failed: %m");
+        return -1;
+    }
+
+    // アドレス再利用設定 (任意)
+    int opt = 1;
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) <
+        0) {
+        LOG_ERROR("setsockopt(SO_REUSEADDR) failed: %m");
+        // 致命的ではない場合が多いので続行してもよい
+    }
+    if (reuse_port && setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt,
+                                 sizeof(opt)) < 0) {
+        LOG_ERROR("setsockopt(SO_REUSEPORT) failed: %m");
+        close(listen_fd);
+        return -1;
+    }
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+
+    if (bind(listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) <
+        0) {
+        LOG_ERROR("bind failed: %m");
+        close(listen_fd);
+        return -1;
+    }
+    if (listen(listen_fd, SOMAXCONN) < 0) {
+        LOG_ERROR("listen failed: %m");
+        close(listen_fd);
+        return -1;
+    }
+    return listen_fd;
+}
+
+// --- 受信・切断処理 ---
+
+// 受信バッファから完全なフレームを取り出してハンドラに渡す
+// 戻り値: 0 成功, -1 不正なフレームを受信した
+static int dispatch_buffered_messages(Connection* conn) {
+    size_t offset = 0;
+    int result = 0;
+    while (offset < conn->rlen) {
+        Message msg;
+        int consumed =
+            decodeMessage(conn->rbuf + offset, conn->rlen - offset, &msg);
+        if (consumed == 0) {
+            break;  // フレームの残りを待つ
+        }
+        if (consumed < 0) {
+            LOG_ERROR("Malformed frame from client sockfd %d.", conn->fd);
+            result = -1;
+            break;
+        }
+        offset += consumed;
+        process_client_message(conn->fd, &msg);
+    }
+    if (offset > 0) {
+        memmove(conn->rbuf, conn->rbuf + offset, conn->rlen - offset);
+        conn->rlen -= offset;
+    }
+    return result;
+}
+
+// ソケットを読み切る (エッジトリガのため EAGAIN まで)
+// 戻り値: 1 継続, 0 相手が切断, -1 エラー
+static int drain_socket(Connection* conn) {
+    while (1) {
+        ssize_t n = recv(conn->fd, conn->rbuf + conn->rlen,
+                         sizeof(conn->rbuf) - conn->rlen, 0);
+        if (n > 0) {
+            conn->rlen += n;
+            metrics_add(METRIC_BYTES_IN, n);
+            if (dispatch_buffered_messages(conn) < 0) {
+                return -1;  // プロトコル違反の接続は切断する
+            }
+        } else if (n == 0) {
+            return 0;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 1;
+        } else {
+            LOG_ERROR("recv failed: %m");
+            return -1;
+        }
+    }
+}
+
+static void close_connection(Reactor* reactor, Connection* conn) {
+    int fd = conn->fd;
+    epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, fd, NULL);
+
+    // close 後に fd 番号が再利用されても、参照を借りている送信側が
+    // 別の接続へ書き込まないよう先に無効化しておく
+    pthread_mutex_lock(&conn->write_mutex);
+    conn->fd = -1;
+    conn->wlen = 0;
+    pthread_mutex_unlock(&conn->write_mutex);
+
+    // 部屋・クライアント情報の後始末とソケットのクローズ
+    // (handle_disconnect 内で remove_client が呼ばれるので、以降
+    // send_to_client から新たに参照されることはない)
+    handle_disconnect(fd);
+
+    connection_release(conn);
+}
+
+static void accept_connections(Reactor* reactor) {
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_sock = accept4(reactor->listen_fd,
+                                  (struct sockaddr*)&client_addr, &client_len,
+                                  SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_sock < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("accept failed: %m");
+            }
+            return;
+        }
+        // 通知は1フレームずつ小さく送るので Nagle で遅らせない
+        // (チャットの配信直後の着手通知が相手の遅延 ACK を待っていた)
+        int one = 1;
+        setsockopt(client_sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        LOG_INFO("Client connected from %s:%d (assigned sockfd: %d)",
+                 inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port),
+                 client_sock);
+
+        Connection* conn = connection_new(client_sock);
+        if (conn == NULL) {
+            LOG_ERROR("Failed to allocate connection: %m");
+            close(client_sock);
+            continue;
+        }
+
+        // クライアント情報を追加
+        if (add_client(client_sock, client_addr, conn) < 0) {
+            LOG_ERROR(
+                "Failed to add client (server full?): closing connection %d",
+                client_sock);
+            // TODO: サーバー満員通知をクライアントに送信する (オプション)
+            close(client_sock);
+            connection_release(conn);
+            continue;
+        }
+        metrics_add(METRIC_CONNECTS, 1);
+
+        // 共有リスナの場合はリアクタ間でラウンドロビンに振り分ける
+        Reactor* target = reactor;
+        if (reactor_count > 1 && reactors[1].listen_fd == -1) {
+            unsigned int idx =
+                __atomic_fetch_add(&next_reactor, 1, __ATOMIC_RELAXED);
+            target = &reactors[idx % reactor_count];
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (epoll_ctl(target->epfd, EPOLL_CTL_ADD, client_sock, &ev) < 0) {
+            LOG_ERROR("epoll_ctl(ADD) failed: %m");
+            remove_client(client_sock);
+            close(client_sock);
+            connection_release(conn);
+            continue;
+        }
+    }
+}
+
+// --- リアクタスレッド ---
+static void* reactor_main(void* arg) {
+    Reactor* reactor = (Reactor*)arg;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+
+    LOG_INFO("Reactor %d started.", reactor->id);
+
+    while (1) {
+        int n = epoll_wait(reactor->epfd, events, MAX_EPOLL_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait failed: %m");
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            // data.ptr == NULL は待ち受けソケット
+            if (events[i].data.ptr == NULL) {
+                accept_connections(reactor);
+                continue;
+            }
+
+            Connection* conn = (Connection*)events[i].data.ptr;
+            uint32_t ev = events[i].events;
+
+            if (ev & EPOLLOUT) {
+                pthread_mutex_lock(&conn->write_mutex);
+                flush_write_buffer_locked(conn);
+                pthread_mutex_unlock(&conn->write_mutex);
+            }
+
+            int alive = 1;
+            if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                alive = drain_socket(conn);
+                if (alive == 0) {
+                    LOG_DEBUG("Client sockfd %d connection closed gracefully.",
+                              conn->fd);
+                } else if (alive < 0) {
+                    LOG_ERROR("Receive error from client sockfd %d.", conn->fd);
+                } else if (ev & (EPOLLHUP | EPOLLERR)) {
+                    alive = 0;
+                }
+            }
+
+            if (alive <= 0) {
+                close_connection(reactor, conn);
+            }
+        }
+    }
+
+    LOG_INFO("Reactor %d exiting.", reactor->id);
+    return NULL;
+}
+
+int run_event_loop(int port, int num_threads, int reuse_port) {
+    if (num_threads < 1) num_threads = 1;
+
+    reactors = calloc(num_threads, sizeof(Reactor));
+    if (reactors == NULL) {
+        LOG_ERROR("Failed to allocate reactors: %m");
+        return -1;
+    }
+    reactor_count = num_threads;
+
+    for (int i = 0; i < num_threads; ++i) {
+        reactors[i].id = i;
+        reactors[i].listen_fd = -1;
+        reactors[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (reactors[i].epfd < 0) {
+            LOG_ERROR("epoll_create1 failed: %m");
+            return -1;
+        }
+
+        // SO_REUSEPORT 時は全リアクタ、そうでなければリアクタ0のみが待ち受ける
+        if (i == 0 || reuse_port) {
+            reactors[i].listen_fd = create_listen_socket(port, reuse_port);
+            if (reactors[i].listen_fd < 0) {
+                return -1;
+            }
+            struct epoll_event ev;
+            ev.events = EPOLLIN | EPOLLET;
+            ev.data.ptr = NULL;
+            if (epoll_ctl(reactors[i].epfd, EPOLL_CTL_ADD,
+                          reactors[i].listen_fd, &ev) < 0) {
+                LOG_ERROR("epoll_ctl(ADD listen) failed: %m");
+                return -1;
+            }
+        }
+    }
+
+    LOG_INFO("Server listening on port %d (%d reactor thread(s)%s)", port,
+             num_threads, reuse_port ? ", SO_REUSEPORT" : "");
+
+    for (int i = 1; i < num_threads; ++i) {
+        if (pthread_create(&reactors[i].thread_id, NULL, reactor_main,
+                           &reactors[i]) != 0) {
+            LOG_ERROR("pthread_create failed: %m");
+            return -1;
+        }
+    }
+
+    // メインスレッドはリアクタ0として動作する
+    reactors[0].thread_id = pthread_self();
+    reactor_main(&reactors[0]);
+    return 0;
+}
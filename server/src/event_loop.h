@@ -0,0 +1,38 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "server_common.h"
+
+// --- 定数定義 ---
+#define MAX_EPOLL_EVENTS 256  // 1回の epoll_wait で処理する最大イベント数
+#define CONN_READ_BUF_SIZE (MAX_FRAME_SIZE * 2)  // 接続ごとの受信バッファ
+#define CONN_WRITE_BUF_INITIAL 1024  // 送信バッファの初期確保サイズ
+// 送信キューの上限 (受信が遅いクライアントのために無制限に溜めない)
+#define CONN_WRITE_BUF_SOFT_LIMIT (64 * 1024)  // 超えたらチャットを破棄
+#define CONN_WRITE_BUF_HARD_LIMIT (256 * 1024)  // 超えたら接続を切断
+
+// 接続ごとの入出力コンテキスト (実体は event_loop.c)
+typedef struct Connection Connection;
+
+// --- 関数プロトタイプ ---
+
+// イベントループを起動する (呼び出したスレッドもリアクタ0として動作し、戻らない)
+// num_threads: リアクタスレッド数, reuse_port: 1なら SO_REUSEPORT
+// でリアクタごとに待ち受けソケットを持つ 戻り値: 起動失敗時 -1
+int run_event_loop(int port, int num_threads, int reuse_port);
+
+// クライアントへメッセージを送信する (送信キューに積み、可能な分だけ即時送信)
+// ブロックしない。送り切れない分は相手のリアクタが EPOLLOUT で送る。
+// キューが SOFT_LIMIT を超えていればチャットは破棄 (戻り値 0)、
+// HARD_LIMIT を超える場合は相手を切断する (戻り値 -1)。
+// 戻り値: 成功なら積んだバイト数、破棄なら 0、失敗なら -1
+int send_to_client(int sockfd, const Message* msg);
+
+// encodeMessage 済みのフレーム列をまとめて送信キューに積む
+// (ロック取得と送信システムコールを1回で済ませる。チャット履歴の一括送信用)
+// droppable: 1 なら send_to_client のチャットと同様に SOFT_LIMIT 超過で破棄
+// 戻り値: send_to_client と同じ
+int send_frames_to_client(int sockfd, const uint8_t* frames, size_t len,
+                          int droppable);
+
+#endif  // EVENT_LOOP_H
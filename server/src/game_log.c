@@ -0,0 +1,198 @@
+#include "game_log.h"
+
+#include <fcntl.h>
+
+#include "logger.h"
+
+#define GAME_LOG_RECORD_MAX \
+    (4 + GAME_LOG_HEADER_SIZE + BOARD_SIZE * BOARD_SIZE)
+
+// 書き込み待ちのレコード (エンコード済み)
+typedef struct {
+    int size;
+    uint8_t bytes[GAME_LOG_RECORD_MAX];
+} QueuedRecord;
+
+static int log_fd = -1;
+static pthread_t writer_thread_id;
+
+// 書き込み待ちのリングバッファ (queue_mutex で保護)
+static QueuedRecord queue[GAME_LOG_QUEUE_LEN];
+static int queue_head = 0;   // 最も古いレコード
+static int queue_count = 0;  // 書き込み待ちの数
+static unsigned long dropped_count = 0;  // キューが一杯で捨てた数
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+// 書き込みスレッドがまとめて書くためのバッファ (書き込みスレッド専用)
+static uint8_t batch[GAME_LOG_QUEUE_LEN * GAME_LOG_RECORD_MAX];
+
+static uint8_t* put_u32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+    return p + 4;
+}
+
+static uint8_t* put_u64(uint8_t* p, uint64_t v) {
+    p = put_u32(p, (uint32_t)(v >> 32));
+    return put_u32(p, (uint32_t)v);
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+// 部分書き込み・シグナル割り込みを考慮して len バイトすべて書く
+static int write_all(int fd, const uint8_t* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 書き込み待ちのレコードをまとめて書き、1回の fdatasync で確定させる
+static void* writer_thread(void* arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&queue_mutex);
+        while (queue_count == 0) {
+            pthread_cond_wait(&queue_cond, &queue_mutex);
+        }
+        // ロック中はコピーだけ行い、ディスクへの書き込みはロックの外で行う
+        size_t len = 0;
+        int games = queue_count;
+        for (int i = 0; i < games; ++i) {
+            const QueuedRecord* r =
+                &queue[(queue_head + i) % GAME_LOG_QUEUE_LEN];
+            memcpy(batch + len, r->bytes, r->size);
+            len += r->size;
+        }
+        queue_head = (queue_head + games) % GAME_LOG_QUEUE_LEN;
+        queue_count = 0;
+        pthread_mutex_unlock(&queue_mutex);
+
+        // 失敗したら書きかけのレコードを切り詰め、以降の追記を読めるように保つ
+        off_t offset = lseek(log_fd, 0, SEEK_END);
+        if (offset < 0 || write_all(log_fd, batch, len) < 0 ||
+            fdatasync(log_fd) < 0) {
+            LOG_ERROR("Failed to write game log: %m");
+            if (offset >= 0 && ftruncate(log_fd, offset) < 0) {
+                LOG_ERROR("Failed to truncate game log: %m");
+            }
+            pthread_mutex_lock(&queue_mutex);
+            dropped_count += games;
+            pthread_mutex_unlock(&queue_mutex);
+            continue;
+        }
+        LOG_INFO("Game log: committed %d game(s), %zu bytes.", games, len);
+    }
+    return NULL;
+}
+
+int game_log_open(const char* path) {
+    log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd < 0) {
+        LOG_ERROR("Failed to open game log: %m");
+        return -1;
+    }
+    if (pthread_create(&writer_thread_id, NULL, writer_thread, NULL) != 0) {
+        LOG_ERROR("Failed to create game log writer thread: %m");
+        close(log_fd);
+        log_fd = -1;
+        return -1;
+    }
+    pthread_detach(writer_thread_id);
+    LOG_INFO("Game log: appending finished games to %s.", path);
+    return 0;
+}
+
+void game_log_append(const Room* room, int winner, int end_reason) {
+    if (log_fd < 0) {
+        return;
+    }
+    const GameState* gs = &room->gameState;
+    int flags = (room->player2_sock == AI_PLAYER_SOCK)
+                    ? GAME_LOG_FLAG_WHITE_AI
+                    : 0;
+
+    pthread_mutex_lock(&queue_mutex);
+    if (queue_count == GAME_LOG_QUEUE_LEN) {
+        // 書き込みが追いつかないときは対局の処理を止めずに捨てる
+        ++dropped_count;
+        pthread_mutex_unlock(&queue_mutex);
+        LOG_WARN("Warning: Game log queue is full; dropped game in room %d "
+                 "(%lu dropped).",
+                 room->roomId, dropped_count);
+        return;
+    }
+    QueuedRecord* r =
+        &queue[(queue_head + queue_count) % GAME_LOG_QUEUE_LEN];
+    uint8_t* p = put_u32(r->bytes, GAME_LOG_HEADER_SIZE + gs->move_seq);
+    *p++ = GAME_LOG_VERSION;
+    *p++ = end_reason;
+    *p++ = winner;
+    *p++ = flags;
+    p = put_u32(p, (uint32_t)room->roomId);
+    p = put_u64(p, (uint64_t)time(NULL));
+    *p++ = gs->black_count;
+    *p++ = gs->white_count;
+    *p++ = gs->move_seq;
+    memcpy(p, gs->move_history, gs->move_seq);
+    p += gs->move_seq;
+    r->size = p - r->bytes;
+    ++queue_count;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+void game_log_stats(int* queued, unsigned long* dropped) {
+    pthread_mutex_lock(&queue_mutex);
+    *queued = queue_count;
+    *dropped = dropped_count;
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+int game_log_read(FILE* fp, GameLogRecord* out) {
+    uint8_t buf[GAME_LOG_RECORD_MAX];
+    size_t n = fread(buf, 1, 4, fp);
+    if (n == 0) {
+        return 0;
+    }
+    if (n < 4) {
+        return -1;
+    }
+    uint32_t len = get_u32(buf);
+    if (len < GAME_LOG_HEADER_SIZE ||
+        len > GAME_LOG_HEADER_SIZE + BOARD_SIZE * BOARD_SIZE ||
+        fread(buf, 1, len, fp) != len) {
+        return -1;
+    }
+
+    out->version = buf[0];
+    out->end_reason = buf[1];
+    out->winner = buf[2];
+    out->flags = buf[3];
+    out->roomId = (int32_t)get_u32(buf + 4);
+    out->ended_at =
+        (time_t)(((uint64_t)get_u32(buf + 8) << 32) | get_u32(buf + 12));
+    out->black_count = buf[16];
+    out->white_count = buf[17];
+    out->move_count = buf[18];
+    if (out->version != GAME_LOG_VERSION ||
+        out->move_count != (int)(len - GAME_LOG_HEADER_SIZE)) {
+        return -1;
+    }
+    memcpy(out->moves, buf + GAME_LOG_HEADER_SIZE, out->move_count);
+    return 1;
+}
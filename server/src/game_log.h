@@ -0,0 +1,70 @@
+#ifndef GAME_LOG_H
+#define GAME_LOG_H
+
+#include <stdio.h>
+
+#include "server_common.h"
+
+// --- 棋譜ログ ---
+// 終局した対局の棋譜を、追記専用のバイナリファイルに1局1レコードで書く。
+// 部屋の着手列 (GameState.move_history) を終局時にキューへ積むだけで、
+// ファイルへの書き込みと fdatasync は専用の書き込みスレッドが行う。
+// 書き込み中に積まれたレコードは次の1回の write と fdatasync にまとめる
+// (グループコミット) ので、対局の処理が同期書き込みを待つことはない。
+//
+// レコードの形式 (数値はすべてビッグエンディアン):
+//   u32 長さ (この後に続くバイト数)
+//   u8  形式の版 (GAME_LOG_VERSION)
+//   u8  終局の理由 (GAME_LOG_END_*)
+//   u8  勝敗 (0:なし, 1:黒勝, 2:白勝, 3:引分)
+//   u8  対局者 (GAME_LOG_FLAG_* の組み合わせ)
+//   u32 部屋ID
+//   u64 終局時刻 (UNIX 時間、秒)
+//   u8  黒石の数, u8 白石の数
+//   u8  手数 N
+//   u8  着手したマス (r * 8 + c) × N (パスは含まない)
+// 途中で切れた末尾のレコード (書き込み中の停止) は読み込み時に無視できる。
+
+#define GAME_LOG_VERSION 1
+#define GAME_LOG_HEADER_SIZE 19  // 長さの後、着手の前までのバイト数
+#define GAME_LOG_QUEUE_LEN 256   // 書き込み待ちにできるレコード数
+
+// 終局の理由
+#define GAME_LOG_END_NORMAL 1      // 両者とも打てなくなった
+#define GAME_LOG_END_TIMEOUT 2     // 手番側の時間切れ
+#define GAME_LOG_END_DISCONNECT 3  // 対局中の切断 (勝敗なし)
+
+// 対局者
+#define GAME_LOG_FLAG_WHITE_AI 0x01  // 白番が AI
+
+// 読み込んだ1局分のレコード
+typedef struct {
+    int version;
+    int end_reason;
+    int winner;
+    int flags;
+    int roomId;
+    time_t ended_at;
+    int black_count;
+    int white_count;
+    int move_count;
+    uint8_t moves[BOARD_SIZE * BOARD_SIZE];
+} GameLogRecord;
+
+// path を追記用に開き、書き込みスレッドを起動する (起動時に1回呼ぶ)
+// 戻り値: 失敗時 -1
+int game_log_open(const char* path);
+
+// 終局した部屋の棋譜を書き込み待ちに積む (room_mutex ロック中に呼ぶ)
+// 棋譜ログを開いていなければ何もしない
+void game_log_append(const Room* room, int winner, int end_reason);
+
+// 書き込み待ちのレコード数と、キューが一杯か書き込みの失敗で捨てた累計
+// (計測値用)
+void game_log_stats(int* queued, unsigned long* dropped);
+
+// fp から次のレコードを読む (確認・再生ツール用)
+// 戻り値: 1:読めた, 0:ファイルの終わり, -1:壊れている・途中で切れている
+int game_log_read(FILE* fp, GameLogRecord* out);
+
+#endif  // GAME_LOG_H
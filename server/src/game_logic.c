@@ -1,59 +1,133 @@
 #include "game_logic.h"
 
-#include <stdio.h>  // for printf in debug messages (optional)
+#include "logger.h"
+
+// --- ビットボード補助 ---
+
+// 列 0 / 列 7 を除外するマスク (横・斜め方向のシフトで行を跨がないように)
+#define NOT_COL_0 0xFEFEFEFEFEFEFEFEULL
+#define NOT_COL_7 0x7F7F7F7F7F7F7F7FULL
+
+// 8方向のシフト量とシフト後に適用するマスク
+// 正のシフトは左シフト (インデックス増加方向)、負は右シフト
+static const struct {
+    int shift;
+    Bitboard mask;
+} kDirections[8] = {
+    {1, NOT_COL_0},   // 右
+    {-1, NOT_COL_7},  // 左
+    {8, ~0ULL},       // 下
+    {-8, ~0ULL},      // 上
+    {9, NOT_COL_0},   // 右下
+    {7, NOT_COL_7},   // 左下
+    {-7, NOT_COL_0},  // 右上
+    {-9, NOT_COL_7},  // 左上
+};
+
+static inline Bitboard shift_bits(Bitboard b, int shift) {
+    return shift > 0 ? b << shift : b >> -shift;
+}
+
+// player/opponent のビットボードを playerColor に合わせて取り出す
+static inline void get_bitboards(const GameState* gs, int playerColor,
+                                 Bitboard* player, Bitboard* opponent) {
+    *player = (playerColor == 1) ? gs->black : gs->white;
+    *opponent = (playerColor == 1) ? gs->white : gs->black;
+}
+
+// 両者の合法手キャッシュを現在のビットボードから作り直す
+static inline void refresh_legal_moves(GameState* gs) {
+    gs->legal_black = bitboard_legal_moves(gs->black, gs->white);
+    gs->legal_white = bitboard_legal_moves(gs->white, gs->black);
+}
 
-// --- 補助関数 ---
 // (r, c) が盤面内にあるかチェック
 static inline int is_within_bounds(int r, int c) {
     return r >= 0 && r < BOARD_SIZE && c >= 0 && c < BOARD_SIZE;
 }
 
-// 指定方向に相手の石が連続し、その先に自分の石があるかチェック
-// ひっくり返せる数を返す (0ならひっくり返せない)
-static int check_direction(const GameState* gs, int playerColor, int r, int c,
-                           int dr, int dc) {
-    int opponentColor = (playerColor == 1) ? 2 : 1;
-    int flipped_count = 0;
-    int current_r = r + dr;
-    int current_c = c + dc;
+// --- ビットボード関数 ---
 
-    // 1. 隣が相手の石か？
-    if (!is_within_bounds(current_r, current_c) ||
-        gs->board[current_r][current_c] != opponentColor) {
-        return 0;
+Bitboard bitboard_legal_moves(Bitboard player, Bitboard opponent) {
+    Bitboard empty = ~(player | opponent);
+    Bitboard moves = 0;
+
+    for (int d = 0; d < 8; ++d) {
+        int s = kDirections[d].shift;
+        Bitboard o = opponent & kDirections[d].mask;
+        // 自分の石から相手の石が連続する範囲を伸ばす (最大6個)
+        Bitboard t = o & shift_bits(player, s);
+        t |= o & shift_bits(t, s);
+        t |= o & shift_bits(t, s);
+        t |= o & shift_bits(t, s);
+        t |= o & shift_bits(t, s);
+        t |= o & shift_bits(t, s);
+        // その先の空きマスが合法手
+        moves |= empty & kDirections[d].mask & shift_bits(t, s);
     }
+    return moves;
+}
 
-    // 2. その先に相手の石が続いているか？
-    while (is_within_bounds(current_r, current_c)) {
-        if (gs->board[current_r][current_c] == opponentColor) {
-            flipped_count++;
-        } else if (gs->board[current_r][current_c] == playerColor) {
-            // 3. 自分の石が見つかったら、この方向は有効
-            return flipped_count;
-        } else {  // 空きマスが見つかったらダメ
-            return 0;
-        }
-        current_r += dr;
-        current_c += dc;
+Bitboard bitboard_flips(Bitboard player, Bitboard opponent, int square) {
+    Bitboard move = (Bitboard)1 << square;
+    Bitboard flips = 0;
+
+    if ((player | opponent) & move) return 0;  // 空きマスではない
+
+    for (int d = 0; d < 8; ++d) {
+        int s = kDirections[d].shift;
+        Bitboard mask = kDirections[d].mask;
+        Bitboard o = opponent & mask;
+        // 置いたマスから相手の石が連続する範囲を伸ばす
+        Bitboard f = o & shift_bits(move, s);
+        f |= o & shift_bits(f, s);
+        f |= o & shift_bits(f, s);
+        f |= o & shift_bits(f, s);
+        f |= o & shift_bits(f, s);
+        f |= o & shift_bits(f, s);
+        // 連続の先に自分の石があれば、この方向の石はすべて裏返る
+        if (player & mask & shift_bits(f, s)) flips |= f;
     }
+    return flips;
+}
 
-    // 盤面の端まで相手の石が続いた場合もダメ
-    return 0;
+// --- Zobrist ハッシュ ---
+
+uint64_t zobrist_keys[2][BOARD_SIZE * BOARD_SIZE];
+uint64_t zobrist_flip_keys[BOARD_SIZE * BOARD_SIZE];
+uint64_t zobrist_side_key;
+
+// 乱数表用の擬似乱数 (splitmix64)。起動ごとに同じ表になる
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
 }
 
-// 指定されたマスに石を置いた場合にひっくり返せる石の総数を返す
-// (is_valid_moveの実質的な本体)
-static int get_total_flips_for_move(const GameState* gs, int playerColor, int r,
-                                    int c) {
-    // 方向ベクトル (8方向)
-    const int dr[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-    const int dc[] = {-1, 0, 1, -1, 1, -1, 0, 1};
-    int total_flips = 0;
+void zobrist_init(void) {
+    uint64_t state = 0x4F74656C6C6F5A42ULL;
+    for (int sq = 0; sq < BOARD_SIZE * BOARD_SIZE; ++sq) {
+        zobrist_keys[0][sq] = splitmix64(&state);
+        zobrist_keys[1][sq] = splitmix64(&state);
+        zobrist_flip_keys[sq] = zobrist_keys[0][sq] ^ zobrist_keys[1][sq];
+    }
+    zobrist_side_key = splitmix64(&state);
+}
 
-    for (int i = 0; i < 8; ++i) {
-        total_flips += check_direction(gs, playerColor, r, c, dr[i], dc[i]);
+uint64_t zobrist_hash(Bitboard black, Bitboard white) {
+    uint64_t hash = 0;
+    for (; black; black &= black - 1) {
+        hash ^= zobrist_keys[0][__builtin_ctzll(black)];
+    }
+    for (; white; white &= white - 1) {
+        hash ^= zobrist_keys[1][__builtin_ctzll(white)];
     }
-    return total_flips;
+    return hash;
+}
+
+Bitboard get_legal_moves(const GameState* gs, int playerColor) {
+    return (playerColor == 1) ? gs->legal_black : gs->legal_white;
 }
 
 // --- メイン関数 ---
@@ -65,160 +139,133 @@ void initialize_game_state(GameState* gs) {
     gs->board[BOARD_SIZE / 2][BOARD_SIZE / 2] = 2;          // 白
     gs->board[BOARD_SIZE / 2 - 1][BOARD_SIZE / 2] = 1;      // 黒
     gs->board[BOARD_SIZE / 2][BOARD_SIZE / 2 - 1] = 1;      // 黒
-    gs->currentTurn = 1;                                    // 黒番から開始
+    gs->white = SQUARE_BIT(BOARD_SIZE / 2 - 1, BOARD_SIZE / 2 - 1) |
+                SQUARE_BIT(BOARD_SIZE / 2, BOARD_SIZE / 2);
+    gs->black = SQUARE_BIT(BOARD_SIZE / 2 - 1, BOARD_SIZE / 2) |
+                SQUARE_BIT(BOARD_SIZE / 2, BOARD_SIZE / 2 - 1);
+    gs->black_count = 2;
+    gs->white_count = 2;
+    gs->move_seq = 0;
+    gs->last_flips = 0;
+    gs->hash = zobrist_hash(gs->black, gs->white);
+    refresh_legal_moves(gs);
+    gs->currentTurn = 1;  // 黒番から開始
     // printf("Game state initialized.\n");
 }
 
 // (r, c) が playerColor にとって有効な手かチェックする
 int is_valid_move(const GameState* gs, int playerColor, int r, int c) {
-    // 1. 盤面内で、空いているか？
-    if (!is_within_bounds(r, c) || gs->board[r][c] != 0) {
-        return 0;
-    }
-
-    // 2. 相手の石を1つ以上ひっくり返せるか？
-    if (get_total_flips_for_move(gs, playerColor, r, c) > 0) {
-        return 1;  // ひっくり返せるので有効
-    }
+    if (!is_within_bounds(r, c)) return 0;
 
-    return 0;  // ひっくり返せないので無効
+    // 合法手キャッシュに含まれていれば有効
+    return (get_legal_moves(gs, playerColor) & SQUARE_BIT(r, c)) != 0;
 }
 
 // 盤面を更新する (石を置き、相手の石をひっくり返す)
+// 着手は move_history にも記録する
 // 戻り値: ひっくり返した石の数
 int update_board(GameState* gs, int playerColor, int r, int c) {
     // 事前に is_valid_move
     // でチェックされている想定だが、念のため基本的なチェック
     if (!is_within_bounds(r, c) || gs->board[r][c] != 0) {
-        fprintf(stderr,
-                "Error: update_board called for invalid position (%d, %d)\n", r,
-                c);
+        LOG_ERROR("Error: update_board called for invalid position (%d, %d)", r,
+                  c);
         return 0;
     }
 
-    // 方向ベクトル (8方向)
-    const int dr[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-    const int dc[] = {-1, 0, 1, -1, 1, -1, 0, 1};
-    int total_flipped_count = 0;
-    int opponentColor = (playerColor == 1) ? 2 : 1;
+    Bitboard player, opponent;
+    get_bitboards(gs, playerColor, &player, &opponent);
+    Bitboard move = SQUARE_BIT(r, c);
+    Bitboard flips = bitboard_flips(player, opponent, SQUARE_INDEX(r, c));
 
-    // まず石を置く
-    gs->board[r][c] = playerColor;
-    // printf("GameLogic: Placed piece at (%d, %d) for player %d.\n", r, c,
-    // playerColor);
-
-    // 各方向についてひっくり返す処理
-    for (int i = 0; i < 8; ++i) {
-        int flips_in_direction =
-            check_direction(gs, playerColor, r, c, dr[i], dc[i]);
-        if (flips_in_direction > 0) {
-            // printf("  Flipping %d stones in direction (%d, %d)\n",
-            // flips_in_direction, dr[i], dc[i]);
-            int current_r = r + dr[i];
-            int current_c = c + dc[i];
-            // ひっくり返す処理
-            for (int j = 0; j < flips_in_direction; ++j) {
-                // is_within_bounds チェックは check_direction
-                // で担保されているはず
-                if (gs->board[current_r][current_c] == opponentColor) {
-                    gs->board[current_r][current_c] = playerColor;
-                    total_flipped_count++;
-                } else {
-                    // 予期せぬエラー: 相手の石ではない
-                    fprintf(stderr,
-                            "Error: Trying to flip non-opponent stone at (%d, "
-                            "%d)!\n",
-                            current_r, current_c);
-                    break;  // この方向のフリップを中止
-                }
-                current_r += dr[i];
-                current_c += dc[i];
-            }
-        }
+    if (flips == 0) {
+        // is_valid_move はOKだったのに、ひっくり返せなかった場合のエラーチェック
+        LOG_WARN("Warning: Move at (%d, %d) by player %d resulted in 0 flips, "
+                 "but should have been valid.",
+                 r, c, playerColor);
     }
 
-    if (total_flipped_count == 0 &&
-        get_total_flips_for_move(gs, playerColor, r, c) > 0) {
-        // is_valid_move
-        // はOKだったのに、ひっくり返せなかった場合のエラーチェック
-        fprintf(stderr,
-                "Warning: Move at (%d, %d) by player %d resulted in 0 flips, "
-                "but should have been valid.\n",
-                r, c, playerColor);
+    // ビットボードと石数を更新
+    int flipped = __builtin_popcountll(flips);
+    player |= move | flips;
+    opponent &= ~flips;
+    if (playerColor == 1) {
+        gs->black = player;
+        gs->white = opponent;
+        gs->black_count += flipped + 1;
+        gs->white_count -= flipped;
+    } else {
+        gs->white = player;
+        gs->black = opponent;
+        gs->white_count += flipped + 1;
+        gs->black_count -= flipped;
     }
-    // printf("GameLogic: Flipped %d stones total.\n", total_flipped_count);
+    refresh_legal_moves(gs);
+    gs->move_history[gs->move_seq] = SQUARE_INDEX(r, c);
+    gs->move_seq++;
+    gs->last_flips = flips;
+    gs->hash = zobrist_move(gs->hash, playerColor, SQUARE_INDEX(r, c), flips);
 
-    return total_flipped_count;
+    // board 配列 (プロトコル送信用) を同期
+    gs->board[r][c] = playerColor;
+    for (Bitboard b = flips; b; b &= b - 1) {
+        int sq = __builtin_ctzll(b);
+        gs->board[sq / BOARD_SIZE][sq % BOARD_SIZE] = playerColor;
+    }
+
+    return flipped;
 }
 
 // playerColor が置ける場所があるかチェックする (パス判定用)
 int has_valid_moves(const GameState* gs, int playerColor) {
-    for (int r = 0; r < BOARD_SIZE; ++r) {
-        for (int c = 0; c < BOARD_SIZE; ++c) {
-            // 空きマスに対してのみチェック
-            if (gs->board[r][c] == 0) {
-                if (is_valid_move(gs, playerColor, r, c)) {
-                    // printf("GameLogic: Player %d has a valid move at (%d,
-                    // %d)\n", playerColor, r, c);
-                    return 1;  // 置ける場所が見つかった
-                }
-            }
-        }
-    }
-    // printf("GameLogic: Player %d has no valid moves.\n", playerColor);
-    return 0;  // 置ける場所がない
+    return get_legal_moves(gs, playerColor) != 0;
 }
 
 // ゲームが終了したかチェックする
 // 戻り値: 0:継続, 1:黒勝, 2:白勝, 3:引分
 int check_game_over(const GameState* gs) {
-    // 1. 両プレイヤーとも置ける場所がないか？
-    int black_can_move = has_valid_moves(gs, 1);
-    int white_can_move = has_valid_moves(gs, 2);
-
-    if (!black_can_move && !white_can_move) {
-        printf(
+    if (gs->black_count + gs->white_count == BOARD_SIZE * BOARD_SIZE) {
+        LOG_INFO("GameLogic: Game over condition - Board is full.");
+    } else if (gs->legal_black == 0 && gs->legal_white == 0) {
+        LOG_INFO(
             "GameLogic: Game over condition - Both players have no valid "
-            "moves.\n");
-        // ゲーム終了 -> 勝敗判定
+            "moves.");
     } else {
-        // 2. 盤面がすべて埋まっているか？
-        int empty_count = 0;
-        for (int i = 0; i < BOARD_SIZE; ++i) {
-            for (int j = 0; j < BOARD_SIZE; ++j) {
-                if (gs->board[i][j] == 0) {
-                    empty_count++;
-                    break;  // 1つでも空きがあれば盤面は埋まっていない
-                }
-            }
-            if (empty_count > 0) break;
-        }
-
-        if (empty_count == 0) {
-            printf("GameLogic: Game over condition - Board is full.\n");
-            // ゲーム終了 -> 勝敗判定
-        } else {
-            // どちらかが動けて、かつ盤面に空きがある -> ゲーム継続
-            return 0;
-        }
+        // どちらかが動けて、かつ盤面に空きがある -> ゲーム継続
+        return 0;
     }
 
     // --- ゲーム終了時の勝敗判定 ---
-    int black_score = 0;
-    int white_score = 0;
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            if (gs->board[i][j] == 1)
-                black_score++;
-            else if (gs->board[i][j] == 2)
-                white_score++;
-        }
-    }
+    int black_score = gs->black_count;
+    int white_score = gs->white_count;
 
-    printf("GameLogic: Final score - Black (1): %d, White (2): %d\n",
-           black_score, white_score);
+    LOG_INFO("GameLogic: Final score - Black (1): %d, White (2): %d",
+             black_score, white_score);
 
     if (black_score > white_score) return 1;  // 黒勝利
     if (white_score > black_score) return 2;  // 白勝利
     return 3;                                 // 引き分け
-}
\ No newline at end of file
+}
+
+// 初期局面から moves を順に打ち直す (棋譜の再生・対局の復元用)
+int replay_moves(GameState* gs, const uint8_t* moves, int count) {
+    initialize_game_state(gs);
+    int color = 1;
+    for (int i = 0; i < count; ++i) {
+        if (!has_valid_moves(gs, color)) {
+            color = 3 - color;  // パス
+        }
+        int sq = moves[i];
+        if (sq >= BOARD_SIZE * BOARD_SIZE ||
+            !is_valid_move(gs, color, sq / BOARD_SIZE, sq % BOARD_SIZE)) {
+            return -1;
+        }
+        update_board(gs, color, sq / BOARD_SIZE, sq % BOARD_SIZE);
+        color = 3 - color;
+    }
+    if (!has_valid_moves(gs, color)) {
+        color = 3 - color;
+    }
+    gs->currentTurn = color;
+    return 0;
+}
@@ -3,27 +3,73 @@
 
 #include "server_common.h"
 
+// --- ビットボード ---
+// 64bit の各ビットが盤面の1マスに対応する (bit r*8+c が (r, c))
+typedef uint64_t Bitboard;
+
+#define SQUARE_INDEX(r, c) ((r) * BOARD_SIZE + (c))
+#define SQUARE_BIT(r, c) ((Bitboard)1 << SQUARE_INDEX(r, c))
+
+// player の石から見た合法手の集合を返す (シフトとマスクのみで計算)
+Bitboard bitboard_legal_moves(Bitboard player, Bitboard opponent);
+
+// player が square (0-63) に置いたときに裏返る opponent の石の集合を返す
+// 0 なら非合法手
+Bitboard bitboard_flips(Bitboard player, Bitboard opponent, int square);
+
+// GameState から playerColor の合法手の集合を返す (キャッシュ参照のみ)
+Bitboard get_legal_moves(const GameState* gs, int playerColor);
+
+// --- Zobrist ハッシュ ---
+// 局面のハッシュは石のあるマスごとの乱数の XOR で、着手のたびに置いた石と
+// 裏返った石の分だけ更新できる。手番は含めず、必要なら zobrist_side_key を
+// XOR する (AI の探索で使う)
+
+// [色 - 1][マス] ごとの乱数 (zobrist_init で設定)
+extern uint64_t zobrist_keys[2][BOARD_SIZE * BOARD_SIZE];
+// 石の色が反転したときに XOR する値 (zobrist_keys[0][sq] ^ zobrist_keys[1][sq])
+extern uint64_t zobrist_flip_keys[BOARD_SIZE * BOARD_SIZE];
+extern uint64_t zobrist_side_key;  // 白番の局面に XOR する値
+
+// 乱数表を設定する (起動時に1回呼ぶ)
+void zobrist_init(void);
+
+// 石の配置からハッシュを計算し直す
+uint64_t zobrist_hash(Bitboard black, Bitboard white);
+
+// hash の局面で playerColor が square に置き flips を裏返した後のハッシュ
+static inline uint64_t zobrist_move(uint64_t hash, int playerColor, int square,
+                                    Bitboard flips) {
+    hash ^= zobrist_keys[playerColor - 1][square];
+    for (; flips; flips &= flips - 1) {
+        hash ^= zobrist_flip_keys[__builtin_ctzll(flips)];
+    }
+    return hash;
+}
+
 // --- ゲームロジック関数プロトタイプ ---
 
 // ゲーム状態を初期化する (オセロの初期配置)
 void initialize_game_state(GameState* gs);
 
 // (r, c) が playerColor にとって有効な手かチェックする
-// (今回はスタブ実装)
 int is_valid_move(const GameState* gs, int playerColor, int r, int c);
 
 // 盤面を更新する (石を置き、相手の石をひっくり返す)
-// (今回はスタブ実装 - 石を置くだけ)
-// 戻り値: ひっくり返した石の数など (必要に応じて)
+// ビットボード・board 配列・合法手/石数キャッシュ・ハッシュをまとめて更新する
+// 戻り値: ひっくり返した石の数
 int update_board(GameState* gs, int playerColor, int r, int c);
 
 // ゲームが終了したかチェックする
 // 戻り値: 0:継続, 1:黒勝, 2:白勝, 3:引分
-// (今回はスタブ実装 - 常に継続)
 int check_game_over(const GameState* gs);
 
 // playerColor が置ける場所があるかチェックする (パス判定用)
-// (今回はスタブ実装 - 常に置けると仮定)
 int has_valid_moves(const GameState* gs, int playerColor);
 
-#endif  // GAME_LOGIC_H
\ No newline at end of file
+// 初期局面から moves (r * 8 + c、パスは含まない) を順に打ち直す
+// 手番側に合法手が無ければパスを補い、終わったら currentTurn を次の手番にする
+// 戻り値: 打ち直せれば 0、非合法手があれば -1
+int replay_moves(GameState* gs, const uint8_t* moves, int count);
+
+#endif  // GAME_LOGIC_H
@@ -0,0 +1,36 @@
+#include "histogram.h"
+
+uint64_t hist_bucket_high(int b) {
+    if (b < HIST_SUB) {
+        return b;
+    }
+    int shift = b / HIST_SUB - 1;
+    return (((uint64_t)(b % HIST_SUB + HIST_SUB) + 1) << shift) - 1;
+}
+
+uint64_t hist_percentile(const uint64_t* hist, uint64_t total, double p) {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(total * p);
+    if (rank >= total) {
+        rank = total - 1;
+    }
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        seen += hist[b];
+        if (seen > rank) {
+            return hist_bucket_high(b);
+        }
+    }
+    return hist_bucket_high(HIST_BUCKETS - 1);
+}
+
+uint64_t hist_max(const uint64_t* hist) {
+    for (int b = HIST_BUCKETS - 1; b >= 0; --b) {
+        if (hist[b] > 0) {
+            return hist_bucket_high(b);
+        }
+    }
+    return 0;
+}
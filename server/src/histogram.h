@@ -0,0 +1,38 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// --- 対数ヒストグラム (HDR 形式) ---
+// 2 の冪ごとの区間を HIST_SUB 個に等分したバケットに値を数える。
+// どの大きさの値も相対誤差 1/HIST_SUB 以内で、バケット数は固定。
+// 数えるのは配列の1要素の加算だけなので、スレッドごとに持てばロック不要
+// (metrics.c のハンドラ時間、tools/load_gen.c の往復時間)。
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 40  // これ以上の値は最後のバケットに入れる
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+// 値 v を数えるバケットの番号
+static inline int hist_bucket(uint64_t v) {
+    if (v < HIST_SUB) {
+        return (int)v;
+    }
+    if (v >> HIST_MAX_BITS) {
+        return HIST_BUCKETS - 1;
+    }
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+}
+
+// バケット b に入る値の上限
+uint64_t hist_bucket_high(int b);
+
+// total 件を数えた hist の p 分位点 (0 < p <= 1) を、そのバケットの上限で返す
+uint64_t hist_percentile(const uint64_t* hist, uint64_t total, double p);
+
+// 値の入っている最大のバケットの上限 (空なら 0)
+uint64_t hist_max(const uint64_t* hist);
+
+#endif  // HISTOGRAM_H
@@ -0,0 +1,218 @@
+#include "lobby.h"
+
+#include "event_loop.h"
+#include "logger.h"
+#include "room_management.h"
+#include "timer_wheel.h"
+
+// 部屋一覧のスナップショット (公開後は書き換えない)
+typedef struct {
+    int refcount;  // 参照カウント (__atomic で操作)
+    int version;   // 作り直すたびに増える通し番号
+    int total_rooms;
+    int page_count;
+    int* page_versions;    // page_count 個。各ページの中身が最後に変わった版
+    size_t* page_offsets;  // page_count + 1 個。frames 内の各ページの開始位置
+    uint8_t* frames;       // エンコード済みの MSG_LIST_ROOMS_RESPONSE
+    RoomListEntry* entries;  // total_rooms 件 (次の作り直しでページを比べる)
+} LobbySnapshot;
+
+static LobbySnapshot* current_snapshot = NULL;
+// current_snapshot の読み出しと参照の取得だけを守る (部屋のロックとは無関係)
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static TimerEntry rebuild_timer;  // 作り直しを遅らせてまとめるためのタイマー
+static int rebuild_pending = 0;   // 1 なら作り直しを予約済み (__atomic)
+
+// --- スナップショット ---
+
+static void snapshot_release(LobbySnapshot* snap) {
+    if (__atomic_sub_fetch(&snap->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(snap->page_versions);
+        free(snap->page_offsets);
+        free(snap->frames);
+        free(snap->entries);
+        free(snap);
+    }
+}
+
+// 現在のスナップショットの参照を得る (呼び出し元で snapshot_release する)
+static LobbySnapshot* snapshot_acquire(void) {
+    pthread_mutex_lock(&snapshot_mutex);
+    LobbySnapshot* snap = current_snapshot;
+    __atomic_add_fetch(&snap->refcount, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&snapshot_mutex);
+    return snap;
+}
+
+// prev (無ければ NULL) の page ページ目と中身が同じなら、その版を返す
+// 戻り値: 異なれば -1
+static int unchanged_page_version(const LobbySnapshot* prev, int page,
+                                  const RoomListEntry* entries, int count) {
+    if (prev == NULL || page >= prev->page_count) {
+        return -1;
+    }
+    int first = page * ROOM_LIST_PAGE_SIZE;
+    int prev_count = prev->total_rooms - first;
+    if (prev_count > ROOM_LIST_PAGE_SIZE) {
+        prev_count = ROOM_LIST_PAGE_SIZE;
+    }
+    if (prev_count != count ||
+        memcmp(prev->entries + first, entries, count * sizeof(*entries)) !=
+            0) {
+        return -1;
+    }
+    return prev->page_versions[page];
+}
+
+// entries から各ページのフレームをエンコードしたスナップショットを作る
+// prev と中身が同じページは版を引き継ぎ、変わったページの版は version にする
+static LobbySnapshot* snapshot_build(int version, const LobbySnapshot* prev,
+                                     const RoomListEntry* entries, int total) {
+    int page_count = (total + ROOM_LIST_PAGE_SIZE - 1) / ROOM_LIST_PAGE_SIZE;
+    if (page_count == 0) {
+        page_count = 1;  // 部屋がなくても 0 ページ目は返す
+    }
+
+    LobbySnapshot* snap = calloc(1, sizeof(LobbySnapshot));
+    if (snap == NULL) {
+        return NULL;
+    }
+    snap->refcount = 1;  // current_snapshot としての参照
+    snap->version = version;
+    snap->total_rooms = total;
+    snap->page_count = page_count;
+    snap->page_versions = malloc(page_count * sizeof(int));
+    snap->page_offsets = malloc((page_count + 1) * sizeof(size_t));
+    snap->frames = malloc((size_t)page_count * MAX_FRAME_SIZE);
+    snap->entries = malloc((total > 0 ? total : 1) * sizeof(RoomListEntry));
+    if (snap->page_versions == NULL || snap->page_offsets == NULL ||
+        snap->frames == NULL || snap->entries == NULL) {
+        snapshot_release(snap);
+        return NULL;
+    }
+    if (total > 0) {
+        memcpy(snap->entries, entries, total * sizeof(RoomListEntry));
+    }
+
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_LIST_ROOMS_RESPONSE;
+    ListRoomsResponseData* list = &msg.data.listRoomsResp;
+    list->pageCount = page_count;
+    list->totalRooms = total;
+
+    size_t len = 0;
+    for (int page = 0; page < page_count; ++page) {
+        int first = page * ROOM_LIST_PAGE_SIZE;
+        int count = total - first;
+        if (count > ROOM_LIST_PAGE_SIZE) {
+            count = ROOM_LIST_PAGE_SIZE;
+        }
+        int page_version =
+            unchanged_page_version(prev, page, entries + first, count);
+        snap->page_versions[page] = (page_version != -1) ? page_version
+                                                         : version;
+        list->version = snap->page_versions[page];
+        list->page = page;
+        list->count = count;
+        memcpy(list->rooms, entries + first, count * sizeof(RoomListEntry));
+
+        snap->page_offsets[page] = len;
+        int n = encodeMessage(&msg, snap->frames + len, MAX_FRAME_SIZE);
+        if (n < 0) {
+            LOG_ERROR("Lobby: failed to encode room list page %d.", page);
+            snapshot_release(snap);
+            return NULL;
+        }
+        len += n;
+    }
+    snap->page_offsets[page_count] = len;
+    return snap;
+}
+
+// 新しいスナップショットに差し替える (古いものは最後の参照者が解放する)
+static void snapshot_publish(LobbySnapshot* snap) {
+    pthread_mutex_lock(&snapshot_mutex);
+    LobbySnapshot* old = current_snapshot;
+    current_snapshot = snap;
+    pthread_mutex_unlock(&snapshot_mutex);
+    if (old != NULL) {
+        snapshot_release(old);
+    }
+}
+
+// 部屋を走査してスナップショットを作り直す (タイマースレッドから呼ばれる)
+static void lobby_rebuild(int id, unsigned int seq) {
+    (void)id;
+    (void)seq;
+    // 以降の変化は次の作り直しで拾う
+    __atomic_store_n(&rebuild_pending, 0, __ATOMIC_SEQ_CST);
+
+    int slots = room_slot_count();
+    RoomListEntry* entries =
+        malloc((slots > 0 ? slots : 1) * sizeof(RoomListEntry));
+    if (entries == NULL) {
+        LOG_ERROR("Lobby: failed to allocate room list: %m");
+        return;
+    }
+    int total = collect_room_list(entries, slots);
+
+    // 作り直すのはこのスレッドだけなので、版は現在の値から進めればよい
+    LobbySnapshot* snap = snapshot_build(current_snapshot->version + 1,
+                                         current_snapshot, entries, total);
+    free(entries);
+    if (snap == NULL) {
+        LOG_ERROR("Lobby: failed to rebuild room list.");
+        lobby_mark_dirty();  // 後でやり直す
+        return;
+    }
+    snapshot_publish(snap);
+}
+
+// --- 公開関数 ---
+
+int lobby_init(void) {
+    LobbySnapshot* snap = snapshot_build(1, NULL, NULL, 0);
+    if (snap == NULL) {
+        return -1;
+    }
+    snapshot_publish(snap);
+    return 0;
+}
+
+void lobby_mark_dirty(void) {
+    // 予約済みなら何もしない (短時間の変化を1回の作り直しにまとめる)
+    if (__atomic_exchange_n(&rebuild_pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        timer_arm(&rebuild_timer, 0, LOBBY_REBUILD_DELAY_MS, lobby_rebuild);
+    }
+}
+
+void lobby_send_page(int client_sock, int page, int knownVersion) {
+    LobbySnapshot* snap = snapshot_acquire();
+    int in_range = page >= 0 && page < snap->page_count;
+    // 版はページごとに比べる (他のページの版を渡されても変化なしにしない)
+    int unchanged = in_range && knownVersion == snap->page_versions[page];
+
+    if (in_range && !unchanged) {
+        // エンコード済みのページをそのまま送る
+        size_t offset = snap->page_offsets[page];
+        send_frames_to_client(client_sock, snap->frames + offset,
+                              snap->page_offsets[page + 1] - offset, 0);
+    } else {
+        // 変化なし、または範囲外のページ: 中身のない応答を送る
+        Message msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.type = MSG_LIST_ROOMS_RESPONSE;
+        msg.data.listRoomsResp.version =
+            in_range ? snap->page_versions[page] : snap->version;
+        msg.data.listRoomsResp.unchanged = unchanged;
+        msg.data.listRoomsResp.page = page;
+        msg.data.listRoomsResp.pageCount = snap->page_count;
+        msg.data.listRoomsResp.totalRooms = snap->total_rooms;
+        msg.data.listRoomsResp.count = 0;
+        send_to_client(client_sock, &msg);
+    }
+
+    snapshot_release(snap);
+}
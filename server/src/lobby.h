@@ -0,0 +1,25 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include "server_common.h"
+
+// --- 部屋一覧 (ロビー) ---
+// 部屋一覧は不変のスナップショットとして持ち、部屋の状態が変わったときだけ
+// 作り直してポインタを差し替える。一覧要求はスナップショットを参照するだけで
+// 部屋のロックを取らない。各ページはエンコード済みのフレームで保持する。
+
+// 部屋の変化からスナップショットを作り直すまでの待ち時間 (変化をまとめる)
+#define LOBBY_REBUILD_DELAY_MS 100
+
+// 空の一覧で初期化する。戻り値: 失敗時 -1
+int lobby_init(void);
+
+// 部屋の作成・参加・状態変化・閉鎖を知らせる (room_mutex ロック中でもよい)
+// LOBBY_REBUILD_DELAY_MS 後にタイマースレッドがスナップショットを作り直す
+void lobby_mark_dirty(void);
+
+// 一覧の page ページ目を client_sock に送る
+// knownVersion がそのページの最新の版と同じなら unchanged だけの短い応答を送る
+void lobby_send_page(int client_sock, int page, int knownVersion);
+
+#endif  // LOBBY_H
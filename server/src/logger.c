@@ -0,0 +1,522 @@
+#include "logger.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_SPEC_MAX 16  // 1つの変換指定 (%-08.3lld など) の最大長
+
+// 引数の型 (後から整形するときに va_arg と同じ型で取り出す)
+enum {
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_INTMAX,
+    LOG_ARG_PTRDIFF,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,   // 長さ (2バイト) と中身を写す
+    LOG_ARG_NONE,  // %% と %m (引数を取らない)
+    LOG_ARG_BAD,   // 後から整形できない (* や %Lf など)
+};
+
+// リングの1要素
+typedef struct {
+    uint64_t ns;          // 書いた時刻 (CLOCK_REALTIME)
+    const LogSite* site;  // 書式とレベル
+    int saved_errno;      // %m 用
+    int len;              // data の使った長さ
+    // 引数の値を順に詰めたもの (site->state が 2 なら整形済みの文字列)
+    unsigned char data[LOG_RECORD_DATA];
+} LogRecord;
+
+// スレッドごとのリング。head は持ち主だけが、tail は出力側だけが進める
+// 確保したら解放しない (スレッドはサーバーと同じ寿命)
+typedef struct LogRing {
+    LogRecord slots[LOG_RING_SLOTS];
+    uint32_t head;           // 次に書く位置
+    unsigned long dropped;   // 一杯で捨てた数 (持ち主だけが書く)
+    uint32_t tail __attribute__((aligned(64)));  // 次に読む位置
+    uint32_t drain_head;     // 出力側が今回の取り出しで読む上限
+    int thread_no;           // 出力に付ける番号 (登録順)
+    struct LogRing* next;
+} LogRing;
+
+int log_level = LOG_LEVEL_INFO;
+
+static __thread LogRing* local_ring = NULL;
+static LogRing* rings = NULL;  // 全スレッドのリング (先頭に追加する)
+static int ring_count = 0;
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 取り出すのは出力スレッドか log_flush のどちらか一方だけ
+static pthread_mutex_t drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int running = 0;  // 出力スレッドが動いていれば 1
+static unsigned long reported_dropped = 0;  // 警告を出し終えた捨てた数
+
+static const char* const level_names[] = {
+    [LOG_LEVEL_DEBUG] = "DEBUG",
+    [LOG_LEVEL_INFO] = "INFO",
+    [LOG_LEVEL_WARN] = "WARN",
+    [LOG_LEVEL_ERROR] = "ERROR",
+};
+
+int log_level_from_name(const char* name) {
+    static const char* const names[] = {"debug", "info", "warn", "error"};
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); ++i) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 呼び出したスレッドのリング (最初の1回だけ確保して登録する)
+static LogRing* get_ring(void) {
+    if (local_ring == NULL) {
+        LogRing* ring = calloc(1, sizeof(LogRing));
+        if (ring == NULL) {
+            return NULL;  // その場で書く側に回る
+        }
+        pthread_mutex_lock(&rings_mutex);
+        ring->thread_no = ring_count++;
+        ring->next = rings;
+        __atomic_store_n(&rings, ring, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&rings_mutex);
+        local_ring = ring;
+    }
+    return local_ring;
+}
+
+// 末尾の改行を除いた長さ
+static int trim_newlines(const char* text, int len) {
+    while (len > 0 && text[len - 1] == '\n') {
+        --len;
+    }
+    return len;
+}
+
+// fmt を size バイトの text に整形する。戻り値: 書いた長さ
+static int format_text(char* text, int size, const char* fmt, va_list ap) {
+    int len = vsnprintf(text, size, fmt, ap);
+    if (len < 0) {
+        len = 0;
+        text[0] = '\0';
+    } else if (len >= size) {
+        len = size - 1;  // 切り捨て
+    }
+    return trim_newlines(text, len);
+}
+
+// fmt の '%' から変換指定を1つ読み、spec に写して引数の型を *type に返す
+// 戻り値: 変換指定の次の位置
+static const char* parse_spec(const char* p, char* spec, int* type) {
+    const char* start = p++;
+    p += strspn(p, "-+ #0");
+    p += strspn(p, "0123456789");
+    if (*p == '.') {
+        ++p;
+        p += strspn(p, "0123456789");
+    }
+    int arg = LOG_ARG_INT;
+    int wide = 0;  // l や L などで int 以外の大きさを指定した
+    if (*p == 'h') {
+        p += (p[1] == 'h') ? 2 : 1;  // int に格上げされて渡る
+    } else if (*p == 'l') {
+        arg = (p[1] == 'l') ? LOG_ARG_LLONG : LOG_ARG_LONG;
+        p += (p[1] == 'l') ? 2 : 1;
+        wide = 1;
+    } else if (*p == 'z' || *p == 'j' || *p == 't' || *p == 'L') {
+        arg = (*p == 'z')   ? LOG_ARG_SIZE
+              : (*p == 'j') ? LOG_ARG_INTMAX
+              : (*p == 't') ? LOG_ARG_PTRDIFF
+                            : LOG_ARG_BAD;
+        ++p;
+        wide = 1;
+    }
+    char conv = *p;
+    if (conv != '\0') {
+        ++p;
+    }
+    switch (conv) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            *type = arg;
+            break;
+        case 'c':
+            *type = wide ? LOG_ARG_BAD : LOG_ARG_INT;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            *type = (arg == LOG_ARG_BAD) ? LOG_ARG_BAD : LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            *type = wide ? LOG_ARG_BAD : LOG_ARG_STR;
+            break;
+        case 'p':
+            *type = LOG_ARG_PTR;
+            break;
+        case 'm':
+        case '%':
+            *type = LOG_ARG_NONE;
+            break;
+        default:
+            *type = LOG_ARG_BAD;  // * による幅の指定など
+            break;
+    }
+    size_t n = p - start;
+    if (n >= LOG_SPEC_MAX) {
+        *type = LOG_ARG_BAD;
+        n = 0;
+    }
+    memcpy(spec, start, n);
+    spec[n] = '\0';
+    return p;
+}
+
+// 呼び出し箇所の書式を解析して引数の型を覚える (箇所ごとに最初の1回だけ)
+// 戻り値: site->state
+static int parse_site(LogSite* site) {
+    static pthread_mutex_t parse_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock(&parse_mutex);
+    int state = site->state;
+    if (state == 0) {
+        char spec[LOG_SPEC_MAX];
+        int count = 0;
+        int fixed = 0;
+        state = 1;
+        for (const char* f = site->fmt; *f != '\0';) {
+            if (*f != '%') {
+                ++f;
+                continue;
+            }
+            int type;
+            f = parse_spec(f, spec, &type);
+            if (type == LOG_ARG_NONE) {
+                continue;
+            }
+            if (type == LOG_ARG_BAD || count == LOG_MAX_ARGS) {
+                state = 2;  // 後から整形できないので、その場で整形する
+                break;
+            }
+            site->arg_types[count++] = type;
+            fixed += (type == LOG_ARG_STR) ? 2 : 8;
+        }
+        site->arg_count = count;
+        site->fixed_size = fixed;
+        if (fixed > LOG_RECORD_DATA) {
+            state = 2;
+        }
+        __atomic_store_n(&site->state, state, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&parse_mutex);
+    return state;
+}
+
+// 引数の値を data に詰める。文字列は残りの領域に収まるだけ写す
+// 戻り値: 使った長さ
+static int pack_args(const LogSite* site, unsigned char* data, va_list ap) {
+    unsigned char* p = data;
+    size_t budget = LOG_RECORD_DATA - site->fixed_size;  // 文字列に使える分
+    for (int i = 0; i < site->arg_count; ++i) {
+        uint64_t v;
+        switch (site->arg_types[i]) {
+            case LOG_ARG_INT:
+                v = (uint64_t)(int64_t)va_arg(ap, int);
+                break;
+            case LOG_ARG_LONG:
+                v = (uint64_t)(int64_t)va_arg(ap, long);
+                break;
+            case LOG_ARG_LLONG:
+                v = (uint64_t)va_arg(ap, long long);
+                break;
+            case LOG_ARG_SIZE:
+                v = va_arg(ap, size_t);
+                break;
+            case LOG_ARG_INTMAX:
+                v = (uint64_t)va_arg(ap, intmax_t);
+                break;
+            case LOG_ARG_PTRDIFF:
+                v = (uint64_t)va_arg(ap, ptrdiff_t);
+                break;
+            case LOG_ARG_DOUBLE: {
+                double d = va_arg(ap, double);
+                memcpy(&v, &d, sizeof(v));
+                break;
+            }
+            case LOG_ARG_PTR:
+                v = (uint64_t)(uintptr_t)va_arg(ap, void*);
+                break;
+            default: {  // LOG_ARG_STR
+                const char* str = va_arg(ap, const char*);
+                if (str == NULL) {
+                    str = "(null)";
+                }
+                uint16_t n = (uint16_t)strnlen(str, budget);
+                memcpy(p, &n, sizeof(n));
+                memcpy(p + sizeof(n), str, n);
+                p += sizeof(n) + n;
+                budget -= n;
+                continue;
+            }
+        }
+        memcpy(p, &v, sizeof(v));
+        p += sizeof(v);
+    }
+    return (int)(p - data);
+}
+
+// 記録を out (LOG_LINE_MAX バイト) に整形する (出力スレッドから呼ぶ)
+// 戻り値: 書いた長さ
+static int format_record(const LogRecord* rec, char* out) {
+    const LogSite* site = rec->site;
+    if (site->state == 2) {
+        memcpy(out, rec->data, rec->len);
+        return rec->len;
+    }
+    const unsigned char* p = rec->data;
+    char spec[LOG_SPEC_MAX];
+    char str[LOG_RECORD_DATA + 1];
+    int len = 0;
+    for (const char* f = site->fmt; *f != '\0' && len < LOG_LINE_MAX - 1;) {
+        if (*f != '%') {
+            out[len++] = *f++;
+            continue;
+        }
+        int type;
+        f = parse_spec(f, spec, &type);
+        char* dst = out + len;
+        size_t room = LOG_LINE_MAX - len;
+        uint64_t v = 0;
+        if (type != LOG_ARG_NONE && type != LOG_ARG_STR) {
+            memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+        }
+        int n = 0;
+        switch (type) {
+            case LOG_ARG_NONE:
+                if (spec[strlen(spec) - 1] == 'm') {
+                    errno = rec->saved_errno;
+                    n = snprintf(dst, room, "%m");
+                } else {
+                    n = snprintf(dst, room, "%%");
+                }
+                break;
+            case LOG_ARG_INT:
+                n = snprintf(dst, room, spec, (int)v);
+                break;
+            case LOG_ARG_LONG:
+                n = snprintf(dst, room, spec, (long)v);
+                break;
+            case LOG_ARG_LLONG:
+                n = snprintf(dst, room, spec, (long long)v);
+                break;
+            case LOG_ARG_SIZE:
+                n = snprintf(dst, room, spec, (size_t)v);
+                break;
+            case LOG_ARG_INTMAX:
+                n = snprintf(dst, room, spec, (intmax_t)v);
+                break;
+            case LOG_ARG_PTRDIFF:
+                n = snprintf(dst, room, spec, (ptrdiff_t)v);
+                break;
+            case LOG_ARG_DOUBLE: {
+                double d;
+                memcpy(&d, &v, sizeof(d));
+                n = snprintf(dst, room, spec, d);
+                break;
+            }
+            case LOG_ARG_PTR:
+                n = snprintf(dst, room, spec, (void*)(uintptr_t)v);
+                break;
+            case LOG_ARG_STR: {
+                uint16_t size;
+                memcpy(&size, p, sizeof(size));
+                memcpy(str, p + sizeof(size), size);
+                str[size] = '\0';
+                p += sizeof(size) + size;
+                n = snprintf(dst, room, spec, str);
+                break;
+            }
+        }
+        if (n > 0) {
+            len += ((size_t)n < room) ? n : (int)room - 1;
+        }
+    }
+    out[len] = '\0';
+    return trim_newlines(out, len);
+}
+
+static FILE* stream_for(int level) {
+    return level >= LOG_LEVEL_WARN ? stderr : stdout;
+}
+
+void log_write(LogSite* site, ...) {
+    int saved_errno = errno;
+    va_list ap;
+    LogRing* ring =
+        __atomic_load_n(&running, __ATOMIC_ACQUIRE) ? get_ring() : NULL;
+    if (ring == NULL) {
+        // 出力スレッドが無い (起動前・ツール): 従来どおりその場で書く
+        char text[LOG_LINE_MAX];
+        errno = saved_errno;
+        va_start(ap, site);
+        int len = format_text(text, sizeof(text), site->fmt, ap);
+        va_end(ap);
+        fprintf(stream_for(site->level), "%.*s\n", len, text);
+        return;
+    }
+    int state = __atomic_load_n(&site->state, __ATOMIC_ACQUIRE);
+    if (state == 0) {
+        state = parse_site(site);
+    }
+
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) ==
+        LOG_RING_SLOTS) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;  // 一杯なら待たずに捨てる
+    }
+    LogRecord* rec = &ring->slots[head & (LOG_RING_SLOTS - 1)];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    rec->site = site;
+    rec->saved_errno = saved_errno;
+    va_start(ap, site);
+    if (state == 1) {
+        rec->len = pack_args(site, rec->data, ap);
+    } else {
+        errno = saved_errno;
+        rec->len =
+            format_text((char*)rec->data, LOG_RECORD_DATA, site->fmt, ap);
+    }
+    va_end(ap);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// "2026-01-02 03:04:05.678901 INFO  [2] メッセージ" の形で1行書く
+static void write_record(const LogRecord* rec, int thread_no) {
+    static time_t cached_sec = -1;  // 日時の文字列は秒が変わったときだけ作る
+    static char cached_time[32];
+    static char text[LOG_LINE_MAX];
+    time_t sec = (time_t)(rec->ns / 1000000000ULL);
+    if (sec != cached_sec) {
+        struct tm tm;
+        localtime_r(&sec, &tm);
+        strftime(cached_time, sizeof(cached_time), "%Y-%m-%d %H:%M:%S", &tm);
+        cached_sec = sec;
+    }
+    int len = format_record(rec, text);
+    fprintf(stream_for(rec->site->level), "%s.%06lu %-5s [%d] %.*s\n",
+            cached_time, (unsigned long)(rec->ns % 1000000000ULL / 1000),
+            level_names[rec->site->level], thread_no, len, text);
+}
+
+// 全リングの溜まっている分を時刻順に書き出す (drain_mutex を取って呼ぶ)
+// 戻り値: 書いたメッセージの数
+static int drain_locked(void) {
+    LogRing* first = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+    unsigned long dropped = 0;
+    for (LogRing* r = first; r != NULL; r = r->next) {
+        r->drain_head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        dropped += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+    }
+
+    int written = 0;
+    for (;;) {
+        // 各リングの先頭のうち最も古いものを選ぶ (リングの数はスレッド数)
+        LogRing* oldest = NULL;
+        const LogRecord* oldest_rec = NULL;
+        for (LogRing* r = first; r != NULL; r = r->next) {
+            if (r->tail == r->drain_head) {
+                continue;
+            }
+            const LogRecord* rec = &r->slots[r->tail & (LOG_RING_SLOTS - 1)];
+            if (oldest == NULL || rec->ns < oldest_rec->ns) {
+                oldest = r;
+                oldest_rec = rec;
+            }
+        }
+        if (oldest == NULL) {
+            break;
+        }
+        write_record(oldest_rec, oldest->thread_no);
+        __atomic_store_n(&oldest->tail, oldest->tail + 1, __ATOMIC_RELEASE);
+        ++written;
+    }
+
+    if (dropped > reported_dropped) {
+        fprintf(stderr, "Log: dropped %lu message(s) (ring buffer full).\n",
+                dropped - reported_dropped);
+        reported_dropped = dropped;
+        ++written;
+    }
+    if (written > 0) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+    return written;
+}
+
+static void* log_drain_thread(void* arg) {
+    (void)arg;
+    const struct timespec interval = {0, LOG_DRAIN_INTERVAL_MS * 1000000L};
+    for (;;) {
+        pthread_mutex_lock(&drain_mutex);
+        int written = drain_locked();
+        pthread_mutex_unlock(&drain_mutex);
+        if (written == 0) {
+            nanosleep(&interval, NULL);
+        }
+    }
+    return NULL;
+}
+
+void log_flush(void) {
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        fflush(stdout);
+        return;
+    }
+    pthread_mutex_lock(&drain_mutex);
+    while (drain_locked() > 0) {
+    }
+    pthread_mutex_unlock(&drain_mutex);
+}
+
+unsigned long log_dropped_count(void) {
+    unsigned long dropped = 0;
+    for (LogRing* r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL;
+         r = r->next) {
+        dropped += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+    }
+    return dropped;
+}
+
+int log_start(void) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, log_drain_thread, NULL) != 0) {
+        perror("Failed to create log thread");
+        return -1;
+    }
+    pthread_detach(thread);
+    atexit(log_flush);
+    __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+// --- 非同期ロガー ---
+// LOG_INFO などは、呼び出したスレッドのリングバッファ (最初に書いたときに
+// 確保) に時刻と引数の値をそのまま詰めるだけで返る。書式文字列は
+// 呼び出し箇所ごとに最初の1回だけ解析し、文字列への整形は出力スレッドが
+// 行う。ロックもシステムコールも使わない。
+// 出力スレッドは全スレッドのリングを時刻順にまとめて取り出し、
+// DEBUG/INFO は標準出力、WARN/ERROR は標準エラーに書く。
+// リングが一杯のときは待たずに捨てて数える (着手の処理を止めない)。
+// log_start を呼ぶ前 (ツールなど) は呼び出したスレッドでそのまま書く。
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+// これより低いレベルの呼び出しはコンパイル時に取り除く
+// (make LOG_MIN_LEVEL=1 で DEBUG を消す)
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_MAX_ARGS 12  // 後から整形できる引数の数 (超えたらその場で整形)
+#define LOG_RECORD_DATA 232  // 1メッセージの引数 (または整形済みの文字列)
+#define LOG_LINE_MAX 512     // 整形した1メッセージの最大長 (超えたら切り捨て)
+#define LOG_RING_SLOTS 1024  // スレッドごとのリングの大きさ (2 の冪)
+#define LOG_DRAIN_INTERVAL_MS 5  // 出すものが無いときに出力スレッドが眠る時間
+
+// 呼び出し箇所ごとの情報 (LOG_AT が static に置く)
+typedef struct {
+    const char* fmt;
+    int level;
+    int state;       // 0: 未解析, 1: 後から整形, 2: その場で整形
+    int arg_count;   // 引数の数
+    int fixed_size;  // 文字列以外の引数が使う領域の大きさ
+    unsigned char arg_types[LOG_MAX_ARGS];
+} LogSite;
+
+// 実行時のレベル (これより低いものは記録もしない)。起動時にだけ変える
+extern int log_level;
+
+// 1メッセージを書く (末尾の改行は付けない。%m で errno の説明を書ける)
+void log_write(LogSite* site, ...);
+
+// 書式と引数の型を printf と同じようにコンパイラに確かめさせる (呼ばない)
+static inline __attribute__((format(printf, 1, 2))) void log_check_format(
+    const char* fmt, ...) {
+    (void)fmt;
+}
+
+// 実行時のレベルを確かめてから、呼び出し箇所の情報と引数を渡す
+#define LOG_AT(lvl, fmt, ...)                                        \
+    do {                                                             \
+        if ((lvl) >= log_level) {                                    \
+            static LogSite log_site_ = {(fmt), (lvl), 0, 0, 0, {0}}; \
+            if (0) {                                                 \
+                log_check_format((fmt), ##__VA_ARGS__);              \
+            }                                                        \
+            log_write(&log_site_, ##__VA_ARGS__);                    \
+        }                                                            \
+    } while (0)
+
+// LOG_MIN_LEVEL 未満のレベル: 書式の確認だけ残し、コードも文字列も出さない
+#define LOG_DISCARD(fmt, ...)                       \
+    do {                                            \
+        if (0) {                                    \
+            log_check_format((fmt), ##__VA_ARGS__); \
+        }                                           \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)  // 常に残す
+
+// "debug"・"info"・"warn"・"error" をレベルに変換する。戻り値: 不明なら -1
+int log_level_from_name(const char* name);
+
+// 出力スレッドを起動する。SIGUSR1 を止めた後 (metrics_start の後) に呼ぶ
+// 戻り値: 失敗時 -1
+int log_start(void);
+
+// リングに残っているメッセージをすべて書き出す (exit 時にも呼ばれる)
+void log_flush(void);
+
+// リングが一杯で捨てたメッセージの数 (全スレッドの合計)
+unsigned long log_dropped_count(void);
+
+#endif  // LOGGER_H
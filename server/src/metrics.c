@@ -0,0 +1,212 @@
+#include "metrics.h"
+
+#include <inttypes.h>
+#include <signal.h>
+
+#include "logger.h"
+
+// スレッドごとの計測値。確保したら解放しない (スレッドはサーバーと同じ寿命)
+typedef struct MetricsShard {
+    MetricsSnapshot values;
+    struct MetricsShard* next;
+} MetricsShard;
+
+static __thread MetricsShard* local_shard = NULL;
+static MetricsShard* shards = NULL;  // 全スレッドの領域 (先頭に追加する)
+static pthread_mutex_t shards_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* const counter_names[METRIC_COUNTER_COUNT] = {
+    [METRIC_BYTES_IN] = "bytes_in",
+    [METRIC_BYTES_OUT] = "bytes_out",
+    [METRIC_CONNECTS] = "connects",
+    [METRIC_DISCONNECTS] = "disconnects",
+    [METRIC_INVALID_MOVES] = "invalid_moves",
+    [METRIC_PASSES] = "passes",
+    [METRIC_MOVES] = "moves",
+    [METRIC_GAMES_FINISHED] = "games_finished",
+};
+
+static const char* const lock_names[METRIC_LOCK_COUNT] = {
+    [METRIC_LOCK_ROOM] = "room",
+    [METRIC_LOCK_ROOMS] = "rooms",
+    [METRIC_LOCK_CLIENTS] = "clients",
+};
+
+static const char* const message_names[METRICS_MSG_SLOTS] = {
+    [MSG_CREATE_ROOM_REQUEST] = "create_room",
+    [MSG_JOIN_ROOM_REQUEST] = "join_room",
+    [MSG_LIST_ROOMS_REQUEST] = "list_rooms",
+    [MSG_START_GAME_REQUEST] = "start_game",
+    [MSG_PLACE_PIECE_REQUEST] = "place_piece",
+    [MSG_REMATCH_REQUEST] = "rematch",
+    [MSG_CHAT_MESSAGE_SEND_REQUEST] = "chat",
+    [MSG_BOARD_SYNC_REQUEST] = "board_sync",
+    [MSG_ADD_AI_REQUEST] = "add_ai",
+    [MSG_ANALYZE_GAME_REQUEST] = "analyze_game",
+    [MSG_RESUME_REQUEST] = "resume",
+    [METRICS_MSG_SLOTS - 1] = "unknown",
+};
+
+// 呼び出したスレッドの領域 (最初の1回だけ確保して登録する)
+static MetricsShard* get_shard(void) {
+    if (local_shard == NULL) {
+        MetricsShard* shard = calloc(1, sizeof(MetricsShard));
+        if (shard == NULL) {
+            return NULL;  // 記録を諦める (サーバーは止めない)
+        }
+        pthread_mutex_lock(&shards_mutex);
+        shard->next = shards;
+        __atomic_store_n(&shards, shard, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&shards_mutex);
+        local_shard = shard;
+    }
+    return local_shard;
+}
+
+// 持ち主のスレッドだけが書くので、読んで足して書くだけでよい
+// (読む側が途中の値を見ないよう、書き込みは __atomic で1語ずつ)
+static inline void bump(uint64_t* value, uint64_t n) {
+    __atomic_store_n(value, *value + n, __ATOMIC_RELAXED);
+}
+
+void metrics_add(MetricCounter counter, uint64_t n) {
+    MetricsShard* shard = get_shard();
+    if (shard != NULL) {
+        bump(&shard->values.counters[counter], n);
+    }
+}
+
+void metrics_record_handler(int type, uint64_t ns) {
+    MetricsShard* shard = get_shard();
+    if (shard == NULL) {
+        return;
+    }
+    int slot = (type >= 0 && type < METRICS_MSG_SLOTS - 1)
+                   ? type
+                   : METRICS_MSG_SLOTS - 1;
+    bump(&shard->values.handled[slot], 1);
+    bump(&shard->values.total_ns[slot], ns);
+    bump(&shard->values.hist[slot][hist_bucket(ns)], 1);
+}
+
+void metrics_record_lock_wait(MetricLock lock, uint64_t ns) {
+    MetricsShard* shard = get_shard();
+    if (shard == NULL) {
+        return;
+    }
+    bump(&shard->values.lock_acquired[lock], 1);
+    if (ns > 0) {
+        bump(&shard->values.lock_contended[lock], 1);
+        bump(&shard->values.lock_wait_ns[lock], ns);
+    }
+    bump(&shard->values.lock_hist[lock][hist_bucket(ns)], 1);
+}
+
+static void add_words(uint64_t* dst, const uint64_t* src, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+void metrics_collect(MetricsSnapshot* out) {
+    memset(out, 0, sizeof(*out));
+    // 領域は先頭にしか追加されず解放もされないので、ロックなしでたどれる
+    for (MetricsShard* shard = __atomic_load_n(&shards, __ATOMIC_ACQUIRE);
+         shard != NULL; shard = shard->next) {
+        add_words(out->counters, shard->values.counters,
+                  METRIC_COUNTER_COUNT);
+        add_words(out->handled, shard->values.handled, METRICS_MSG_SLOTS);
+        add_words(out->total_ns, shard->values.total_ns, METRICS_MSG_SLOTS);
+        add_words(&out->hist[0][0], &shard->values.hist[0][0],
+                  (size_t)METRICS_MSG_SLOTS * HIST_BUCKETS);
+        add_words(out->lock_acquired, shard->values.lock_acquired,
+                  METRIC_LOCK_COUNT);
+        add_words(out->lock_contended, shard->values.lock_contended,
+                  METRIC_LOCK_COUNT);
+        add_words(out->lock_wait_ns, shard->values.lock_wait_ns,
+                  METRIC_LOCK_COUNT);
+        add_words(&out->lock_hist[0][0], &shard->values.lock_hist[0][0],
+                  (size_t)METRIC_LOCK_COUNT * HIST_BUCKETS);
+    }
+}
+
+const char* metrics_counter_name(MetricCounter counter) {
+    return counter_names[counter];
+}
+
+const char* metrics_message_name(int slot) {
+    const char* name = message_names[slot];
+    return name != NULL ? name : "other";  // サーバーが受け取らないタイプ
+}
+
+const char* metrics_lock_name(MetricLock lock) { return lock_names[lock]; }
+
+void metrics_dump(FILE* fp) {
+    static MetricsSnapshot snap;  // ダンプは専用スレッドからしか呼ばない
+    metrics_collect(&snap);
+
+    flockfile(fp);  // 表の途中にログの行が混ざらないようにする
+    fprintf(fp, "--- metrics ---\n");
+    for (int c = 0; c < METRIC_COUNTER_COUNT; ++c) {
+        fprintf(fp, "%-14s %" PRIu64 "\n", metrics_counter_name(c),
+                snap.counters[c]);
+    }
+    fprintf(fp, "%-14s %10s %12s %10s %10s %10s %10s (us)\n", "message",
+            "count", "total_ms", "p50", "p99", "p999", "max");
+    for (int slot = 0; slot < METRICS_MSG_SLOTS; ++slot) {
+        uint64_t n = snap.handled[slot];
+        if (n == 0) {
+            continue;
+        }
+        const uint64_t* hist = snap.hist[slot];
+        fprintf(fp, "%-14s %10" PRIu64 " %12.1f %10.1f %10.1f %10.1f %10.1f\n",
+                metrics_message_name(slot), n, snap.total_ns[slot] / 1e6,
+                hist_percentile(hist, n, 0.50) / 1e3,
+                hist_percentile(hist, n, 0.99) / 1e3,
+                hist_percentile(hist, n, 0.999) / 1e3, hist_max(hist) / 1e3);
+    }
+    fprintf(fp, "%-14s %10s %12s %10s %10s %10s %10s (us)\n", "lock",
+            "acquired", "contended", "wait_ms", "p99", "p999", "max");
+    for (int lock = 0; lock < METRIC_LOCK_COUNT; ++lock) {
+        uint64_t n = snap.lock_acquired[lock];
+        const uint64_t* hist = snap.lock_hist[lock];
+        fprintf(fp,
+                "%-14s %10" PRIu64 " %12" PRIu64
+                " %10.1f %10.1f %10.1f %10.1f\n",
+                metrics_lock_name(lock), n, snap.lock_contended[lock],
+                snap.lock_wait_ns[lock] / 1e6,
+                hist_percentile(hist, n, 0.99) / 1e3,
+                hist_percentile(hist, n, 0.999) / 1e3, hist_max(hist) / 1e3);
+    }
+    fflush(fp);
+    funlockfile(fp);
+}
+
+static void* metrics_dump_thread(void* arg) {
+    sigset_t* set = arg;
+    for (;;) {
+        int sig;
+        if (sigwait(set, &sig) == 0 && sig == SIGUSR1) {
+            metrics_dump(stdout);
+        }
+    }
+    return NULL;
+}
+
+int metrics_start(void) {
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    // 以降に作るスレッドはこのマスクを引き継ぎ、SIGUSR1 は sigwait だけが
+    // 受け取る (シグナルハンドラの中で printf しないで済む)
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+        return -1;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, metrics_dump_thread, &set) != 0) {
+        LOG_ERROR("Failed to create metrics thread: %m");
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "histogram.h"
+#include "server_common.h"
+
+// --- サーバーの計測値 ---
+// メッセージタイプごとのハンドラ処理時間・ロックの待ち時間の
+// ヒストグラムと、各種カウンタ。
+// 値はスレッドごとの領域 (最初に記録したときに確保) に持ち主のスレッド
+// だけが書くため、記録にロックも不可分な加算も要らない。読む側は
+// metrics_collect で全スレッドの領域を __atomic で読んで合算する。
+
+// カウンタの種類
+typedef enum {
+    METRIC_BYTES_IN,       // 受信したバイト数
+    METRIC_BYTES_OUT,      // 送信したバイト数
+    METRIC_CONNECTS,       // 受け付けた接続
+    METRIC_DISCONNECTS,    // 切断 (クライアント側・サーバー側とも)
+    METRIC_INVALID_MOVES,  // MSG_INVALID_MOVE_NOTICE を返した着手
+    METRIC_PASSES,         // 合法手が無く手番を飛ばした回数
+    METRIC_MOVES,          // 盤面に反映した着手 (AI を含む)
+    METRIC_GAMES_FINISHED,  // 終局した対局 (時間切れ・切断を含む)
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+// 待ち時間を測るロックの種類
+typedef enum {
+    METRIC_LOCK_ROOM,     // 部屋ごとの room_mutex
+    METRIC_LOCK_ROOMS,    // 部屋の空きリストの rooms_mutex
+    METRIC_LOCK_CLIENTS,  // クライアント一覧の clients_mutex
+    METRIC_LOCK_COUNT
+} MetricLock;
+
+// ヒストグラムを持つメッセージタイプの数。範囲外のタイプは最後にまとめる
+#define METRICS_MSG_SLOTS (MSG_RESUME_RESPONSE + 2)
+
+// 全スレッドを合算した計測値 (大きいので静的領域かヒープに置く)
+typedef struct {
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    uint64_t handled[METRICS_MSG_SLOTS];   // 処理したメッセージ数
+    uint64_t total_ns[METRICS_MSG_SLOTS];  // 処理時間の合計
+    uint64_t hist[METRICS_MSG_SLOTS][HIST_BUCKETS];  // 処理時間 (ns)
+    uint64_t lock_acquired[METRIC_LOCK_COUNT];   // ロックを取った回数
+    uint64_t lock_contended[METRIC_LOCK_COUNT];  // そのうち待たされた回数
+    uint64_t lock_wait_ns[METRIC_LOCK_COUNT];    // 待ち時間の合計
+    uint64_t lock_hist[METRIC_LOCK_COUNT][HIST_BUCKETS];  // 待ち時間 (ns)
+} MetricsSnapshot;
+
+// カウンタに n を足す
+void metrics_add(MetricCounter counter, uint64_t n);
+
+// type のメッセージの処理に ns ナノ秒かかったことを記録する
+void metrics_record_handler(int type, uint64_t ns);
+
+// lock を取るのに ns ナノ秒待ったことを記録する (待たなければ 0)
+void metrics_record_lock_wait(MetricLock lock, uint64_t ns);
+
+// mutex をロックし、待ち時間を記録する
+// 空いていれば trylock で取れるので、時刻を読むのは待たされたときだけ
+static inline void metrics_lock(pthread_mutex_t* mutex, MetricLock lock) {
+    if (pthread_mutex_trylock(mutex) == 0) {
+        metrics_record_lock_wait(lock, 0);
+        return;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(mutex);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    metrics_record_lock_wait(
+        lock, (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL +
+                  (end.tv_nsec - start.tv_nsec));
+}
+
+// 全スレッドの値を合算して out に書く (記録を止めずに読める)
+void metrics_collect(MetricsSnapshot* out);
+
+// カウンタ名・メッセージタイプ名・ロック名 (表示用)
+const char* metrics_counter_name(MetricCounter counter);
+const char* metrics_message_name(int slot);
+const char* metrics_lock_name(MetricLock lock);
+
+// 合算した値を表にして fp に書き出す
+void metrics_dump(FILE* fp);
+
+// SIGUSR1 を受けると metrics_dump(stdout) するスレッドを起動する
+// SIGUSR1 は全スレッドで止める必要があるので、他のスレッドを作る前に呼ぶ
+// 戻り値: 失敗時 -1
+int metrics_start(void);
+
+#endif  // METRICS_H
@@ -0,0 +1,267 @@
+#define _GNU_SOURCE  // accept4
+#include "metrics_http.h"
+
+#include <inttypes.h>
+
+#include "ai_worker.h"
+#include "game_log.h"
+#include "logger.h"
+#include "metrics.h"
+#include "room_management.h"
+
+#define METRICS_REQUEST_MAX 2048   // 読むリクエストの大きさの上限
+#define METRICS_READ_TIMEOUT_SEC 2  // リクエストを待つ時間
+
+// ヒストグラムを出力するときの境界 (秒)。細かいバケットをこの境界に丸める
+static const double histogram_bounds[] = {
+    1e-6,   2.5e-6, 5e-6,   1e-5,   2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4,
+    1e-3,   2.5e-3, 5e-3,   1e-2,   2.5e-2, 5e-2, 0.1,  0.25,   0.5,
+    1.0,    2.5,    5.0,    10.0};
+#define HISTOGRAM_BOUND_COUNT \
+    ((int)(sizeof(histogram_bounds) / sizeof(histogram_bounds[0])))
+
+static const char* const room_status_names[ROOM_SUSPENDED + 1] = {
+    [ROOM_EMPTY] = "empty",         [ROOM_WAITING] = "waiting",
+    [ROOM_PLAYING] = "playing",     [ROOM_GAMEOVER] = "gameover",
+    [ROOM_REMATCHING] = "rematching", [ROOM_SUSPENDED] = "suspended",
+};
+
+static int listen_fd = -1;
+static pthread_t http_thread_id;
+static MetricsSnapshot snap;  // 応答スレッド専用
+
+static void write_header(FILE* out, const char* name, const char* type,
+                         const char* help) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// ナノ秒のヒストグラムを Prometheus の histogram (秒、累積) として書く
+// バケットの上限が境界以下のものだけを数えるので、各境界の値は控えめになる
+static void write_histogram(FILE* out, const char* name, const char* label,
+                            const char* value, const uint64_t* hist,
+                            uint64_t count, uint64_t sum_ns) {
+    uint64_t cumulative = 0;
+    int b = 0;
+    for (int i = 0; i < HISTOGRAM_BOUND_COUNT; ++i) {
+        uint64_t bound_ns = (uint64_t)(histogram_bounds[i] * 1e9);
+        while (b < HIST_BUCKETS && hist_bucket_high(b) <= bound_ns) {
+            cumulative += hist[b++];
+        }
+        fprintf(out, "%s_bucket{%s=\"%s\",le=\"%g\"} %" PRIu64 "\n", name,
+                label, value, histogram_bounds[i], cumulative);
+    }
+    fprintf(out, "%s_bucket{%s=\"%s\",le=\"+Inf\"} %" PRIu64 "\n", name,
+            label, value, count);
+    fprintf(out, "%s_sum{%s=\"%s\"} %.9f\n", name, label, value,
+            sum_ns / 1e9);
+    fprintf(out, "%s_count{%s=\"%s\"} %" PRIu64 "\n", name, label, value,
+            count);
+}
+
+static void write_counter(FILE* out, const char* name, const char* help,
+                          uint64_t value) {
+    write_header(out, name, "counter", help);
+    fprintf(out, "%s %" PRIu64 "\n", name, value);
+}
+
+static void write_gauge(FILE* out, const char* name, const char* help,
+                        long value) {
+    write_header(out, name, "gauge", help);
+    fprintf(out, "%s %ld\n", name, value);
+}
+
+// 応答の本文を作る
+static void write_metrics(FILE* out) {
+    metrics_collect(&snap);
+    const uint64_t* c = snap.counters;
+
+    write_gauge(out, "othello_connections_active", "Open client connections.",
+                (long)(c[METRIC_CONNECTS] - c[METRIC_DISCONNECTS]));
+
+    int rooms[ROOM_SUSPENDED + 1];
+    count_rooms_by_status(rooms);
+    int used = 0;
+    for (int s = ROOM_EMPTY + 1; s <= ROOM_SUSPENDED; ++s) {
+        used += rooms[s];
+    }
+    rooms[ROOM_EMPTY] = room_capacity - used;  // 空き (未確保のスロットを含む)
+    write_header(out, "othello_rooms", "gauge", "Rooms by status.");
+    for (int s = 0; s <= ROOM_SUSPENDED; ++s) {
+        fprintf(out, "othello_rooms{status=\"%s\"} %d\n", room_status_names[s],
+                rooms[s]);
+    }
+
+    write_counter(out, "othello_connects_total", "Accepted connections.",
+                  c[METRIC_CONNECTS]);
+    write_counter(out, "othello_disconnects_total", "Closed connections.",
+                  c[METRIC_DISCONNECTS]);
+    write_counter(out, "othello_bytes_in_total", "Bytes received.",
+                  c[METRIC_BYTES_IN]);
+    write_counter(out, "othello_bytes_out_total", "Bytes sent.",
+                  c[METRIC_BYTES_OUT]);
+    write_counter(out, "othello_moves_total",
+                  "Moves applied, including AI moves.", c[METRIC_MOVES]);
+    write_counter(out, "othello_games_finished_total",
+                  "Games finished, including timeouts and disconnects.",
+                  c[METRIC_GAMES_FINISHED]);
+    write_counter(out, "othello_invalid_moves_total", "Rejected moves.",
+                  c[METRIC_INVALID_MOVES]);
+    write_counter(out, "othello_passes_total", "Turns passed.",
+                  c[METRIC_PASSES]);
+
+    write_gauge(out, "othello_ai_queue_depth",
+                "AI requests waiting for a worker.", ai_worker_queue_depth());
+    int log_queued;
+    unsigned long log_dropped;
+    game_log_stats(&log_queued, &log_dropped);
+    write_gauge(out, "othello_game_log_queue_depth",
+                "Finished games waiting to be written.", log_queued);
+    write_counter(out, "othello_game_log_dropped_total",
+                  "Finished games dropped (queue full or write failure).",
+                  log_dropped);
+    write_counter(out, "othello_log_dropped_total",
+                  "Log messages dropped because a ring buffer was full.",
+                  log_dropped_count());
+
+    write_header(out, "othello_lock_contended_total", "counter",
+                 "Lock acquisitions that had to wait.");
+    for (int l = 0; l < METRIC_LOCK_COUNT; ++l) {
+        fprintf(out, "othello_lock_contended_total{lock=\"%s\"} %" PRIu64 "\n",
+                metrics_lock_name(l), snap.lock_contended[l]);
+    }
+    write_header(out, "othello_lock_wait_seconds", "histogram",
+                 "Time spent waiting for a lock.");
+    for (int l = 0; l < METRIC_LOCK_COUNT; ++l) {
+        write_histogram(out, "othello_lock_wait_seconds", "lock",
+                        metrics_lock_name(l), snap.lock_hist[l],
+                        snap.lock_acquired[l], snap.lock_wait_ns[l]);
+    }
+
+    write_header(out, "othello_handler_seconds", "histogram",
+                 "Time spent handling a client message, by type.");
+    for (int slot = 0; slot < METRICS_MSG_SLOTS; ++slot) {
+        if (snap.handled[slot] == 0) {
+            continue;  // 受け取ったことのないタイプは出さない
+        }
+        write_histogram(out, "othello_handler_seconds", "type",
+                        metrics_message_name(slot), snap.hist[slot],
+                        snap.handled[slot], snap.total_ns[slot]);
+    }
+}
+
+static int write_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 1接続分: リクエストヘッダを読み、GET /metrics なら計測値を返す
+static void serve_one(int fd) {
+    char req[METRICS_REQUEST_MAX + 1];
+    size_t len = 0;
+    while (len < METRICS_REQUEST_MAX) {
+        ssize_t n = recv(fd, req + len, METRICS_REQUEST_MAX - len, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return;  // 切断・タイムアウト
+        }
+        len += n;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n") != NULL) {
+            break;
+        }
+    }
+    req[len] = '\0';
+
+    char* body = NULL;
+    size_t body_len = 0;
+    const char* status = "200 OK";
+    FILE* out = open_memstream(&body, &body_len);
+    if (out == NULL) {
+        return;
+    }
+    if (strncmp(req, "GET /metrics ", 13) == 0 ||
+        strncmp(req, "GET / ", 6) == 0) {
+        write_metrics(out);
+    } else {
+        status = "404 Not Found";
+        fprintf(out, "Try GET /metrics\n");
+    }
+    fclose(out);
+
+    char header[256];
+    int header_len =
+        snprintf(header, sizeof(header),
+                 "HTTP/1.0 %s\r\n"
+                 "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Connection: close\r\n\r\n",
+                 status, body_len);
+    if (write_all(fd, header, header_len) == 0) {
+        write_all(fd, body, body_len);
+    }
+    free(body);
+}
+
+static void* metrics_http_thread(void* arg) {
+    (void)arg;
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EINTR) {
+                LOG_ERROR("metrics accept failed: %m");
+            }
+            continue;
+        }
+        // 応答しないスクレイパーで次の接続を待たせない
+        struct timeval tv = {METRICS_READ_TIMEOUT_SEC, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        serve_one(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int metrics_http_start(int port) {
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        LOG_ERROR("metrics socket failed: %m");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    // 計測値は外へ公開しないので、ループバックでだけ待ち受ける
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, 16) < 0) {
+        LOG_ERROR("metrics bind/listen failed: %m");
+        close(listen_fd);
+        return -1;
+    }
+    if (pthread_create(&http_thread_id, NULL, metrics_http_thread, NULL) !=
+        0) {
+        LOG_ERROR("Failed to create metrics HTTP thread: %m");
+        close(listen_fd);
+        return -1;
+    }
+    pthread_detach(http_thread_id);
+    LOG_INFO("Metrics: serving http://127.0.0.1:%d/metrics", port);
+    return 0;
+}
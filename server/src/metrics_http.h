@@ -0,0 +1,12 @@
+#ifndef METRICS_HTTP_H
+#define METRICS_HTTP_H
+
+// --- 計測値の HTTP エンドポイント ---
+// 127.0.0.1:port で待ち受け、GET /metrics に Prometheus のテキスト形式で
+// 計測値 (metrics.c の合算値・部屋数・キューの長さなど) を返す。
+// 専用スレッドが1接続ずつ応答し、イベントループには関わらない。
+
+// 待ち受けを始めてスレッドを起動する。戻り値: 失敗時 -1
+int metrics_http_start(int port);
+
+#endif  // METRICS_HTTP_H
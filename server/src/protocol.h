@@ -6,10 +6,22 @@
 #include <stdint.h>  // For fixed-width integers like uint8_t
 #include <time.h>    // For time_t
 
+#include <stddef.h>  // For size_t
+
 #define BOARD_SIZE 8
 #define MAX_ROOM_NAME_LEN 32
 #define MAX_MESSAGE_LEN 128
 
+// --- ワイヤーフォーマット ---
+// 1フレーム = [ペイロード長 u16][メッセージタイプ u8][ペイロード]
+// 整数はビッグエンディアン、文字列は [長さ u8][本文] (終端文字なし)、
+// 盤面は1マス2ビットで16バイトに詰める (マス r*8+c がバイト (r*8+c)/4 の
+// 下位ビットから順に並ぶ)
+#define FRAME_HEADER_SIZE 3
+#define MAX_FRAME_SIZE 1024   // 1フレームの最大バイト数 (ヘッダ込み)
+#define PACKED_BOARD_SIZE 16  // 盤面のワイヤー上のバイト数
+#define ROOM_LIST_PAGE_SIZE 16  // 部屋一覧の1ページ (1フレーム) に載せる部屋数
+
 // メッセージタイプ定義
 typedef enum {
     // Client -> Server Requests
@@ -35,7 +47,22 @@ typedef enum {
     MSG_REMATCH_RESULT_NOTICE,
     MSG_ROOM_CLOSED_NOTICE,
     MSG_ERROR_NOTICE,
-    MSG_CHAT_MESSAGE_BROADCAST_NOTICE
+    MSG_CHAT_MESSAGE_BROADCAST_NOTICE,
+
+    // 盤面差分 (既存の値を変えないよう末尾に追加)
+    MSG_BOARD_SYNC_REQUEST,  // Client -> Server
+    MSG_BOARD_DELTA_NOTICE,  // Server -> Client
+
+    // AI 対戦
+    MSG_ADD_AI_REQUEST,  // Client -> Server
+
+    // 終局後の棋譜解析
+    MSG_ANALYZE_GAME_REQUEST,  // Client -> Server
+    MSG_ANALYZE_GAME_RESPONSE,  // Server -> Client
+
+    // サーバー再起動後の対局再開
+    MSG_RESUME_REQUEST,  // Client -> Server
+    MSG_RESUME_RESPONSE  // Server -> Client
 } MessageType;
 
 // --- データペイロード定義 ---
@@ -65,6 +92,33 @@ typedef struct {
     char message[MAX_MESSAGE_LEN];
 } JoinRoomResponseData;
 
+// 部屋一覧要求 (Client -> Server)
+// 版はページごとに付く。knownVersion が page ページ目の最新の版と同じなら、
+// 応答は unchanged = 1 だけになる
+typedef struct {
+    int page;          // 0 始まりのページ番号
+    int knownVersion;  // 手元にあるそのページの版 (無ければ 0)
+} ListRoomsRequestData;
+
+// 部屋一覧の1件
+typedef struct {
+    int roomId;
+    char roomName[MAX_ROOM_NAME_LEN];
+    uint8_t status;       // 1:待機中, 2:対戦中, 3:ゲーム終了, 4:再戦同意待ち
+    uint8_t playerCount;  // 参加人数 (0-2)
+} RoomListEntry;
+
+// 部屋一覧応答 (Server -> Client)
+typedef struct {
+    int version;        // このページの版 (ページの中身が変わると増える)
+    uint8_t unchanged;  // 1 なら knownVersion から変化なし (以下は空)
+    int page;
+    int pageCount;
+    int totalRooms;
+    uint8_t count;  // rooms の有効件数
+    RoomListEntry rooms[ROOM_LIST_PAGE_SIZE];
+} ListRoomsResponseData;
+
 // 相手参加通知 (Server -> Client)
 typedef struct {
     int roomId;
@@ -80,6 +134,7 @@ typedef struct {
     int roomId;
     uint8_t yourColor;
     uint8_t board[BOARD_SIZE][BOARD_SIZE];
+    uint64_t resumeToken;  // 再起動後に席を取り戻すための合言葉
 } GameStartNoticeData;
 
 // コマ配置要求 (Client -> Server)
@@ -90,14 +145,85 @@ typedef struct {
 } PlacePieceRequestData;
 
 // 盤面更新通知 (Server -> Client)
+// playerColor が 0 の場合は着手ではなく再同期 (MSG_BOARD_SYNC_REQUEST の応答)
 typedef struct {
     int roomId;
+    int seq;  // この盤面に至った着手の通し番号 (ゲーム開始時 0)
     uint8_t playerColor;
     uint8_t row;
     uint8_t col;
     uint8_t board[BOARD_SIZE][BOARD_SIZE];
 } UpdateBoardNoticeData;
 
+// 盤面差分通知 (Server -> Client)
+// 直前の盤面 (seq - 1) に対して (row, col) へ着手し flips の石を裏返したもの
+typedef struct {
+    int roomId;
+    int seq;
+    uint8_t playerColor;
+    uint8_t row;
+    uint8_t col;
+    uint64_t flips;  // 裏返った石 (bit r*8+c が (r, c))
+} BoardDeltaNoticeData;
+
+// 盤面同期要求 (Client -> Server)
+// 差分通知の受信可否を設定し、roomId が参加中の部屋なら全盤面を再送させる
+typedef struct {
+    int roomId;         // -1 なら設定変更のみ
+    uint8_t wantDelta;  // 1: 着手を差分通知で受け取る, 0: 全盤面で受け取る
+} BoardSyncRequestData;
+
+// AI 追加要求 (Client -> Server)
+// 待機中の部屋にプレイヤー2としてサーバー側の AI を座らせる (作成者のみ)
+// 成功すると MSG_PLAYER_JOINED_NOTICE が届く
+typedef struct {
+    int roomId;
+    int moveTimeMs;  // AI の1手の思考時間 (ミリ秒、0 ならサーバーの既定値)
+} AddAiRequestData;
+
+// 棋譜解析要求 (Client -> Server)
+// 終局した (再戦待ちの) 部屋の対局者が送る。終盤の各手を完全読みで採点する
+typedef struct {
+    int roomId;
+} AnalyzeGameRequestData;
+
+#define MAX_ANALYSIS_MOVES 24  // 1回の解析で返す手数の上限
+
+// 解析した1手 (石差は着手した側から見た最終石差)
+typedef struct {
+    uint8_t seq;        // 何手目か (1 始まり)
+    uint8_t color;      // 着手した色 (1:黒, 2:白)
+    uint8_t played;     // 打ったマス (r * 8 + c)
+    uint8_t best;       // 最善手のマス
+    int8_t playedDiff;  // 打った手の最終石差
+    int8_t bestDiff;    // 最善手の最終石差
+} GameAnalysisEntry;
+
+// 棋譜解析応答 (Server -> Client)
+// 時間内に読み切れた手だけを着手順に並べる (0 件もありうる)
+typedef struct {
+    int roomId;
+    uint8_t count;
+    GameAnalysisEntry moves[MAX_ANALYSIS_MOVES];
+} AnalyzeGameResponseData;
+
+// 対局再開要求 (Client -> Server)
+// サーバーの再起動で切れた対局に、ゲーム開始時の resumeToken で席を取り戻す
+typedef struct {
+    int roomId;
+    uint64_t token;
+} ResumeRequestData;
+
+// 対局再開応答 (Server -> Client)
+// 成功すると全盤面 (MSG_UPDATE_BOARD_NOTICE、playerColor 0) が続き、
+// 両者がそろうと手番側に MSG_YOUR_TURN_NOTICE が届く
+typedef struct {
+    uint8_t success;
+    int roomId;
+    uint8_t yourColor;
+    char message[MAX_MESSAGE_LEN];
+} ResumeResponseData;
+
 // 無効手通知 (Server -> Client)
 typedef struct {
     int roomId;
@@ -168,6 +294,8 @@ typedef struct {
         CreateRoomResponseData createRoomResp;
         JoinRoomRequestData joinRoomReq;
         JoinRoomResponseData joinRoomResp;
+        ListRoomsRequestData listRoomsReq;
+        ListRoomsResponseData listRoomsResp;
         PlayerJoinedNoticeData playerJoinedNotice;
         StartGameRequestData startGameReq;
         GameStartNoticeData gameStartNotice;
@@ -183,6 +311,13 @@ typedef struct {
         ChatMessageSendRequestData chatMessageSendReq;
         ChatMessageBroadcastNoticeData chatMessageBroadcastNotice;
         ErrorNoticeData errorNotice;
+        BoardSyncRequestData boardSyncReq;
+        BoardDeltaNoticeData boardDeltaNotice;
+        AddAiRequestData addAiReq;
+        AnalyzeGameRequestData analyzeGameReq;
+        AnalyzeGameResponseData analyzeGameResp;
+        ResumeRequestData resumeReq;
+        ResumeResponseData resumeResp;
     } data;
 } Message;
 
@@ -190,4 +325,13 @@ typedef struct {
 int sendMessage(int sockfd, const Message* msg);
 int receiveMessage(int sockfd, Message* msg);
 
+// メッセージを1フレームのバイト列に変換する
+// 戻り値: 書き込んだバイト数、バッファ不足なら -1
+int encodeMessage(const Message* msg, uint8_t* buf, size_t bufSize);
+
+// バイト列の先頭から1フレームを取り出してメッセージに復元する
+// 未知のタイプはペイロードを読み飛ばし、type のみ設定して返す
+// 戻り値: 消費したバイト数、データ不足なら 0、不正なフレームなら -1
+int decodeMessage(const uint8_t* buf, size_t len, Message* msg);
+
 #endif  // PROTOCOL_H
\ No newline at end of file
@@ -1,175 +1,344 @@
 #include "room_management.h"
 
-#include <stdio.h>  // snprintf のため
+#include <limits.h>  // INT_MAX
+#include <stdio.h>   // snprintf のため
 
+#include "client_handler.h"     // タイムアウト時の処理 (handle_room_timeout)
 #include "client_management.h"  // クライアント情報更新のため必要
+#include "event_loop.h"
+#include "lobby.h"  // 部屋の変化を一覧に知らせる
+#include "logger.h"
+#include "metrics.h"  // ロックの待ち時間
+#include "slab_pool.h"
 
 // --- グローバル変数定義 ---
-Room rooms[MAX_ROOMS];
 pthread_mutex_t rooms_mutex = PTHREAD_MUTEX_INITIALIZER;
-int room_id_counter = 0;
+int room_capacity = 0;  // 最大部屋数 (initialize_rooms で設定)
 
-// --- 部屋初期化 ---
-void initialize_rooms() {
-    pthread_mutex_lock(&rooms_mutex);
-    for (int i = 0; i < MAX_ROOMS; ++i) {
-        rooms[i].roomId = -1;  // -1は未使用の部屋を示す
-        rooms[i].status = ROOM_EMPTY;
-        rooms[i].player1_sock = -1;
-        rooms[i].player2_sock = -1;
-        memset(rooms[i].roomName, 0, sizeof(rooms[i].roomName));
-        // Mutexは必要になった時に初期化する方が良いかもしれないが、ここでは最初に初期化
-        if (pthread_mutex_init(&rooms[i].room_mutex, NULL) != 0) {
-            perror("Failed to initialize room mutex");
-            // エラー処理: 例えばサーバー起動を中止する
-            exit(EXIT_FAILURE);
-        }
-        rooms[i].player1_rematch_agree = 0;
-        rooms[i].player2_rematch_agree = 0;
-        rooms[i].last_action_time = 0;
+// 部屋の置き場 (スロット番号 = プールの添字)
+static SlabPool room_pool;
+static int free_room_head = -1;  // 空きリストの先頭 (rooms_mutex で保護)
+
+// スロット番号 slot の部屋を返す (未確保なら NULL)。ロック不要
+static inline Room* room_at(int slot) {
+    return (Room*)slab_pool_at(&room_pool, slot);
+}
 
-        rooms[i].chat_history_count = 0;
-        rooms[i].chat_history_next_idx = 0;
-        memset(rooms[i].chat_history, 0, sizeof(rooms[i].chat_history));
+// プール伸長時に新しいスロットを空き部屋として初期化する
+static void init_room_slot(void* elem, int slot) {
+    Room* room = elem;
+    room->roomId = -1;  // -1は未使用の部屋を示す
+    room->generation = 0;
+    room->status = ROOM_EMPTY;
+    room->player1_sock = -1;
+    room->player2_sock = -1;
+    room->ai_move_time_ms = 0;
+    room->analysis_pending = 0;
+    if (pthread_mutex_init(&room->room_mutex, NULL) != 0) {
+        LOG_ERROR("Failed to initialize room mutex: %m");
+        // エラー処理: 例えばサーバー起動を中止する
+        exit(EXIT_FAILURE);
+    }
+    room->chat = NULL;
+    room->next_free = free_room_head;
+    free_room_head = slot;
+}
+
+// --- 部屋初期化 ---
+int initialize_rooms(int max_rooms) {
+    metrics_lock(&rooms_mutex, METRIC_LOCK_ROOMS);
+    int result = slab_pool_init(&room_pool, sizeof(Room), ROOM_POOL_CHUNK,
+                                max_rooms);
+    if (result == 0) {
+        room_capacity = max_rooms;
     }
+    free_room_head = -1;
     pthread_mutex_unlock(&rooms_mutex);
-    printf("Room list initialized.\n");
+    if (result == 0) {
+        LOG_INFO("Room list initialized (max %d rooms).", max_rooms);
+    }
+    return result;
 }
 
-// roomIdから部屋のインデックスを検索 (rooms_mutexで保護)
+// roomIdから部屋のインデックスを求める (roomId にスロット番号が入っている)
+// 注意: ロックなしの参照なので、結果は room_mutex を取って再確認すること
 int find_room_index(int roomId) {
-    // rooms_mutex は呼び出し元でロックされている想定
-    for (int i = 0; i < MAX_ROOMS; ++i) {
-        if (rooms[i].roomId == roomId) {
-            return i;
-        }
+    if (roomId < 0) return -1;
+    int slot = ROOM_SLOT(roomId);
+    Room* room = room_at(slot);
+    // 閉鎖・再利用済みのスロットは roomId が一致しない
+    return (room != NULL && room->roomId == roomId) ? slot : -1;
+}
+
+// roomIdの部屋を room_mutex をロックした状態で返す
+// スロットは roomId から直接決まるので、rooms_mutex も全体走査も不要。
+// 閉鎖や再割り当ては room_mutex 下で roomId を書き換えるため、
+// ロック後に roomId が一致すれば同じ部屋であることが保証される
+Room* acquire_room(int roomId) {
+    if (roomId < 0) return NULL;
+    Room* room = room_at(ROOM_SLOT(roomId));
+    if (room == NULL) return NULL;  // まだ確保されていないスロット
+    metrics_lock(&room->room_mutex, METRIC_LOCK_ROOM);
+    if (room->roomId != roomId) {
+        pthread_mutex_unlock(&room->room_mutex);
+        return NULL;
     }
-    return -1;  // 見つからない
+    return room;
 }
 
-// roomIdからRoomポインタを取得 (rooms_mutexで保護されるべき)
-// 注意: この関数はrooms_mutexがロックされているコンテキストで呼ばれる想定
-// もしくは、内部でロック/アンロックする。ここでは後者を採用。
+// roomIdからRoomポインタを取得 (ロックは取らない)
+// 注意: 返したポインタの内容は room_mutex なしでは変化しうる
 Room* get_room_by_id(int roomId) {
-    pthread_mutex_lock(&rooms_mutex);
-    for (int i = 0; i < MAX_ROOMS; ++i) {
-        if (rooms[i].roomId == roomId) {
-            pthread_mutex_unlock(&rooms_mutex);
-            return &rooms[i];  // ポインタを返す場合は生存期間に注意
+    int room_idx = find_room_index(roomId);
+    return (room_idx != -1) ? room_at(room_idx) : NULL;
+}
+
+// 確保済みのスロット数 (collect_room_list に渡す領域の大きさ)
+int room_slot_count() { return slab_pool_count(&room_pool); }
+
+// 使用中の部屋を一覧用に書き出す (部屋一覧のスナップショット作成用)
+// 各部屋の room_mutex を順に短く取る。戻り値: 書き出した件数
+// 部屋を走査する裏方の処理 (一覧・計測値・スナップショット) は、待ち時間が
+// 着手などの処理のロック競合に紛れないよう metrics_lock を使わない
+int collect_room_list(RoomListEntry* entries, int max_entries) {
+    int slots = room_slot_count();
+    int count = 0;
+    for (int slot = 0; slot < slots && count < max_entries; ++slot) {
+        Room* room = room_at(slot);
+        pthread_mutex_lock(&room->room_mutex);
+        if (room->roomId != -1 && room->status != ROOM_EMPTY) {
+            RoomListEntry* entry = &entries[count++];
+            entry->roomId = room->roomId;
+            memcpy(entry->roomName, room->roomName, MAX_ROOM_NAME_LEN);
+            entry->status = room->status;
+            entry->playerCount =
+                (room->player1_sock != -1) + (room->player2_sock != -1);
         }
+        pthread_mutex_unlock(&room->room_mutex);
+    }
+    return count;
+}
+
+void count_rooms_by_status(int* counts) {
+    memset(counts, 0, (ROOM_SUSPENDED + 1) * sizeof(int));
+    int slots = room_slot_count();
+    for (int slot = 0; slot < slots; ++slot) {
+        Room* room = room_at(slot);
+        pthread_mutex_lock(&room->room_mutex);
+        if (room->roomId != -1 && room->status <= ROOM_SUSPENDED) {
+            ++counts[room->status];
+        }
+        pthread_mutex_unlock(&room->room_mutex);
     }
-    pthread_mutex_unlock(&rooms_mutex);
-    return NULL;
 }
 
-// 空き部屋のインデックスを検索 (rooms_mutexで保護)
+// 対局中・再開待ちの部屋をスナップショット用に書き出す
+// collect_room_list と同様に各部屋の room_mutex を順に短く取る
+int collect_room_snapshots(SnapshotRoom* entries, int max_entries) {
+    int slots = room_slot_count();
+    int count = 0;
+    for (int slot = 0; slot < slots && count < max_entries; ++slot) {
+        Room* room = room_at(slot);
+        pthread_mutex_lock(&room->room_mutex);
+        if (room->roomId != -1 && (room->status == ROOM_PLAYING ||
+                                   room->status == ROOM_SUSPENDED)) {
+            SnapshotRoom* entry = &entries[count++];
+            memset(entry, 0, sizeof(*entry));
+            entry->roomId = room->roomId;
+            entry->white_ai = room->player2_sock == AI_PLAYER_SOCK;
+            entry->ai_move_time_ms = room->ai_move_time_ms;
+            entry->resume_token[0] = room->resume_token[0];
+            entry->resume_token[1] = room->resume_token[1];
+            memcpy(entry->roomName, room->roomName, MAX_ROOM_NAME_LEN);
+            entry->current_turn = room->gameState.currentTurn;
+            entry->move_count = room->gameState.move_seq;
+            memcpy(entry->moves, room->gameState.move_history,
+                   room->gameState.move_seq);
+        }
+        pthread_mutex_unlock(&room->room_mutex);
+    }
+    return count;
+}
+
+// 空きリストからスロットを1つ取り出す (rooms_mutexで保護)
+// 空きがなければプールを伸ばす。上限に達していれば -1
 // 注意: この関数はrooms_mutexがロックされているコンテキストで呼ばれる想定
 int find_empty_room_index() {
-    for (int i = 0; i < MAX_ROOMS; ++i) {
-        // roomId == -1 を空き部屋の印とする（status ROOM_EMPTY と併用）
-        if (rooms[i].roomId == -1 && rooms[i].status == ROOM_EMPTY) {
-            return i;
+    if (free_room_head == -1 &&
+        slab_pool_grow(&room_pool, init_room_slot) == -1) {
+        return -1;  // 満室
+    }
+    int slot = free_room_head;
+    free_room_head = room_at(slot)->next_free;
+    room_at(slot)->next_free = -1;
+    return slot;
+}
+
+// 再起動時の復元用に roomId のスロットを空きリストから取り出す
+// (起動時に1回ずつ呼ぶだけなので、空きリストは先頭からたどる)
+Room* restore_room(int roomId) {
+    if (roomId < 0) return NULL;
+    int slot = ROOM_SLOT(roomId);
+
+    metrics_lock(&rooms_mutex, METRIC_LOCK_ROOMS);
+    while (slot >= room_slot_count()) {
+        if (slab_pool_grow(&room_pool, init_room_slot) == -1) {
+            pthread_mutex_unlock(&rooms_mutex);
+            return NULL;
         }
     }
-    return -1;  // 満室
+    int* link = &free_room_head;
+    while (*link != -1 && *link != slot) {
+        link = &room_at(*link)->next_free;
+    }
+    if (*link == -1) {
+        pthread_mutex_unlock(&rooms_mutex);
+        return NULL;  // 同じスロットの部屋を復元済み
+    }
+    *link = room_at(slot)->next_free;
+    room_at(slot)->next_free = -1;
+    pthread_mutex_unlock(&rooms_mutex);
+
+    Room* room = room_at(slot);
+    metrics_lock(&room->room_mutex, METRIC_LOCK_ROOM);
+    // 以後このスロットに作る部屋が復元した roomId と重ならないよう世代を進める
+    room->roomId = roomId;
+    room->generation = (roomId / room_capacity + 1) % (INT_MAX / room_capacity);
+    room->player1_sock = -1;
+    room->player2_sock = -1;
+    room->ai_move_time_ms = 0;
+    room->analysis_pending = 0;
+    room->player1_rematch_agree = 0;
+    room->player2_rematch_agree = 0;
+    room->last_action_time = time(NULL);
+    return room;
 }
 
-int create_new_room(int client_sock, const char* roomName) {
-    pthread_mutex_lock(&rooms_mutex);  // 部屋リスト全体をロック
+// 閉鎖した部屋のスロットを空きリストに戻す (room_mutex は解放済みで呼ぶ)
+static void release_room_slot(int slot) {
+    metrics_lock(&rooms_mutex, METRIC_LOCK_ROOMS);
+    room_at(slot)->next_free = free_room_head;
+    free_room_head = slot;
+    pthread_mutex_unlock(&rooms_mutex);
+}
+
+// --- 部屋のタイムアウト ---
+// 部屋ごとのタイマーは1つで、状態 (待機・対戦・再戦受付) に応じて設定し直す
+
+void arm_room_timer(Room* room, int seconds) {
+    timer_arm(&room->timer, room->roomId, (unsigned int)seconds * 1000u,
+              handle_room_timeout);
+}
+
+void cancel_room_timer(Room* room) { timer_cancel(&room->timer); }
 
+int create_new_room(int client_sock, const char* roomName) {
+    // 空きスロットを取り出す。取り出したスロットは roomId が -1 のままなので
+    // 他スレッドからは見えず、rooms_mutex を離してから準備してよい
+    metrics_lock(&rooms_mutex, METRIC_LOCK_ROOMS);
     int room_idx = find_empty_room_index();  // rooms_mutexロック中に呼び出し
+    pthread_mutex_unlock(&rooms_mutex);
     if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
-        fprintf(stderr, "Failed to create room: no empty slots.\n");
+        LOG_ERROR("Failed to create room: no empty slots.");
         return -1;  // 満室
     }
 
-    // 部屋固有のミューテックスをロック (リストロック中に取得)
-    pthread_mutex_lock(&rooms[room_idx].room_mutex);
-
-    int new_room_id = room_id_counter++;  // 新しいIDを割り当て
-    rooms[room_idx].roomId = new_room_id;
-    strncpy(rooms[room_idx].roomName, roomName, MAX_ROOM_NAME_LEN - 1);
-    rooms[room_idx].roomName[MAX_ROOM_NAME_LEN - 1] = '\0';
-    rooms[room_idx].status = ROOM_WAITING;
-    rooms[room_idx].player1_sock = client_sock;
-    rooms[room_idx].player2_sock = -1;
-    rooms[room_idx].last_action_time = time(NULL);
-    rooms[room_idx].player1_rematch_agree = 0;
-    rooms[room_idx].player2_rematch_agree = 0;
+    // 部屋固有のミューテックスをロック
+    Room* room = room_at(room_idx);
+    metrics_lock(&room->room_mutex, METRIC_LOCK_ROOM);
+
+    // 新しいIDを割り当て: スロットごとに世代を進め、閉鎖済みの古い roomId
+    // が同じスロットの新しい部屋を指さないようにする
+    int new_room_id = room->generation * room_capacity + room_idx;
+    room->generation = (room->generation + 1) % (INT_MAX / room_capacity);
+    room->roomId = new_room_id;
+    strncpy(room->roomName, roomName, MAX_ROOM_NAME_LEN - 1);
+    room->roomName[MAX_ROOM_NAME_LEN - 1] = '\0';
+    room->status = ROOM_WAITING;
+    room->player1_sock = client_sock;
+    room->player2_sock = -1;
+    room->ai_move_time_ms = 0;
+    room->analysis_pending = 0;
+    room->last_action_time = time(NULL);
+    room->player1_rematch_agree = 0;
+    room->player2_rematch_agree = 0;
 
     // ゲーム状態の初期化 (空っぽの状態)
-    memset(&rooms[room_idx].gameState, 0, sizeof(GameState));
-    rooms[room_idx].gameState.currentTurn = 0;  // まだ始まっていない
-    rooms[room_idx].chat_history_count = 0;
-    rooms[room_idx].chat_history_next_idx = 0;
-    memset(rooms[room_idx].chat_history, 0,
-           sizeof(rooms[room_idx].chat_history));
-
-    // 部屋リスト全体のロックを解除 (部屋固有ロックは保持)
-    pthread_mutex_unlock(&rooms_mutex);
+    memset(&room->gameState, 0, sizeof(GameState));
+    room->gameState.currentTurn = 0;  // まだ始まっていない
+    // チャット履歴は最初のチャットで確保する (room->chat は NULL のまま)
+    arm_room_timer(room, WAITING_ROOM_TIMEOUT_SEC);  // 対戦が始まらなければ閉じる
 
-    // クライアント情報にも部屋IDを記録
-    pthread_mutex_lock(&clients_mutex);
-    int client_idx = find_client_index(client_sock);
-    if (client_idx != -1) {
-        clients[client_idx].roomId = new_room_id;
-        clients[client_idx].playerColor =
-            1;  // 部屋作成者は黒（先手）とする (仮)
-    } else {
+    // クライアント情報にも部屋IDを記録 (部屋作成者は黒（先手）とする)
+    if (set_client_room(client_sock, new_room_id, 1) == -1) {
         // クライアントが見つからないエラー (通常発生しないはず)
-        fprintf(stderr,
-                "Error: Client sockfd %d not found when creating room %d.\n",
-                client_sock, new_room_id);
-        // エラー処理: 作成した部屋をキャンセルするなど
-        pthread_mutex_unlock(&clients_mutex);
-        pthread_mutex_unlock(
-            &rooms[room_idx].room_mutex);  // 部屋固有ロックも解除
-        // 部屋情報をリセット
-        pthread_mutex_lock(&rooms_mutex);
-        rooms[room_idx].roomId = -1;
-        rooms[room_idx].status = ROOM_EMPTY;
-        rooms[room_idx].player1_sock = -1;
-        pthread_mutex_unlock(&rooms_mutex);
+        LOG_ERROR("Error: Client sockfd %d not found when creating room %d.",
+                  client_sock, new_room_id);
+        // 部屋情報をリセットしてスロットを返す
+        cancel_room_timer(room);
+        room->roomId = -1;
+        room->status = ROOM_EMPTY;
+        room->player1_sock = -1;
+        pthread_mutex_unlock(&room->room_mutex);  // 部屋固有ロックも解除
+        release_room_slot(room_idx);
         return -1;  // エラーを示す
     }
-    pthread_mutex_unlock(&clients_mutex);
 
-    printf("Room %d ('%s') created by client sockfd %d (Player 1).\n",
-           new_room_id, rooms[room_idx].roomName, client_sock);
+    LOG_INFO("Room %d ('%s') created by client sockfd %d (Player 1).",
+             new_room_id, room->roomName, client_sock);
+    lobby_mark_dirty();
 
     pthread_mutex_unlock(
-        &rooms[room_idx].room_mutex);  // 部屋固有のミューテックスをアンロック
+        &room->room_mutex);  // 部屋固有のミューテックスをアンロック
 
     return new_room_id;
 }
 
-int join_room(int client_sock, int targetRoomId) {
-    pthread_mutex_lock(&rooms_mutex);  // 部屋リスト全体をロック
+// 送信者の色と表示名を解決して entry に保存する (ロックなしで参照)
+static void resolve_chat_sender(int sender_sock, ChatMessageEntry* entry) {
+    int sender_color = (find_client_index(sender_sock) != -1)
+                           ? get_client_player_color(sender_sock)
+                           : 0;  // 接続が切れた直後など
+    entry->sender_player_color = sender_color;
+    if (sender_color == 1) {
+        snprintf(entry->sender_display_name, MAX_ROOM_NAME_LEN, "Player 1");
+    } else if (sender_color == 2) {
+        snprintf(entry->sender_display_name, MAX_ROOM_NAME_LEN, "Player 2");
+    } else {
+        snprintf(entry->sender_display_name, MAX_ROOM_NAME_LEN, "User %d",
+                 sender_sock);  // SockFDでフォールバック
+    }
+}
 
-    int room_idx =
-        find_room_index(targetRoomId);  // rooms_mutexロック中に呼び出し
+// 履歴エントリからチャット通知の内容を組み立てる
+static void fill_chat_notice(ChatMessageBroadcastNoticeData* notice_data,
+                             int roomId, const ChatMessageEntry* entry) {
+    notice_data->roomId = roomId;
+    notice_data->timestamp = entry->timestamp;
+    notice_data->sender_player_color = entry->sender_player_color;
+    memcpy(notice_data->sender_display_name, entry->sender_display_name,
+           MAX_ROOM_NAME_LEN);
+    memcpy(notice_data->message_text, entry->message,
+           MAX_CHAT_MESSAGE_LEN);  // 既にNULL終端されている
+}
 
-    if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
-        printf("Client sockfd %d failed to join non-existent room %d\n",
-               client_sock, targetRoomId);
+int join_room(int client_sock, int targetRoomId) {
+    // 部屋固有のミューテックスのみロック
+    Room* current_room = acquire_room(targetRoomId);
+    if (current_room == NULL) {
+        LOG_INFO("Client sockfd %d failed to join non-existent room %d",
+                 client_sock, targetRoomId);
         return -1;  // 部屋が見つからない
     }
-
-    Room* current_room = &rooms[room_idx];
-    printf("Client sockfd %d is trying to join room %d\n", client_sock,
-           targetRoomId);
-    // 部屋固有のミューテックスをロック (リストロック中に取得)
-    pthread_mutex_lock(&current_room->room_mutex);
-    pthread_mutex_unlock(&rooms_mutex);  // rooms_mutex は解放
+    LOG_DEBUG("Client sockfd %d is trying to join room %d", client_sock,
+              targetRoomId);
 
     if (current_room->status != ROOM_WAITING) {
         pthread_mutex_unlock(&current_room->room_mutex);
-        fprintf(stderr,
-                "Client sockfd %d failed to join room %d (not waiting, status: "
-                "%d)\n",
-                client_sock, targetRoomId, current_room->status);
+        LOG_ERROR(
+            "Client sockfd %d failed to join room %d (not waiting, status: "
+            "%d)",
+            client_sock, targetRoomId, current_room->status);
         return (current_room->status == ROOM_PLAYING ||
                 current_room->status == ROOM_GAMEOVER ||
                 current_room->status == ROOM_REMATCHING)
@@ -177,42 +346,66 @@ int join_room(int client_sock, int targetRoomId) {
                    : -3;
     }
 
+    if (current_room->player2_sock != -1) {
+        pthread_mutex_unlock(&current_room->room_mutex);
+        LOG_ERROR(
+            "Client sockfd %d failed to join room %d (already has player "
+            "2)",
+            client_sock, targetRoomId);
+        return -2;  // 満員 (開始前の対戦相手または AI がいる)
+    }
+
     // プレイヤー2として参加
     current_room->player2_sock = client_sock;
     current_room->last_action_time = time(NULL);
+    arm_room_timer(current_room, WAITING_ROOM_TIMEOUT_SEC);  // 待ち時間を延長
+    lobby_mark_dirty();  // 参加人数が変わる
 
     // クライアント情報にも部屋IDと色を記録
-    pthread_mutex_lock(&clients_mutex);
-    int client_idx = find_client_index(client_sock);
-    if (client_idx != -1) {
-        clients[client_idx].roomId = current_room->roomId;
-        clients[client_idx].playerColor = 2;
-    } else {
-        fprintf(stderr,
-                "Error: Client sockfd %d not found when joining room %d.\n",
-                client_sock, targetRoomId);
-        pthread_mutex_unlock(&clients_mutex);
+    if (set_client_room(client_sock, current_room->roomId, 2) == -1) {
+        LOG_ERROR("Error: Client sockfd %d not found when joining room %d.",
+                  client_sock, targetRoomId);
         current_room->player2_sock = -1;  // ロールバック
         pthread_mutex_unlock(&current_room->room_mutex);
         return -1;
     }
-    pthread_mutex_unlock(&clients_mutex);
     // --- 参加者にチャット履歴を送信 & 相手に参加を通知 ---
-    // 必要な情報を room_mutex ロック中に取得し、アンロック後に送信
-    ChatMessageEntry history_copy[MAX_CHAT_HISTORY];
-    int history_count_copy = 0;
-    int p1_sock_to_notify =
-        current_room->player1_sock;  // player1_sock もコピー
-
-    // チャット履歴をコピー (リングバッファ対応)
-    if (current_room->chat_history_count > 0) {
-        history_count_copy = current_room->chat_history_count;
-        int start_idx = (current_room->chat_history_next_idx -
-                         current_room->chat_history_count + MAX_CHAT_HISTORY) %
-                        MAX_CHAT_HISTORY;
-        for (int i = 0; i < history_count_copy; ++i) {
-            history_copy[i] =
-                current_room->chat_history[(start_idx + i) % MAX_CHAT_HISTORY];
+    // 履歴は room_mutex ロック中にフレーム列へエンコードし、アンロック後に
+    // send_frames_to_client で一括送信する (送信1回で済ませる)
+    int p1_sock_to_notify = current_room->player1_sock;
+    ChatHistory* chat = current_room->chat;
+    int history_count = (chat != NULL) ? chat->count : 0;
+    uint8_t* history_frames = NULL;
+    size_t history_len = 0;
+
+    if (history_count > 0) {
+        history_frames = malloc((size_t)history_count * MAX_FRAME_SIZE);
+        if (history_frames == NULL) {
+            LOG_ERROR("Failed to allocate chat history buffer: %m");
+            history_count = 0;
+        }
+    }
+    if (history_count > 0) {
+        // リングバッファの古い順に並べる
+        int start_idx =
+            (chat->next_idx - history_count + MAX_CHAT_HISTORY) %
+            MAX_CHAT_HISTORY;
+        Message chat_notice_msg;
+        chat_notice_msg.type = MSG_CHAT_MESSAGE_BROADCAST_NOTICE;
+        for (int i = 0; i < history_count; ++i) {
+            const ChatMessageEntry* entry =
+                &chat->entries[(start_idx + i) % MAX_CHAT_HISTORY];
+            fill_chat_notice(&chat_notice_msg.data.chatMessageBroadcastNotice,
+                             targetRoomId, entry);
+            int n = encodeMessage(&chat_notice_msg,
+                                  history_frames + history_len,
+                                  (size_t)(history_count - i) * MAX_FRAME_SIZE);
+            if (n < 0) {
+                LOG_ERROR("Error encoding chat history message for room %d",
+                          targetRoomId);
+                break;
+            }
+            history_len += n;
         }
     }
 
@@ -224,94 +417,89 @@ int join_room(int client_sock, int targetRoomId) {
         Message notify_msg;
         notify_msg.type = MSG_PLAYER_JOINED_NOTICE;
         notify_msg.data.playerJoinedNotice.roomId = targetRoomId;
-        sendMessage(p1_sock_to_notify, &notify_msg);
-        printf(
-            "Notified player 1 (sockfd %d) about player 2 joining room %d.\n",
+        send_to_client(p1_sock_to_notify, &notify_msg);
+        LOG_DEBUG(
+            "Notified player 1 (sockfd %d) about player 2 joining room %d.",
             p1_sock_to_notify, targetRoomId);
     }
 
     // 新規参加者 (client_sock) にチャット履歴を送信
-    if (history_count_copy > 0) {
-        printf(
-            "Sending %d chat history messages to client sockfd %d in room "
-            "%d.\n",
-            history_count_copy, client_sock, targetRoomId);
-        for (int i = 0; i < history_count_copy; ++i) {
-            Message chat_notice_msg;
-            chat_notice_msg.type = MSG_CHAT_MESSAGE_BROADCAST_NOTICE;
-            ChatMessageBroadcastNoticeData* notice_data =
-                &chat_notice_msg.data.chatMessageBroadcastNotice;
-
-            notice_data->roomId = targetRoomId;
-            notice_data->timestamp = history_copy[i].timestamp;
-            strncpy(notice_data->message_text, history_copy[i].message,
-                    MAX_CHAT_MESSAGE_LEN - 1);
-            notice_data->message_text[MAX_CHAT_MESSAGE_LEN - 1] = '\0';
-
-            pthread_mutex_lock(&clients_mutex);
-            int sender_c_idx = find_client_index(history_copy[i].sender_sock);
-            if (sender_c_idx != -1) {
-                notice_data->sender_player_color =
-                    clients[sender_c_idx].playerColor;
-                if (clients[sender_c_idx].playerColor == 1) {
-                    snprintf(notice_data->sender_display_name,
-                             MAX_ROOM_NAME_LEN, "Player 1");
-                } else if (clients[sender_c_idx].playerColor == 2) {
-                    snprintf(notice_data->sender_display_name,
-                             MAX_ROOM_NAME_LEN, "Player 2");
-                } else {  // 念のため
-                    snprintf(notice_data->sender_display_name,
-                             MAX_ROOM_NAME_LEN, "User %d",
-                             history_copy[i].sender_sock);
-                }
-            } else {
-                notice_data->sender_player_color = 0;  // Unknown
-                snprintf(notice_data->sender_display_name, MAX_ROOM_NAME_LEN,
-                         "Past User");
-            }
-            pthread_mutex_unlock(&clients_mutex);
-
-            if (sendMessage(client_sock, &chat_notice_msg) == -1) {
-                fprintf(
-                    stderr,
-                    "Error sending chat history message to client sockfd %d\n",
-                    client_sock);
-                break;  // エラー発生時は以降の送信を中止
-            }
+    if (history_len > 0) {
+        LOG_DEBUG(
+            "Sending %d chat history messages (%zu bytes) to client sockfd %d "
+            "in room %d.",
+            history_count, history_len, client_sock, targetRoomId);
+        if (send_frames_to_client(client_sock, history_frames, history_len,
+                                  1) == -1) {
+            LOG_ERROR("Error sending chat history to client sockfd %d",
+                      client_sock);
         }
     }
+    free(history_frames);
     return targetRoomId;  // 成功
 }
 
+// 待機中の部屋にプレイヤー2として AI を座らせる (作成者のみ)
+// 戻り値: 成功時 roomId、-1: 部屋なし、-2: 満員・対戦中、-3: 作成者ではない
+int add_ai_player(int client_sock, int roomId, int move_time_ms) {
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        return -1;
+    }
+    if (room->player1_sock != client_sock) {
+        pthread_mutex_unlock(&room->room_mutex);
+        return -3;
+    }
+    if (room->status != ROOM_WAITING || room->player2_sock != -1) {
+        pthread_mutex_unlock(&room->room_mutex);
+        return -2;
+    }
+
+    room->player2_sock = AI_PLAYER_SOCK;
+    room->ai_move_time_ms = move_time_ms;
+    room->last_action_time = time(NULL);
+    arm_room_timer(room, WAITING_ROOM_TIMEOUT_SEC);  // 待ち時間を延長
+    lobby_mark_dirty();  // 参加人数が変わる
+    pthread_mutex_unlock(&room->room_mutex);
+
+    LOG_INFO("AI joined room %d as player 2 (%d ms per move).", roomId,
+             move_time_ms);
+    return roomId;
+}
+
 static void process_and_broadcast_chat_message(int roomId, int sender_sock,
                                                const char* message_text) {
-    pthread_mutex_lock(&rooms_mutex);
-    int room_idx = find_room_index(roomId);
-    if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
-        fprintf(stderr,
-                "Error: Room %d not found for chat message from sock %d.\n",
-                roomId, sender_sock);
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        LOG_ERROR("Error: Room %d not found for chat message from sock %d.",
+                  roomId, sender_sock);
         // TODO: 送信者にエラーを返すか検討
         return;
     }
 
-    Room* room = &rooms[room_idx];
-    pthread_mutex_lock(&room->room_mutex);
-    pthread_mutex_unlock(&rooms_mutex);  // rooms_mutex は解放
-
     // 1. チャット履歴に追加 (リングバッファ)
-    ChatMessageEntry* new_entry =
-        &room->chat_history[room->chat_history_next_idx];
-    new_entry->sender_sock = sender_sock;
-    strncpy(new_entry->message, message_text, MAX_CHAT_MESSAGE_LEN - 1);
-    new_entry->message[MAX_CHAT_MESSAGE_LEN - 1] = '\0';
-    new_entry->timestamp = time(NULL);
-
-    room->chat_history_next_idx =
-        (room->chat_history_next_idx + 1) % MAX_CHAT_HISTORY;
-    if (room->chat_history_count < MAX_CHAT_HISTORY) {
-        room->chat_history_count++;
+    // 送信者の表示名はここで一度だけ解決して履歴に保存する
+    ChatMessageEntry new_entry;
+    new_entry.sender_sock = sender_sock;
+    resolve_chat_sender(sender_sock, &new_entry);
+    strncpy(new_entry.message, message_text, MAX_CHAT_MESSAGE_LEN - 1);
+    new_entry.message[MAX_CHAT_MESSAGE_LEN - 1] = '\0';
+    new_entry.timestamp = time(NULL);
+
+    // 履歴はチャットのある部屋だけが持つよう、最初のチャットで確保する
+    if (room->chat == NULL) {
+        room->chat = calloc(1, sizeof(ChatHistory));
+        if (room->chat == NULL) {
+            LOG_ERROR("Failed to allocate chat history: %m");  // 履歴なしで配信は行う
+        }
+    }
+    if (room->chat != NULL) {
+        ChatHistory* chat = room->chat;
+        chat->entries[chat->next_idx] = new_entry;
+        chat->next_idx = (chat->next_idx + 1) % MAX_CHAT_HISTORY;
+        if (chat->count < MAX_CHAT_HISTORY) {
+            chat->count++;
+        }
     }
 
     // 2. ブロードキャスト用のメッセージ作成
@@ -320,56 +508,30 @@ static void process_and_broadcast_chat_message(int roomId, int sender_sock,
     ChatMessageBroadcastNoticeData* notice_data =
         &chat_notice_msg.data.chatMessageBroadcastNotice;
 
-    notice_data->roomId = roomId;
-    notice_data->timestamp = new_entry->timestamp;
-    strncpy(notice_data->message_text, new_entry->message,
-            MAX_CHAT_MESSAGE_LEN);  // 既にNULL終端されているはず
-
-    pthread_mutex_lock(&clients_mutex);
-    int sender_c_idx = find_client_index(sender_sock);
-    if (sender_c_idx != -1) {
-        notice_data->sender_player_color = clients[sender_c_idx].playerColor;
-        if (clients[sender_c_idx].playerColor == 1) {
-            snprintf(notice_data->sender_display_name, MAX_ROOM_NAME_LEN,
-                     "Player 1");
-        } else if (clients[sender_c_idx].playerColor == 2) {
-            snprintf(notice_data->sender_display_name, MAX_ROOM_NAME_LEN,
-                     "Player 2");
-        } else {
-            snprintf(notice_data->sender_display_name, MAX_ROOM_NAME_LEN,
-                     "User %d", sender_sock);
-        }
-    } else {  // 接続が切れた直後など、クライアントリストにない場合
-        notice_data->sender_player_color = 0;  // Unknown
-        snprintf(notice_data->sender_display_name, MAX_ROOM_NAME_LEN, "User %d",
-                 sender_sock);  // SockFDでフォールバック
-    }
-    pthread_mutex_unlock(&clients_mutex);
+    fill_chat_notice(notice_data, roomId, &new_entry);
 
     // 3. ルームメンバーにブロードキャスト (送信者自身にも送る)
     int p1_sock = room->player1_sock;
     int p2_sock = room->player2_sock;
 
-    pthread_mutex_unlock(&room->room_mutex);  // sendMessage の前にアンロック
+    pthread_mutex_unlock(&room->room_mutex);  // 送信の前にアンロック
 
     if (p1_sock != -1) {
-        if (sendMessage(p1_sock, &chat_notice_msg) == -1) {
-            fprintf(stderr,
-                    "Error sending chat broadcast to player 1 (sock %d) in "
-                    "room %d.\n",
-                    p1_sock, roomId);
+        if (send_to_client(p1_sock, &chat_notice_msg) == -1) {
+            LOG_ERROR("Error sending chat broadcast to player 1 (sock %d) in "
+                      "room %d.",
+                      p1_sock, roomId);
         }
     }
     if (p2_sock != -1) {
-        if (sendMessage(p2_sock, &chat_notice_msg) == -1) {
-            fprintf(stderr,
-                    "Error sending chat broadcast to player 2 (sock %d) in "
-                    "room %d.\n",
-                    p2_sock, roomId);
+        if (send_to_client(p2_sock, &chat_notice_msg) == -1) {
+            LOG_ERROR("Error sending chat broadcast to player 2 (sock %d) in "
+                      "room %d.",
+                      p2_sock, roomId);
         }
     }
-    printf("Chat from sock %d in room %d ('%s') broadcasted.\n", sender_sock,
-           roomId, message_text);
+    LOG_DEBUG("Chat from sock %d in room %d ('%s') broadcasted.", sender_sock,
+              roomId, message_text);
 }
 
 // クライアントからのチャットメッセージ要求を処理
@@ -377,19 +539,17 @@ void handle_chat_message(int client_sock, int roomId,
                          const char* message_text) {
     // 入力基本的なチェック
     if (message_text == NULL || strlen(message_text) == 0) {
-        fprintf(stderr,
-                "Received empty chat message from sock %d for room %d.\n",
-                client_sock, roomId);
+        LOG_ERROR("Received empty chat message from sock %d for room %d.",
+                  client_sock, roomId);
         return;
     }
     // メッセージ長チェックは sendMessage
     // やプロトコルレベルで行われる想定だが、ここでも軽くチェック
     if (strlen(message_text) >= MAX_CHAT_MESSAGE_LEN) {
-        fprintf(stderr,
-                "Chat message from sock %d for room %d is too long (max %d, "
-                "got %zu).\n",
-                client_sock, roomId, MAX_CHAT_MESSAGE_LEN,
-                strlen(message_text));
+        LOG_ERROR("Chat message from sock %d for room %d is too long (max %d, "
+                  "got %zu).",
+                  client_sock, roomId, MAX_CHAT_MESSAGE_LEN,
+                  strlen(message_text));
         // メッセージを切り詰めるか、エラーを返す。ここでは何もしない。
     }
 
@@ -399,45 +559,38 @@ void handle_chat_message(int client_sock, int roomId,
 
 // 部屋の全員にメッセージ送信 (exclude_sockを除く)
 void broadcast_to_room(int roomId, const Message* msg, int exclude_sock) {
-    pthread_mutex_lock(&rooms_mutex);
-    int room_idx = find_room_index(roomId);
-
-    if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
-        fprintf(stderr, "Warning: Cannot broadcast to non-existent room %d.\n",
-                roomId);
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        LOG_WARN("Warning: Cannot broadcast to non-existent room %d.", roomId);
         return;  // 部屋なし
     }
 
-    pthread_mutex_lock(&rooms[room_idx].room_mutex);
-    pthread_mutex_unlock(&rooms_mutex);  // リストロック解除
-
-    int p1_sock = rooms[room_idx].player1_sock;
-    int p2_sock = rooms[room_idx].player2_sock;
+    int p1_sock = room->player1_sock;
+    int p2_sock = room->player2_sock;
 
     // メッセージ送信は room_mutex
     // のロック外で行う方がデッドロックのリスクが低い
-    pthread_mutex_unlock(&rooms[room_idx].room_mutex);
+    pthread_mutex_unlock(&room->room_mutex);
 
     if (p1_sock != -1 && p1_sock != exclude_sock) {
         // printf("Broadcasting msg type %d to P1 (sock %d) in room %d\n",
         // msg->type, p1_sock, roomId);
-        if (sendMessage(p1_sock, msg) == -1) {
-            fprintf(stderr,
-                    "Error sending broadcast message to player 1 (sock %d) in "
-                    "room %d.\n",
-                    p1_sock, roomId);
+        if (send_to_client(p1_sock, msg) == -1) {
+            LOG_ERROR(
+                "Error sending broadcast message to player 1 (sock %d) in "
+                "room %d.",
+                p1_sock, roomId);
             // エラー処理（例: クライアント切断として扱う）が必要な場合がある
         }
     }
     if (p2_sock != -1 && p2_sock != exclude_sock) {
         // printf("Broadcasting msg type %d to P2 (sock %d) in room %d\n",
         // msg->type, p2_sock, roomId);
-        if (sendMessage(p2_sock, msg) == -1) {
-            fprintf(stderr,
-                    "Error sending broadcast message to player 2 (sock %d) in "
-                    "room %d.\n",
-                    p2_sock, roomId);
+        if (send_to_client(p2_sock, msg) == -1) {
+            LOG_ERROR(
+                "Error sending broadcast message to player 2 (sock %d) in "
+                "room %d.",
+                p2_sock, roomId);
             // エラー処理
         }
     }
@@ -445,38 +598,42 @@ void broadcast_to_room(int roomId, const Message* msg, int exclude_sock) {
 
 // 部屋を閉鎖し、プレイヤーに通知
 void close_room(int roomId, const char* reason) {
-    pthread_mutex_lock(&rooms_mutex);
-    int room_idx = find_room_index(roomId);
-
-    if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
-        fprintf(stderr, "Warning: Cannot close non-existent room %d.\n",
-                roomId);
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
+        LOG_WARN("Warning: Cannot close non-existent room %d.", roomId);
         return;  // 部屋なし
     }
+    int room_idx = ROOM_SLOT(roomId);
 
-    pthread_mutex_lock(&rooms[room_idx].room_mutex);
-    // 部屋リスト全体のロックは解除して良い
-    pthread_mutex_unlock(&rooms_mutex);
-
-    printf("Closing room %d: %s\n", roomId, reason);
+    LOG_INFO("Closing room %d: %s", roomId, reason);
 
-    int p1_sock = rooms[room_idx].player1_sock;
-    int p2_sock = rooms[room_idx].player2_sock;
+    int p1_sock = room->player1_sock;
+    int p2_sock = room->player2_sock;
+    ChatHistory* chat = room->chat;
 
     // 部屋情報をリセット
     // (通知前にリセットしないと、通知中に別のスレッドが入る可能性)
-    rooms[room_idx].status = ROOM_EMPTY;
-    rooms[room_idx].roomId = -1;  // ID無効化
-    rooms[room_idx].player1_sock = -1;
-    rooms[room_idx].player2_sock = -1;
-    rooms[room_idx].player1_rematch_agree = 0;
-    rooms[room_idx].player2_rematch_agree = 0;
-    memset(rooms[room_idx].roomName, 0, sizeof(rooms[room_idx].roomName));
+    room->status = ROOM_EMPTY;
+    room->roomId = -1;  // ID無効化
+    room->player1_sock = -1;
+    room->player2_sock = -1;
+    room->ai_move_time_ms = 0;
+    room->analysis_pending = 0;
+    room->player1_rematch_agree = 0;
+    room->player2_rematch_agree = 0;
+    memset(room->roomName, 0, sizeof(room->roomName));
     // gameState もクリア
-    memset(&rooms[room_idx].gameState, 0, sizeof(GameState));
+    memset(&room->gameState, 0, sizeof(GameState));
+    room->chat = NULL;
+    cancel_room_timer(room);
+    lobby_mark_dirty();
+
+    pthread_mutex_unlock(&room->room_mutex);  // 通知前にアンロック
 
-    pthread_mutex_unlock(&rooms[room_idx].room_mutex);  // 通知前にアンロック
+    // roomId を無効化済みなので、履歴は誰からも参照されない
+    free(chat);
+    // スロットを空きリストに戻す (room_mutex は再利用するので destroy しない)
+    release_room_slot(room_idx);
 
     // 通知メッセージ作成
     Message close_msg;
@@ -488,55 +645,35 @@ void close_room(int roomId, const char* reason) {
 
     // 各プレイヤーに通知し、クライアント側の部屋情報をリセット
     if (p1_sock != -1) {
-        sendMessage(p1_sock, &close_msg);
-        pthread_mutex_lock(&clients_mutex);
-        int idx = find_client_index(p1_sock);
-        if (idx != -1) {
-            clients[idx].roomId = -1;
-            clients[idx].playerColor = 0;
-        }
-        pthread_mutex_unlock(&clients_mutex);
+        send_to_client(p1_sock, &close_msg);
+        set_client_room(p1_sock, -1, 0);
     }
     if (p2_sock != -1) {
-        sendMessage(p2_sock, &close_msg);
-        pthread_mutex_lock(&clients_mutex);
-        int idx = find_client_index(p2_sock);
-        if (idx != -1) {
-            clients[idx].roomId = -1;
-            clients[idx].playerColor = 0;
-        }
-        pthread_mutex_unlock(&clients_mutex);
+        send_to_client(p2_sock, &close_msg);
+        set_client_room(p2_sock, -1, 0);
     }
-
-    // room_mutex は再利用するので destroy しない
 }
 
 // 相手プレイヤーのソケットを取得 (内部で room lock/unlock)
 int get_opponent_sock(int roomId, int self_sock) {
-    pthread_mutex_lock(&rooms_mutex);
-    int room_idx = find_room_index(roomId);
-
-    if (room_idx == -1) {
-        pthread_mutex_unlock(&rooms_mutex);
+    Room* room = acquire_room(roomId);
+    if (room == NULL) {
         return -1;  // 部屋が見つからない
     }
 
-    pthread_mutex_lock(&rooms[room_idx].room_mutex);
-    pthread_mutex_unlock(&rooms_mutex);  // リストロック解除
-
     int opponent_sock = -1;
-    if (rooms[room_idx].player1_sock == self_sock) {
-        opponent_sock = rooms[room_idx].player2_sock;
-    } else if (rooms[room_idx].player2_sock == self_sock) {
-        opponent_sock = rooms[room_idx].player1_sock;
+    if (room->player1_sock == self_sock) {
+        opponent_sock = room->player2_sock;
+    } else if (room->player2_sock == self_sock) {
+        opponent_sock = room->player1_sock;
     } else {
         // 部屋のプレイヤーではない場合
-        fprintf(stderr,
-                "Warning: get_opponent_sock called by non-player (sock %d) for "
-                "room %d.\n",
-                self_sock, roomId);
+        LOG_WARN(
+            "Warning: get_opponent_sock called by non-player (sock %d) for "
+            "room %d.",
+            self_sock, roomId);
     }
 
-    pthread_mutex_unlock(&rooms[room_idx].room_mutex);
+    pthread_mutex_unlock(&room->room_mutex);
     return opponent_sock;
 }
\ No newline at end of file
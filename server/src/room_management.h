@@ -2,22 +2,48 @@
 #define ROOM_MANAGEMENT_H
 
 #include "server_common.h"
+#include "snapshot.h"  // SnapshotRoom
 
 // --- グローバル変数 (extern宣言) ---
-extern Room rooms[MAX_ROOMS];
-extern pthread_mutex_t rooms_mutex;
-extern int room_id_counter;
+extern pthread_mutex_t rooms_mutex;  // 部屋の空きリストとプールの伸長専用
+extern int room_capacity;            // 最大部屋数 (起動後は変わらない)
+
+// roomId からスロット番号を求める (roomId = 世代 * 最大部屋数 + スロット番号)
+#define ROOM_SLOT(roomId) ((roomId) % room_capacity)
 
 // --- 関数プロトタイプ ---
-void initialize_rooms();
+// 部屋リストを初期化する (max_rooms: 部屋数の上限)
+// 部屋は作成されるたびに ROOM_POOL_CHUNK 単位で確保する。戻り値: 失敗時 -1
+int initialize_rooms(int max_rooms);
 int find_room_index(int roomId);
+// roomId の部屋の room_mutex をロックして返す (rooms_mutex は取らない)
+// 存在しない・閉鎖済みの roomId なら NULL。呼び出し元で room_mutex を解放する
+Room* acquire_room(int roomId);
 int find_empty_room_index();
 int create_new_room(int client_sock, const char* roomName);
+// 部屋のタイムアウトを seconds 秒後に設定し直す / 取り消す (room_mutex
+// ロック中に呼ぶ)。満了すると handle_room_timeout が呼ばれる
+void arm_room_timer(Room* room, int seconds);
+void cancel_room_timer(Room* room);
 int join_room(int client_sock, int targetRoomId);
+// 待機中の部屋にプレイヤー2として AI を座らせる (client_sock は作成者)
+// 戻り値: 成功時 roomId、-1: 部屋なし、-2: 満員・対戦中、-3: 作成者ではない
+int add_ai_player(int client_sock, int roomId, int move_time_ms);
 void close_room(int roomId, const char* reason);
 void broadcast_to_room(int roomId, const Message* msg, int exclude_sock);
 int get_opponent_sock(int roomId, int self_sock);
 Room* get_room_by_id(int roomId);
+// 確保済みのスロット数と、使用中の部屋の一覧 (部屋一覧のスナップショット用)
+int room_slot_count();
+int collect_room_list(RoomListEntry* entries, int max_entries);
+// 対局中・再開待ちの部屋をスナップショット用に書き出す。戻り値: 件数
+int collect_room_snapshots(SnapshotRoom* entries, int max_entries);
+// 使用中の部屋を状態 (RoomStatus) ごとに数える (計測値用)
+// counts は ROOM_SUSPENDED + 1 要素。各部屋の room_mutex を順に短く取る
+void count_rooms_by_status(int* counts);
+// 再起動時の復元用に roomId のスロットを確保し、room_mutex をロックして返す
+// (ゲーム状態などは呼び出し元で設定する)。使えないスロットなら NULL
+Room* restore_room(int roomId);
 
 void handle_chat_message(int client_sock, int roomId, const char* message_text);
 
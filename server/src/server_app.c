@@ -1,126 +1,235 @@
-#include "client_handler.h"     // クライアントハンドラ
+#include <getopt.h>
+#include <signal.h>
+
+#include "ai_eval.h"            // AI の局面評価
+#include "ai_worker.h"          // AI の思考スレッド
+#include "book.h"               // 定石ファイル
+#include "client_handler.h"     // AI の着手・棋譜解析の結果
 #include "client_management.h"  // クライアント管理
+#include "endgame.h"            // 終盤の完全読み
+#include "event_loop.h"         // epoll イベントループ
+#include "game_log.h"           // 棋譜ログ
+#include "game_logic.h"         // Zobrist ハッシュ
+#include "lobby.h"              // 部屋一覧
+#include "logger.h"             // 非同期ロガー
+#include "metrics.h"            // 計測値
+#include "metrics_http.h"       // 計測値の HTTP エンドポイント
 #include "room_management.h"    // 部屋管理
 #include "server_common.h"      // 共通定義
+#include "snapshot.h"           // 対局中の部屋の保存と復元
+#include "transposition.h"      // AI の置換表
+
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-t reactor_threads] [-r] [-R max_rooms] "
+            "[-C max_clients] [-A ai_threads] [-H hash_mb] [-E empties] "
+            "[-B book] [-L game_log] [-S snapshot] [-M metrics_port] "
+            "[-l level]\n"
+            "  -p, --port         待ち受けポート (既定: %d)\n"
+            "  -t, --threads      リアクタスレッド数 (既定: %d)\n"
+            "  -r, --reuseport    SO_REUSEPORT でリアクタごとに待ち受ける\n"
+            "  -R, --max-rooms    最大部屋数 (既定: %d)\n"
+            "  -C, --max-clients  最大同時接続数 (既定: %d)\n"
+            "  -A, --ai-threads   AI の思考スレッド数 (既定: %d)\n"
+            "  -H, --hash-mb      AI の置換表の大きさ MiB (既定: %d)\n"
+            "  -E, --endgame-empties  空きマスがこれ以下なら完全読み "
+            "(0-%d, 既定: %d)\n"
+            "  -B, --book         AI の定石ファイル (既定: 使わない)\n"
+            "  -L, --game-log     終局した棋譜を追記するファイル "
+            "(既定: 記録しない)\n"
+            "  -S, --snapshot     対局中の部屋を保存し、起動時に復元するファイル "
+            "(既定: 使わない)\n"
+            "  -M, --metrics-port 計測値を返す 127.0.0.1 のポート "
+            "(既定: 使わない)\n"
+            "  -l, --log-level    ログの最低レベル debug/info/warn/error "
+            "(既定: info)\n",
+            prog, SERVER_PORT, DEFAULT_REACTOR_THREADS, DEFAULT_MAX_ROOMS,
+            DEFAULT_MAX_CLIENTS, DEFAULT_AI_THREADS, DEFAULT_TT_SIZE_MB,
+            ENDGAME_MAX_EMPTIES, DEFAULT_ENDGAME_EMPTIES);
+}
 
 // --- main関数 ---
-int main() {
-    int server_sock, client_sock;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-
-    // サーバーと部屋の初期化
-    initialize_clients();  // client_management.c
-    initialize_rooms();    // room_management.c
-
-    // ソケット作成
-    server_sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_sock < 0) {
-        perror("socket creation failed");
+int main(int argc, char* argv[]) {
+    int port = SERVER_PORT;
+    int reactor_threads = DEFAULT_REACTOR_THREADS;
+    int reuse_port = 0;
+    int max_rooms = DEFAULT_MAX_ROOMS;
+    int max_clients = DEFAULT_MAX_CLIENTS;
+    int ai_threads = DEFAULT_AI_THREADS;
+    int hash_mb = DEFAULT_TT_SIZE_MB;
+    const char* book_path = NULL;
+    const char* game_log_path = NULL;
+    const char* snapshot_path = NULL;
+    int metrics_port = 0;
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);  // 起動から受付開始までを計る
+
+    static const struct option long_options[] = {
+        {"port", required_argument, NULL, 'p'},
+        {"threads", required_argument, NULL, 't'},
+        {"reuseport", no_argument, NULL, 'r'},
+        {"max-rooms", required_argument, NULL, 'R'},
+        {"max-clients", required_argument, NULL, 'C'},
+        {"ai-threads", required_argument, NULL, 'A'},
+        {"hash-mb", required_argument, NULL, 'H'},
+        {"endgame-empties", required_argument, NULL, 'E'},
+        {"book", required_argument, NULL, 'B'},
+        {"game-log", required_argument, NULL, 'L'},
+        {"snapshot", required_argument, NULL, 'S'},
+        {"metrics-port", required_argument, NULL, 'M'},
+        {"log-level", required_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:t:rR:C:A:H:E:B:L:S:M:l:h",
+                              long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 't':
+                reactor_threads = atoi(optarg);
+                break;
+            case 'r':
+                reuse_port = 1;
+                break;
+            case 'R':
+                max_rooms = atoi(optarg);
+                break;
+            case 'C':
+                max_clients = atoi(optarg);
+                break;
+            case 'A':
+                ai_threads = atoi(optarg);
+                break;
+            case 'H':
+                hash_mb = atoi(optarg);
+                break;
+            case 'E':
+                endgame_empties = atoi(optarg);
+                break;
+            case 'B':
+                book_path = optarg;
+                break;
+            case 'L':
+                game_log_path = optarg;
+                break;
+            case 'S':
+                snapshot_path = optarg;
+                break;
+            case 'M':
+                metrics_port = atoi(optarg);
+                break;
+            case 'l':
+                log_level = log_level_from_name(optarg);
+                break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (port <= 0 || port > 65535 || reactor_threads < 1 || max_rooms < 1 ||
+        max_clients < 1 || ai_threads < 1 || hash_mb < 1 ||
+        endgame_empties < 0 || endgame_empties > ENDGAME_MAX_EMPTIES ||
+        metrics_port < 0 || metrics_port > 65535 || log_level < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // 切断済みソケットへの送信でプロセスが落ちないようにする
+    signal(SIGPIPE, SIG_IGN);
+
+    // 計測値を SIGUSR1 で表示するスレッド (metrics.c)
+    // シグナルのマスクを後から作るスレッドに引き継がせるため最初に起動する
+    if (metrics_start() < 0) {
+        LOG_ERROR("Failed to start metrics.");
         exit(EXIT_FAILURE);
     }
 
-    // アドレス再利用設定 (任意)
-    int opt = 1;
-    if (setsockopt(server_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) <
-        0) {
-        perror("setsockopt(SO_REUSEADDR) failed");
-        // 致命的ではない場合が多いので続行してもよい
+    // ログを書き出すスレッド (logger.c)。以降のログは呼び出し側では書かない
+    if (log_start() < 0) {
+        LOG_ERROR("Failed to start logger.");
+        exit(EXIT_FAILURE);
     }
 
-    // サーバーアドレス設定
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(SERVER_PORT);
-
-    // バインド
-    if (bind(server_sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) <
-        0) {
-        perror("bind failed");
-        close(server_sock);
+    // サーバーと部屋の初期化 (実体は使われた分だけ後から確保する)
+    if (initialize_clients(max_clients) < 0 ||  // client_management.c
+        initialize_rooms(max_rooms) < 0) {      // room_management.c
+        LOG_ERROR("Failed to initialize client/room pools.");
         exit(EXIT_FAILURE);
     }
 
-    // リッスン
-    if (listen(server_sock, 5) < 0) {  // backlogを調整可能 (例: 10)
-        perror("listen failed");
-        close(server_sock);
+    // 部屋のタイムアウトを処理するタイマースレッド (timer_wheel.c)
+    if (timer_wheel_start() < 0) {
+        LOG_ERROR("Failed to start timer wheel.");
         exit(EXIT_FAILURE);
     }
 
-    printf("Server listening on port %d\n", SERVER_PORT);
+    // 終局した棋譜を書き出すスレッド (game_log.c)
+    if (game_log_path != NULL && game_log_open(game_log_path) < 0) {
+        LOG_ERROR("Failed to open game log.");
+        exit(EXIT_FAILURE);
+    }
 
-    // クライアント接続受付ループ
-    while (1) {
-        client_sock =
-            accept(server_sock, (struct sockaddr*)&client_addr, &client_len);
-        if (client_sock < 0) {
-            perror("accept failed");
-            // accept のエラーはリカバリ可能かもしれないが、ループを続ける
-            continue;
-        }
+    // 部屋一覧の初期スナップショット (lobby.c)
+    if (lobby_init() < 0) {
+        LOG_ERROR("Failed to initialize lobby.");
+        exit(EXIT_FAILURE);
+    }
 
-        printf("Client connected from %s:%d (assigned sockfd: %d)\n",
-               inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port),
-               client_sock);
-
-        // クライアント情報を追加
-        int client_index = add_client(client_sock, client_addr);
-
-        if (client_index >= 0) {
-            // スレッドに渡す引数として sockfd のポインタを作成
-            // ClientInfo構造体全体を渡すより、変更される可能性が少ないsockfdを渡す方が安全
-            int* client_sock_ptr = malloc(sizeof(int));
-            if (client_sock_ptr == NULL) {
-                perror("Failed to allocate memory for client socket argument");
-                remove_client(client_sock);  // 追加したクライアント情報を削除
-                close(client_sock);
-                continue;  // 次の接続を待つ
-            }
-            *client_sock_ptr = client_sock;
-
-            // ハンドラースレッドを作成 (client_handler.c の関数を呼び出し)
-            pthread_t thread_id;
-            if (pthread_create(&thread_id, NULL, handle_client,
-                               (void*)client_sock_ptr) != 0) {
-                perror("pthread_create failed");
-                free(client_sock_ptr);       // メモリ解放
-                remove_client(client_sock);  // 追加したクライアント情報を削除
-                close(client_sock);
-            } else {
-                // スレッドIDをClientInfoに保存する場合
-                // (add_client内で行う方が良いかも)
-                // pthread_mutex_lock(&clients_mutex);
-                // clients[client_index].thread_id = thread_id;
-                // pthread_mutex_unlock(&clients_mutex);
-
-                // スレッドはデタッチされるので join しない
-                printf("Handler thread created for client sockfd %d\n",
-                       client_sock);
-            }
-
-        } else {
-            fprintf(
-                stderr,
-                "Failed to add client (server full?): closing connection %d\n",
-                client_sock);
-            // TODO: サーバー満員通知をクライアントに送信する (オプション)
-            // Message full_msg; full_msg.type = MSG_ERROR_NOTICE; ...
-            // sendMessage(...);
-            close(client_sock);
-        }
-    }  // end while(1)
+    // AI の探索を受け持つワーカースレッド (ai_worker.c) と共有の置換表
+    zobrist_init();
+    ai_eval_init();
+    if (tt_init(hash_mb) < 0) {
+        LOG_ERROR("Failed to allocate transposition table.");
+        exit(EXIT_FAILURE);
+    }
+    if (book_path != NULL && book_open(book_path) < 0) {
+        LOG_ERROR("Failed to load opening book.");
+        exit(EXIT_FAILURE);
+    }
+    if (ai_worker_start(ai_threads, handle_ai_move,
+                        handle_analysis_result) < 0) {
+        LOG_ERROR("Failed to start AI workers.");
+        exit(EXIT_FAILURE);
+    }
+
+    // 前回の対局を復元してから、定期的な保存を始める (snapshot.c)
+    // 復元した部屋は対局者の再接続 (MSG_RESUME_REQUEST) を待つ
+    if (snapshot_path != NULL && (snapshot_restore(snapshot_path) < 0 ||
+                                  snapshot_start(snapshot_path) < 0)) {
+        LOG_ERROR("Failed to restore or start snapshots.");
+        exit(EXIT_FAILURE);
+    }
+
+    // 計測値の HTTP エンドポイント (metrics_http.c)
+    if (metrics_port != 0 && metrics_http_start(metrics_port) < 0) {
+        LOG_ERROR("Failed to start metrics endpoint.");
+        exit(EXIT_FAILURE);
+    }
+
+    struct timespec ready;
+    clock_gettime(CLOCK_MONOTONIC, &ready);
+    LOG_INFO("Startup took %.1f ms.",
+             (ready.tv_sec - started.tv_sec) * 1000.0 +
+                 (ready.tv_nsec - started.tv_nsec) / 1e6);
+
+    // クライアント接続受付・受信ループ (event_loop.c)
+    // 接続ごとにスレッドを作らず、リアクタスレッドが全接続を多重化する
+    if (run_event_loop(port, reactor_threads, reuse_port) < 0) {
+        LOG_ERROR("Failed to start event loop.");
+        exit(EXIT_FAILURE);
+    }
 
     // 通常はここに到達しないが、終了処理
-    printf("Shutting down server...\n");
-    close(server_sock);
+    LOG_INFO("Shutting down server...");
     // TODO: 残っているクライアントへの通知、スレッドの終了待ち、リソース解放
     // (例: 全ての部屋を閉鎖、ミューテックスの破棄など)
-    // for (int i=0; i<MAX_ROOMS; ++i)
-    // pthread_mutex_destroy(&rooms[i].room_mutex);
+    // for (int i=0; i<room_capacity; ++i)
+    // pthread_mutex_destroy(&room->room_mutex);
     // pthread_mutex_destroy(&rooms_mutex);
     // pthread_mutex_destroy(&clients_mutex);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -12,13 +12,24 @@
 #include <time.h>
 #include <unistd.h>
 
-#include "protocol.h"  // 共通プロトコルヘッダー
+#include "protocol.h"     // 共通プロトコルヘッダー
+#include "timer_wheel.h"  // 部屋のタイムアウト
 
 // --- 定数定義 ---
-#define MAX_CLIENTS 100         // 最大同時接続クライアント数 (部屋数*2以上)
-#define MAX_ROOMS 50            // 最大部屋数
+// 上限は起動時に --max-clients / --max-rooms で変更できる
+#define DEFAULT_MAX_CLIENTS 100  // 最大同時接続クライアント数の既定値
+#define DEFAULT_MAX_ROOMS 50     // 最大部屋数の既定値
+#define CLIENT_POOL_CHUNK 64     // クライアント情報を確保する単位
+#define ROOM_POOL_CHUNK 16       // 部屋を確保する単位
 #define SERVER_PORT 10000       // サーバーポート番号
-#define REMATCH_TIMEOUT_SEC 30  // 再戦受付時間（秒）
+#define DEFAULT_REACTOR_THREADS 1  // イベントループのスレッド数 (既定値)
+#define AI_PLAYER_SOCK -2  // AI が座っている席のソケット値 (送信先なし)
+
+// --- 部屋のタイムアウト (timer_wheel.c のタイマーで処理) ---
+#define REMATCH_TIMEOUT_SEC 30        // 再戦受付時間（秒）
+#define WAITING_ROOM_TIMEOUT_SEC 600  // 対戦が始まらない部屋を閉じるまで（秒）
+#define TURN_TIMEOUT_SEC 120          // 1手の持ち時間（秒）
+#define RESUME_TIMEOUT_SEC 120  // 復元した対局に対局者が戻るまで（秒）
 
 // --- チャット機能用定数 ---
 #define MAX_CHAT_MESSAGE_LEN 256  // チャットメッセージ本文の最大長
@@ -31,8 +42,10 @@ typedef struct {
     int sockfd;
     struct sockaddr_in addr;
     int roomId;  // 参加中の部屋ID (-1ならロビー)
-    pthread_t thread_id;
+    struct Connection* conn;  // 入出力コンテキスト (event_loop.c で管理)
     int playerColor;  // 1:黒, 2:白, 0:未定
+    int wants_board_delta;  // 1なら着手を MSG_BOARD_DELTA_NOTICE で送る
+    int next_free;  // 空きリストの次の添字 (clients_mutex で保護)
     // 必要ならユーザー名なども追加
 } ClientInfo;
 
@@ -40,6 +53,19 @@ typedef struct {
 typedef struct {
     uint8_t board[BOARD_SIZE][BOARD_SIZE];  // 0:空, 1:黒, 2:白
     uint8_t currentTurn;                    // 1:黒, 2:白
+    // ビットボード表現 (bit r*8+c が (r, c) に対応)。board と常に同期させる
+    uint64_t black;  // 黒石のあるマス
+    uint64_t white;  // 白石のあるマス
+    // 着手ごとに update_board が更新するキャッシュ (判定・集計を O(1) にする)
+    uint64_t legal_black;  // 黒の合法手
+    uint64_t legal_white;  // 白の合法手
+    int black_count;       // 黒石の数
+    int white_count;       // 白石の数
+    int move_seq;          // 着手の通し番号 (ゲーム開始時 0)
+    uint64_t last_flips;   // 直前の着手で裏返った石 (差分通知用)
+    uint64_t hash;         // 石の配置の Zobrist ハッシュ (手番は含まない)
+    // 着手したマス (r * 8 + c) の列。move_history[i] が i + 1 手目 (パスは含まない)
+    uint8_t move_history[BOARD_SIZE * BOARD_SIZE];
     // ゲームの状態 (手数、パス状況など) を追加
 } GameState;
 
@@ -49,34 +75,48 @@ typedef enum {
     ROOM_WAITING,    // 1人待機中
     ROOM_PLAYING,    // 対戦中
     ROOM_GAMEOVER,   // ゲーム終了 (再戦待ち)
-    ROOM_REMATCHING  // 再戦同意待ち
+    ROOM_REMATCHING,  // 再戦同意待ち
+    ROOM_SUSPENDED    // 再起動で復元した対局 (対局者の再接続待ち)
 } RoomStatus;
 
 // チャットメッセージ履歴用構造体
+// 送信者の色と表示名は追加時に確定させ、履歴送信時には引き直さない
 typedef struct {
-    int sender_sock;  // 送信者のソケットディスクリプタ
-                      // (特定用、表示名は別途解決)
-    // int sender_player_color; //必要なら追加
+    int sender_sock;          // 送信者のソケットディスクリプタ
+    int sender_player_color;  // 0: 不明, 1: プレイヤー1, 2: プレイヤー2
+    char sender_display_name[MAX_ROOM_NAME_LEN];
     char message[MAX_CHAT_MESSAGE_LEN];
     time_t timestamp;
 } ChatMessageEntry;
 
+// 部屋のチャット履歴 (最初のチャットで確保し、部屋の閉鎖時に解放する)
+typedef struct {
+    ChatMessageEntry entries[MAX_CHAT_HISTORY];  // リングバッファ
+    int count;     // 現在保存されている有効な履歴の件数
+    int next_idx;  // 次に書き込む entries 配列のインデックス
+} ChatHistory;
+
 // 部屋情報
 typedef struct {
-    int roomId;
+    int roomId;      // 世代 * 最大部屋数 + スロット番号 (-1なら未使用)
+    int generation;  // このスロットが部屋を割り当てた回数 (roomId の再利用防止)
     char roomName[MAX_ROOM_NAME_LEN];
     RoomStatus status;
     int player1_sock;  // プレイヤー1のソケットディスクリプタ (-1なら不在)
     int player2_sock;  // プレイヤー2のソケットディスクリプタ (-1なら不在)
+                       // AI_PLAYER_SOCK なら AI が白番を受け持つ
+    int ai_move_time_ms;  // AI の1手の思考時間 (player2 が AI のときのみ)
+    // 再起動後に席を取り戻すための合言葉 [色 - 1] (対局開始時に発行、AI は 0)
+    uint64_t resume_token[2];
+    int analysis_pending;  // 棋譜解析を依頼中なら 1 (1部屋につき1件まで)
     GameState gameState;
     pthread_mutex_t room_mutex;  // 各部屋ごとのミューテックス
-    time_t last_action_time;     // タイムアウト処理用
+    time_t last_action_time;     // 最後に操作があった時刻
+    TimerEntry timer;  // 状態ごとのタイムアウト (待機・手番・再戦受付)
     int player1_rematch_agree;   // 0:未返答, 1:Yes, 2:No
     int player2_rematch_agree;   // 0:未返答, 1:Yes, 2:No
-
-    ChatMessageEntry chat_history[MAX_CHAT_HISTORY];  // リングバッファ
-    int chat_history_count;     // 現在保存されている有効な履歴の件数
-    int chat_history_next_idx;  // 次に書き込む chat_history 配列のインデックス
+    ChatHistory* chat;           // チャット履歴 (NULLなら履歴なし)
+    int next_free;  // 空きリストの次のスロット (rooms_mutex で保護)
 } Room;
 
 #endif  // SERVER_COMMON_H
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "slab_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "logger.h"
+
+int slab_pool_init(SlabPool* pool, size_t elem_size, int chunk_size,
+                   int max_elems) {
+    if (elem_size == 0 || chunk_size <= 0 || max_elems <= 0) {
+        return -1;
+    }
+    int num_chunks = (max_elems + chunk_size - 1) / chunk_size;
+    pool->chunks = calloc(num_chunks, sizeof(uint8_t*));
+    if (pool->chunks == NULL) {
+        LOG_ERROR("Failed to allocate slab pool chunk table: %m");
+        return -1;
+    }
+    pool->elem_size = elem_size;
+    pool->chunk_size = chunk_size;
+    pool->max_elems = max_elems;
+    pool->num_elems = 0;
+    return 0;
+}
+
+int slab_pool_grow(SlabPool* pool, void (*init_elem)(void* elem, int index)) {
+    int first = pool->num_elems;
+    if (first >= pool->max_elems) {
+        return -1;  // 上限に達している
+    }
+    // 最後のチャンクは上限までに切り詰める
+    int count = pool->max_elems - first;
+    if (count > pool->chunk_size) {
+        count = pool->chunk_size;
+    }
+    uint8_t* chunk = calloc(count, pool->elem_size);
+    if (chunk == NULL) {
+        LOG_ERROR("Failed to grow slab pool: %m");
+        return -1;
+    }
+    // 大きい添字から初期化する (空きリストに積むと小さい添字から使われる)
+    for (int i = count - 1; i >= 0; --i) {
+        if (init_elem != NULL) {
+            init_elem(chunk + (size_t)i * pool->elem_size, first + i);
+        }
+    }
+    // 要素を初期化し終えてから公開する (slab_pool_at はロックなしで読む)
+    __atomic_store_n(&pool->chunks[first / pool->chunk_size], chunk,
+                     __ATOMIC_RELEASE);
+    __atomic_store_n(&pool->num_elems, first + count, __ATOMIC_RELEASE);
+    return first;
+}
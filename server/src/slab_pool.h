@@ -0,0 +1,48 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- 固定サイズ要素のスラブプール ---
+// 要素をチャンク単位で必要になった時に確保し、上限 (max_elems) まで伸ばす。
+// 確保済みのチャンクは解放も移動もしないので、要素へのポインタは常に有効で、
+// 添字からの参照 (slab_pool_at) はロックなしで行える。
+// 伸長 (slab_pool_grow) は呼び出し側で排他すること。
+typedef struct {
+    size_t elem_size;  // 要素1個のバイト数
+    int chunk_size;    // 1チャンクあたりの要素数
+    int max_elems;     // 要素数の上限 (起動時に指定)
+    int num_elems;     // 確保済みの要素数 (__atomic で公開)
+    uint8_t** chunks;  // チャンクへのポインタ表 (起動時に上限分だけ確保)
+} SlabPool;
+
+// プールを初期化する (チャンクはまだ確保しない)。戻り値: 失敗時 -1
+int slab_pool_init(SlabPool* pool, size_t elem_size, int chunk_size,
+                   int max_elems);
+
+// 1チャンク分伸ばす。init_elem で新しい要素を初期化してから公開する
+// (init_elem は添字の大きい順に呼ぶ)
+// 戻り値: 追加した先頭要素の添字、上限到達・確保失敗なら -1
+int slab_pool_grow(SlabPool* pool, void (*init_elem)(void* elem, int index));
+
+// 添字 index の要素を返す (未確保なら NULL)。ロック不要
+static inline void* slab_pool_at(const SlabPool* pool, int index) {
+    if (index < 0 || index >= pool->max_elems) {
+        return NULL;
+    }
+    uint8_t* chunk =
+        __atomic_load_n(&pool->chunks[index / pool->chunk_size],
+                        __ATOMIC_ACQUIRE);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    return chunk + (size_t)(index % pool->chunk_size) * pool->elem_size;
+}
+
+// 確保済みの要素数を返す
+static inline int slab_pool_count(const SlabPool* pool) {
+    return __atomic_load_n(&pool->num_elems, __ATOMIC_ACQUIRE);
+}
+
+#endif  // SLAB_POOL_H
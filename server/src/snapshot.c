@@ -0,0 +1,216 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <libgen.h>  // dirname
+#include <sys/stat.h>
+
+#include "game_logic.h"
+#include "lobby.h"
+#include "logger.h"
+#include "room_management.h"
+
+static char snapshot_path[4096];
+static pthread_t snapshot_thread_id;
+
+// 書き出しに使うバッファ (スナップショットスレッド専用、最大部屋数分)
+static SnapshotRoom* current_rooms = NULL;
+static SnapshotRoom* written_rooms = NULL;  // 前回書き出した内容
+static int written_count = -1;             // -1 ならまだ書き出していない
+
+// 部分書き込み・シグナル割り込みを考慮して len バイトすべて書く
+static int write_all(int fd, const void* buf, size_t len) {
+    const uint8_t* p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// rename を確定させるため、ファイルのあるディレクトリを fsync する
+static void sync_parent_dir(const char* path) {
+    char dir[sizeof(snapshot_path)];
+    snprintf(dir, sizeof(dir), "%s", path);
+    int fd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// count 部屋分を一時ファイルに書き、rename で置き換える
+static int write_snapshot(const SnapshotRoom* rooms, int count) {
+    char tmp_path[sizeof(snapshot_path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", snapshot_path);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.room_count = count;
+    header.room_capacity = room_capacity;
+    header.saved_at = (uint64_t)time(NULL);
+
+    // 再開用の合言葉を含むので、所有者だけが読めるようにする
+    // (前回の一時ファイルが残っていても権限を付け直す)
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fchmod(fd, 0600) < 0 || write_all(fd, &header, sizeof(header)) < 0 ||
+        write_all(fd, rooms, (size_t)count * sizeof(SnapshotRoom)) < 0 ||
+        fdatasync(fd) < 0) {
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp_path, snapshot_path) < 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    sync_parent_dir(snapshot_path);
+    return 0;
+}
+
+// SNAPSHOT_INTERVAL_MS ごとに部屋を写し取り、変化があれば書き出す
+static void* snapshot_thread(void* arg) {
+    (void)arg;
+    struct timespec interval = {SNAPSHOT_INTERVAL_MS / 1000,
+                                (SNAPSHOT_INTERVAL_MS % 1000) * 1000000L};
+    for (;;) {
+        nanosleep(&interval, NULL);
+
+        int count = collect_room_snapshots(current_rooms, room_capacity);
+        if (count == written_count &&
+            memcmp(current_rooms, written_rooms,
+                   (size_t)count * sizeof(SnapshotRoom)) == 0) {
+            continue;  // 前回から変化なし
+        }
+        if (write_snapshot(current_rooms, count) < 0) {
+            LOG_ERROR("Failed to write snapshot: %m");
+            continue;
+        }
+        SnapshotRoom* swap = written_rooms;
+        written_rooms = current_rooms;
+        current_rooms = swap;
+        written_count = count;
+    }
+    return NULL;
+}
+
+int snapshot_start(const char* path) {
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s", path);
+    current_rooms = calloc(room_capacity, sizeof(SnapshotRoom));
+    written_rooms = calloc(room_capacity, sizeof(SnapshotRoom));
+    if (current_rooms == NULL || written_rooms == NULL) {
+        LOG_ERROR("Failed to allocate snapshot buffers: %m");
+        return -1;
+    }
+    if (pthread_create(&snapshot_thread_id, NULL, snapshot_thread, NULL) !=
+        0) {
+        LOG_ERROR("Failed to create snapshot thread: %m");
+        return -1;
+    }
+    pthread_detach(snapshot_thread_id);
+    LOG_INFO("Snapshot: saving live games to %s every %d ms.", path,
+             SNAPSHOT_INTERVAL_MS);
+    return 0;
+}
+
+// 1部屋分を復元する。着手列が打ち直せない部屋は復元しない
+// 戻り値: 復元できれば 0
+static int restore_one(const SnapshotRoom* e) {
+    if (e->move_count > BOARD_SIZE * BOARD_SIZE) {
+        return -1;
+    }
+    Room* room = restore_room(e->roomId);
+    if (room == NULL) {
+        return -1;
+    }
+    if (replay_moves(&room->gameState, e->moves, e->move_count) < 0 ||
+        room->gameState.currentTurn != e->current_turn) {
+        pthread_mutex_unlock(&room->room_mutex);
+        close_room(e->roomId, "Snapshot is inconsistent.");
+        return -1;
+    }
+    memcpy(room->roomName, e->roomName, MAX_ROOM_NAME_LEN);
+    room->roomName[MAX_ROOM_NAME_LEN - 1] = '\0';
+    if (e->white_ai) {
+        room->player2_sock = AI_PLAYER_SOCK;
+        room->ai_move_time_ms = e->ai_move_time_ms;
+    }
+    room->resume_token[0] = e->resume_token[0];
+    room->resume_token[1] = e->resume_token[1];
+    room->status = ROOM_SUSPENDED;
+    arm_room_timer(room, RESUME_TIMEOUT_SEC);  // 戻らなければ閉じる
+    pthread_mutex_unlock(&room->room_mutex);
+
+    LOG_INFO("Restored room %d ('%s') at move %d, waiting for players.",
+             e->roomId, e->roomName, e->move_count);
+    return 0;
+}
+
+int snapshot_restore(const char* path) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return 0;  // 初回の起動
+        }
+        LOG_ERROR("Failed to open snapshot: %m");
+        return -1;
+    }
+    SnapshotHeader header;
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        read(fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        (size_t)st.st_size !=
+            sizeof(header) + (size_t)header.room_count * sizeof(SnapshotRoom)) {
+        LOG_ERROR("Snapshot %s is corrupt.", path);
+        close(fd);
+        return -1;
+    }
+    if ((int)header.room_capacity != room_capacity) {
+        // roomId からスロットを求める式が変わるので復元できない
+        LOG_ERROR("Snapshot %s was saved with --max-rooms %u (now %d); "
+                  "not restoring.",
+                  path, header.room_capacity, room_capacity);
+        close(fd);
+        return 0;
+    }
+
+    int restored = 0;
+    SnapshotRoom entry;
+    for (uint32_t i = 0; i < header.room_count; ++i) {
+        if (read(fd, &entry, sizeof(entry)) != sizeof(entry)) {
+            LOG_ERROR("Snapshot %s is truncated.", path);
+            break;
+        }
+        if (restore_one(&entry) == 0) {
+            ++restored;
+        } else {
+            LOG_ERROR("Skipped room %d in snapshot.", entry.roomId);
+        }
+    }
+    close(fd);
+    if (restored > 0) {
+        lobby_mark_dirty();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start.tv_sec) * 1000.0 +
+                (end.tv_nsec - start.tv_nsec) / 1e6;
+    LOG_INFO("Snapshot: restored %d of %u game(s) from %s in %.1f ms.",
+             restored, header.room_count, path, ms);
+    return restored;
+}
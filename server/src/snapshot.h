@@ -0,0 +1,51 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "server_common.h"
+
+// --- 対局中の部屋のスナップショット ---
+// 対局中の部屋 (部屋名・AI の設定・再開用の合言葉・着手列) を定期的に
+// ファイルへ書き出し、再起動時に読み込んで対局を復元する。
+// 専用スレッドが各部屋の room_mutex を短く取って内容を写し取り、ロックを
+// 離してから一時ファイルに書いて rename で置き換える。書き込み中に
+// 止まっても前回のスナップショットが残り、対局の処理はディスクを待たない。
+// 盤面は保存せず、復元時に着手列を初期局面から打ち直して作り直す
+// (ハッシュや合法手のキャッシュも同時にそろう)。
+// 数値はネイティブ形式で書く (同じマシンでの再起動用)。
+
+#define SNAPSHOT_MAGIC "OTHSNAP1"    // ファイル先頭の識別子 (8 バイト)
+#define SNAPSHOT_INTERVAL_MS 1000    // 書き出しの間隔 (変化がなければ書かない)
+
+// ファイルヘッダ (24 バイト)
+typedef struct {
+    char magic[8];           // SNAPSHOT_MAGIC
+    uint32_t room_count;     // 後に続く SnapshotRoom の数
+    uint32_t room_capacity;  // 書き出したときの最大部屋数 (roomId の解釈に使う)
+    uint64_t saved_at;       // 書き出した時刻 (UNIX 時間、秒)
+} SnapshotHeader;
+
+// 対局中の部屋1つ分 (128 バイト)
+typedef struct {
+    int32_t roomId;
+    int32_t ai_move_time_ms;  // 白番が AI のときの1手の思考時間
+    uint64_t resume_token[2];
+    char roomName[MAX_ROOM_NAME_LEN];
+    uint8_t white_ai;      // 1 なら白番は AI
+    uint8_t current_turn;  // 次の手番 (着手列からの再生結果と照合する)
+    uint8_t move_count;
+    uint8_t reserved[5];
+    uint8_t moves[BOARD_SIZE * BOARD_SIZE];  // 着手したマス (パスは含まない)
+} SnapshotRoom;
+
+_Static_assert(sizeof(SnapshotHeader) == 24, "SnapshotHeader must be 24 bytes");
+_Static_assert(sizeof(SnapshotRoom) == 128, "SnapshotRoom must be 128 bytes");
+
+// path のスナップショットから対局を復元する (イベントループの開始前に呼ぶ)
+// 復元した部屋は ROOM_SUSPENDED で対局者の再接続を待つ
+// 戻り値: 復元した部屋の数 (ファイルが無ければ 0)、読めなければ -1
+int snapshot_restore(const char* path);
+
+// path へ定期的に書き出すスレッドを起動する。戻り値: 失敗時 -1
+int snapshot_start(const char* path);
+
+#endif  // SNAPSHOT_H
@@ -0,0 +1,218 @@
+#include "timer_wheel.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+// 各スロットは番兵付きの循環リスト
+static TimerEntry wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static uint64_t current_tick = 0;  // 処理済みの tick
+static pthread_mutex_t wheel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t timer_thread_id;
+
+// 満了したタイマーの呼び出し情報 (ロックを離してから呼ぶために写し取る)
+typedef struct {
+    TimerCallback callback;
+    int id;
+    unsigned int seq;
+} FiredTimer;
+
+// --- リスト操作 (wheel_mutex ロック中に呼ぶ) ---
+
+static void list_unlink(TimerEntry* t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+}
+
+static void list_append(TimerEntry* head, TimerEntry* t) {
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+// level 段目が current_tick から見て受け持つ tick 数
+// (現在のスロットと重ならないよう 1 スロット分の余裕を残す)
+static uint64_t level_span(int level) {
+    uint64_t span = (uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1));
+    if (level == 0) {
+        return span;
+    }
+    return span - ((uint64_t)1 << (TIMER_WHEEL_BITS * level));
+}
+
+// expires に応じた段・スロットに入れる (wheel_mutex ロック中に呼ぶ)
+static void wheel_insert(TimerEntry* t) {
+    uint64_t delta = t->expires - current_tick;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (delta < level_span(level)) {
+            int slot = (t->expires >> (TIMER_WHEEL_BITS * level)) &
+                       TIMER_WHEEL_MASK;
+            list_append(&wheel[level][slot], t);
+            return;
+        }
+    }
+    // ホイールの範囲を超える満了は最上段の最後のスロットで待たせ、
+    // 降ろされた時点で入れ直す
+    int top = TIMER_WHEEL_LEVELS - 1;
+    int slot = ((current_tick >> (TIMER_WHEEL_BITS * top)) +
+                TIMER_WHEEL_SLOTS - 1) &
+               TIMER_WHEEL_MASK;
+    list_append(&wheel[top][slot], t);
+}
+
+// 上の段のスロットの中身を下の段へ降ろす (wheel_mutex ロック中に呼ぶ)
+static void wheel_cascade(int level) {
+    int slot = (current_tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    TimerEntry* head = &wheel[level][slot];
+    while (head->next != head) {
+        TimerEntry* t = head->next;
+        list_unlink(t);
+        wheel_insert(t);
+    }
+}
+
+// 1 tick 進め、満了したタイマーを fired に追加する (wheel_mutex ロック中)
+static void wheel_advance(FiredTimer** fired, size_t* count,
+                          size_t* capacity) {
+    current_tick++;
+    // 下位の桁が一周した段を上から順に降ろす
+    int top = 0;
+    while (top + 1 < TIMER_WHEEL_LEVELS &&
+           (current_tick &
+            (((uint64_t)1 << (TIMER_WHEEL_BITS * (top + 1))) - 1)) == 0) {
+        top++;
+    }
+    for (int level = top; level >= 1; --level) {
+        wheel_cascade(level);
+    }
+
+    TimerEntry* head = &wheel[0][current_tick & TIMER_WHEEL_MASK];
+    while (head->next != head) {
+        TimerEntry* t = head->next;
+        list_unlink(t);
+        if (t->expires > current_tick) {
+            wheel_insert(t);  // 念のため (範囲外から降りてきたもの)
+            continue;
+        }
+        t->armed = 0;
+        if (*count == *capacity) {
+            size_t new_cap = *capacity ? *capacity * 2 : 64;
+            FiredTimer* grown = realloc(*fired, new_cap * sizeof(FiredTimer));
+            if (grown == NULL) {
+                LOG_ERROR("Failed to grow fired timer list: %m");
+                continue;  // この満了は取りこぼす
+            }
+            *fired = grown;
+            *capacity = new_cap;
+        }
+        (*fired)[(*count)++] = (FiredTimer){t->callback, t->id, t->seq};
+    }
+}
+
+// --- タイマースレッド ---
+
+static void* timer_thread_main(void* arg) {
+    int tfd = (int)(intptr_t)arg;
+    FiredTimer* fired = NULL;
+    size_t capacity = 0;
+
+    while (1) {
+        uint64_t ticks;
+        ssize_t n = read(tfd, &ticks, sizeof(ticks));
+        if (n != sizeof(ticks)) {
+            if (n < 0 && errno == EINTR) continue;
+            LOG_ERROR("timerfd read failed: %m");
+            continue;
+        }
+
+        // 遅れた分もまとめて進める
+        size_t count = 0;
+        pthread_mutex_lock(&wheel_mutex);
+        for (uint64_t i = 0; i < ticks; ++i) {
+            wheel_advance(&fired, &count, &capacity);
+        }
+        pthread_mutex_unlock(&wheel_mutex);
+
+        for (size_t i = 0; i < count; ++i) {
+            fired[i].callback(fired[i].id, fired[i].seq);
+        }
+    }
+    return NULL;
+}
+
+int timer_wheel_start(void) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+            wheel[level][slot].prev = &wheel[level][slot];
+            wheel[level][slot].next = &wheel[level][slot];
+        }
+    }
+
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (tfd < 0) {
+        LOG_ERROR("timerfd_create failed: %m");
+        return -1;
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = TIMER_TICK_MS / 1000;
+    spec.it_interval.tv_nsec = (TIMER_TICK_MS % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(tfd, 0, &spec, NULL) < 0) {
+        LOG_ERROR("timerfd_settime failed: %m");
+        close(tfd);
+        return -1;
+    }
+
+    if (pthread_create(&timer_thread_id, NULL, timer_thread_main,
+                       (void*)(intptr_t)tfd) != 0) {
+        LOG_ERROR("Failed to create timer thread: %m");
+        close(tfd);
+        return -1;
+    }
+    pthread_detach(timer_thread_id);
+    LOG_INFO("Timer wheel started (tick %d ms).", TIMER_TICK_MS);
+    return 0;
+}
+
+// --- 登録・取り消し ---
+
+unsigned int timer_arm(TimerEntry* timer, int id, unsigned int delay_ms,
+                       TimerCallback callback) {
+    uint64_t delay_ticks = (delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    if (delay_ticks == 0) {
+        delay_ticks = 1;  // 次の tick で満了
+    }
+
+    pthread_mutex_lock(&wheel_mutex);
+    if (timer->armed) {
+        list_unlink(timer);
+    }
+    timer->seq++;
+    timer->id = id;
+    timer->callback = callback;
+    timer->expires = current_tick + delay_ticks;
+    timer->armed = 1;
+    wheel_insert(timer);
+    unsigned int seq = timer->seq;
+    pthread_mutex_unlock(&wheel_mutex);
+    return seq;
+}
+
+void timer_cancel(TimerEntry* timer) {
+    pthread_mutex_lock(&wheel_mutex);
+    if (timer->armed) {
+        list_unlink(timer);
+        timer->armed = 0;
+    }
+    timer->seq++;  // 満了処理中の通知を無効にする
+    pthread_mutex_unlock(&wheel_mutex);
+}
@@ -0,0 +1,51 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+// --- 階層タイマーホイール ---
+// TIMER_TICK_MS ごとに進む2段のホイールでタイムアウトを管理する。
+// 登録・取り消しは O(1) で、満了の処理も該当スロットだけを見るため、
+// 全部屋を定期的に走査する必要がない。専用スレッドが timerfd で時間を進め、
+// 満了したタイマーのコールバックをホイールのロックを離してから呼ぶ。
+
+#define TIMER_TICK_MS 100  // 1 tick の長さ (ミリ秒)
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)  // 1段あたりのスロット数
+#define TIMER_WHEEL_LEVELS 2  // 段数 (これより先の満了は最上段で待たせる)
+
+// 満了時に呼ばれる関数 (タイマースレッドから、ロックなしで呼ばれる)
+// id, seq は timer_arm に渡した値。seq が古ければ無視すること
+typedef void (*TimerCallback)(int id, unsigned int seq);
+
+// 所有者の構造体 (Room など) に埋め込んで使うタイマー
+// seq は timer_arm / timer_cancel のたびに進むので、所有者のロック下で
+// timer_is_current を呼べば、満了通知が最新の設定に対するものか判別できる
+typedef struct TimerEntry {
+    struct TimerEntry* prev;  // ホイールのスロット内の双方向リスト
+    struct TimerEntry* next;
+    uint64_t expires;  // 満了する tick
+    TimerCallback callback;
+    int id;            // コールバックに渡す識別子 (部屋IDなど)
+    unsigned int seq;  // 設定ごとに増える番号
+    int armed;         // 1 ならホイールに登録中
+} TimerEntry;
+
+// タイマースレッドを起動する。戻り値: 失敗時 -1
+int timer_wheel_start(void);
+
+// delay_ms ミリ秒後に callback(id, seq) を呼ぶよう登録する
+// 登録済みなら設定し直す。戻り値: 新しい seq
+unsigned int timer_arm(TimerEntry* timer, int id, unsigned int delay_ms,
+                       TimerCallback callback);
+
+// 登録を取り消す (すでに満了処理中の通知は seq が古くなり無視される)
+void timer_cancel(TimerEntry* timer);
+
+// seq が timer の最新の設定か (所有者のロック下で呼ぶ)
+static inline int timer_is_current(const TimerEntry* timer,
+                                   unsigned int seq) {
+    return timer->seq == seq;
+}
+
+#endif  // TIMER_WHEEL_H
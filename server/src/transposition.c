@@ -0,0 +1,142 @@
+#include "transposition.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "logger.h"
+
+// エントリ1個 (16 バイト)。check = キー ^ data
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} TtEntry;
+
+// 1バケット = 1キャッシュライン
+typedef struct {
+    TtEntry entries[TT_BUCKET_SIZE];
+} __attribute__((aligned(64))) TtBucket;
+
+// data のビット配置
+// [0, 16): 評価値 + TT_SCORE_BIAS / [16, 24): 深さ / [24, 32): 評価値の種類
+// [32, 40): 最善手 / [40, 48): 世代
+// 評価値に下駄を履かせるので、使用中のエントリの data は 0 にならない
+#define TT_SCORE_BIAS 32768
+#define DATA_SCORE(d) ((int)((d)&0xFFFF) - TT_SCORE_BIAS)
+#define DATA_DEPTH(d) ((int)(((d) >> 16) & 0xFF))
+#define DATA_BOUND(d) ((int)(((d) >> 24) & 0xFF))
+#define DATA_MOVE(d) ((int)(((d) >> 32) & 0xFF))
+#define DATA_GENERATION(d) ((uint8_t)((d) >> 40))
+
+// 置き換え先を選ぶときに、世代1つの古さを深さいくつ分とみなすか
+#define TT_AGE_WEIGHT 8
+
+static TtBucket* table = NULL;
+static uint64_t bucket_mask = 0;  // バケット数 - 1
+static uint8_t generation = 0;    // tt_new_search ごとに進む (__atomic)
+
+// 累計の参照回数 (__atomic で加算)
+static TtStats stats;
+
+static inline uint64_t pack_data(int depth, int bound, int score, int move,
+                                 uint8_t gen) {
+    return (uint64_t)(uint16_t)(score + TT_SCORE_BIAS) |
+           ((uint64_t)(uint8_t)depth << 16) |
+           ((uint64_t)(uint8_t)bound << 24) |
+           ((uint64_t)(uint8_t)move << 32) | ((uint64_t)gen << 40);
+}
+
+// エントリの2語を読み出す (片方ずつアトミックに読み、照合は呼び出し側で行う)
+static inline void load_entry(const TtEntry* e, uint64_t* check,
+                              uint64_t* data) {
+    *check = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+    *data = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+}
+
+int tt_init(size_t size_mb) {
+    size_t buckets = 1;
+    while (buckets * 2 * sizeof(TtBucket) <= size_mb * 1024 * 1024) {
+        buckets *= 2;
+    }
+    // 匿名マッピングは 0 で埋まったページを使うときに割り当てるので、
+    // 起動時に表全体を書いて回らずに済む (再起動から受付までを短くする)
+    void* map = mmap(NULL, buckets * sizeof(TtBucket), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Failed to allocate transposition table: %m");
+        return -1;
+    }
+    table = map;  // ページ境界なのでキャッシュラインにもそろう
+    bucket_mask = buckets - 1;
+    LOG_INFO("Transposition table: %zu buckets (%zu MiB).", buckets,
+             buckets * sizeof(TtBucket) / (1024 * 1024));
+    return 0;
+}
+
+void tt_new_search(void) {
+    __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+}
+
+int tt_probe(uint64_t key, TtResult* result) {
+    const TtBucket* bucket = &table[key & bucket_mask];
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        uint64_t check, data;
+        load_entry(&bucket->entries[i], &check, &data);
+        if (data != 0 && (check ^ data) == key) {
+            result->score = DATA_SCORE(data);
+            result->depth = DATA_DEPTH(data);
+            result->bound = DATA_BOUND(data);
+            result->move = DATA_MOVE(data);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void tt_store(uint64_t key, int depth, int bound, int score, int move) {
+    TtBucket* bucket = &table[key & bucket_mask];
+    uint8_t gen = __atomic_load_n(&generation, __ATOMIC_RELAXED);
+
+    // 同じ局面・空きエントリがあればそこへ、無ければ古く浅いものを置き換える
+    int victim = 0;
+    int victim_value = INT_MAX;
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        uint64_t check, data;
+        load_entry(&bucket->entries[i], &check, &data);
+        if (data == 0) {
+            victim = i;
+            break;
+        }
+        if ((check ^ data) == key) {
+            if (move == TT_NO_MOVE) {
+                move = DATA_MOVE(data);  // 以前の最善手は残す
+            }
+            victim = i;
+            break;
+        }
+        int value = DATA_DEPTH(data) -
+                    TT_AGE_WEIGHT * (uint8_t)(gen - DATA_GENERATION(data));
+        if (value < victim_value) {
+            victim = i;
+            victim_value = value;
+        }
+    }
+
+    uint64_t data = pack_data(depth, bound, score, move, gen);
+    TtEntry* e = &bucket->entries[victim];
+    __atomic_store_n(&e->data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->check, key ^ data, __ATOMIC_RELAXED);
+}
+
+void tt_add_stats(uint64_t probes, uint64_t hits, uint64_t stores) {
+    __atomic_add_fetch(&stats.probes, probes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats.hits, hits, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats.stores, stores, __ATOMIC_RELAXED);
+}
+
+void tt_get_stats(TtStats* out) {
+    out->probes = __atomic_load_n(&stats.probes, __ATOMIC_RELAXED);
+    out->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+    out->stores = __atomic_load_n(&stats.stores, __ATOMIC_RELAXED);
+}
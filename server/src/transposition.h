@@ -0,0 +1,59 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- 置換表 ---
+// AI の探索で読んだ局面の評価値と最善手を、Zobrist ハッシュをキーに覚えておく
+// 固定サイズの表。全探索スレッドで共有し、ロックは取らない。
+// 各エントリはキーをデータと XOR して保存し、読み出し時にキーを照合する
+// (別スレッドの書き込みと混ざったエントリは照合に失敗して捨てられる)。
+// エントリは TT_BUCKET_SIZE 個ずつのバケット (64 バイト) にまとめ、
+// 1回の参照で触るキャッシュラインを1本にする。
+
+#define DEFAULT_TT_SIZE_MB 64  // 置換表の大きさ (既定値, MiB)
+#define TT_BUCKET_SIZE 4       // 1バケットのエントリ数
+
+// 評価値の種類
+#define TT_BOUND_EXACT 0  // 正確な値
+#define TT_BOUND_LOWER 1  // 下限 (βカットした)
+#define TT_BOUND_UPPER 2  // 上限 (どの手も alpha を超えなかった)
+
+#define TT_NO_MOVE 255  // 最善手なし
+
+// 参照結果
+typedef struct {
+    int score;
+    int depth;  // 何手読んだ値か
+    int bound;  // TT_BOUND_*
+    int move;   // 最善手 (TT_NO_MOVE なら無し)
+} TtResult;
+
+// 累計の参照回数 (ヒット率 = hits / probes)
+typedef struct {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+} TtStats;
+
+// 約 size_mb MiB の表を確保する (バケット数は2の冪に切り下げる)
+// 戻り値: 失敗時 -1
+int tt_init(size_t size_mb);
+
+// 新しい探索を始める (古い探索のエントリを置き換えやすくする)
+void tt_new_search(void);
+
+// key の局面を引く。戻り値: 見つかれば 1
+int tt_probe(uint64_t key, TtResult* result);
+
+// key の局面の探索結果を保存する
+void tt_store(uint64_t key, int depth, int bound, int score, int move);
+
+// 探索1回分の参照回数を累計に足す (探索の終わりにまとめて呼ぶ)
+void tt_add_stats(uint64_t probes, uint64_t hits, uint64_t stores);
+
+// 累計の参照回数を返す
+void tt_get_stats(TtStats* stats);
+
+#endif  // TRANSPOSITION_H
@@ -0,0 +1,256 @@
+// game_logic.c のマイクロベンチマークと perft
+// 乱数で打ち進めた局面の集合に対して is_valid_move・update_board・
+// has_valid_moves・check_game_over を単独で回し、1回あたりの時間を測る。
+// perft は初期局面から深さ depth までの全着手列 (パスも1手) を
+// update_board で打ち進めて数え、既知の値と照合する。
+// 使い方: make bench または ./bench_game_logic.out [-d depth] [-n positions]
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "game_logic.h"
+
+#define DEFAULT_PERFT_DEPTH 8
+#define MAX_PERFT_DEPTH 20
+#define DEFAULT_BENCH_POSITIONS 4096
+#define BENCH_MIN_NS 200000000ULL  // 1項目あたりこれ以上の時間を回して測る
+
+// 初期局面からの perft の既知の値 (深さ 1 から)
+static const uint64_t known_perft[] = {
+    4,    12,    56,     244,     1396,
+    8200, 55092, 390216, 3005288, 24571284, 212258800};
+#define KNOWN_PERFT_DEPTH ((int)(sizeof(known_perft) / sizeof(known_perft[0])))
+
+static volatile uint64_t sink;  // 測定対象の結果を捨てさせない
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// --- perft ---
+static uint64_t perft(const GameState* gs, int color, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    int opponent = (color == 1) ? 2 : 1;
+    Bitboard moves = get_legal_moves(gs, color);
+    if (moves == 0) {
+        if (!has_valid_moves(gs, opponent)) {
+            return 1;  // 終局 (それ以上は伸びない)
+        }
+        return perft(gs, opponent, depth - 1);  // パスも1手と数える
+    }
+    uint64_t nodes = 0;
+    for (; moves; moves &= moves - 1) {
+        int square = __builtin_ctzll(moves);
+        GameState next = *gs;
+        update_board(&next, color, square / BOARD_SIZE, square % BOARD_SIZE);
+        nodes += perft(&next, opponent, depth - 1);
+    }
+    return nodes;
+}
+
+// 深さ 1 から max_depth まで数えて照合する。戻り値: 食い違いの数
+static int run_perft(int max_depth) {
+    GameState root;
+    initialize_game_state(&root);
+    int mismatches = 0;
+    printf("perft (passes count as a ply):\n");
+    for (int depth = 1; depth <= max_depth; ++depth) {
+        uint64_t start = now_ns();
+        uint64_t nodes = perft(&root, 1, depth);
+        double sec = (now_ns() - start) / 1e9;
+        const char* verdict = "";
+        if (depth <= KNOWN_PERFT_DEPTH) {
+            if (nodes == known_perft[depth - 1]) {
+                verdict = "  ok";
+            } else {
+                verdict = "  MISMATCH";
+                ++mismatches;
+            }
+        }
+        printf("  depth %2d: %12" PRIu64 " leaves %9.3f s %12.0f leaves/s%s\n",
+               depth, nodes, sec, sec > 0 ? nodes / sec : 0.0, verdict);
+        if (depth <= KNOWN_PERFT_DEPTH && nodes != known_perft[depth - 1]) {
+            printf("    expected %" PRIu64 "\n", known_perft[depth - 1]);
+        }
+    }
+    return mismatches;
+}
+
+// --- 局面の集合 ---
+typedef struct {
+    GameState gs;
+    int color;   // 手番 (合法手がある側)
+    int square;  // update_board で打つ合法手
+} BenchPosition;
+
+// 固定の乱数で打ち進めた終局前の局面を count 個作る
+static BenchPosition* make_positions(int count) {
+    BenchPosition* positions = calloc(count, sizeof(BenchPosition));
+    if (positions == NULL) {
+        perror("Failed to allocate positions");
+        exit(EXIT_FAILURE);
+    }
+    unsigned int seed = 12345;
+    GameState gs;
+    int color = 1;
+    initialize_game_state(&gs);
+    for (int i = 0; i < count;) {
+        Bitboard moves = get_legal_moves(&gs, color);
+        if (moves == 0) {
+            color = (color == 1) ? 2 : 1;
+            if (!has_valid_moves(&gs, color)) {
+                initialize_game_state(&gs);  // 終局したら打ち直す
+                color = 1;
+            }
+            continue;
+        }
+        int pick = rand_r(&seed) % __builtin_popcountll(moves);
+        while (pick-- > 0) {
+            moves &= moves - 1;
+        }
+        int square = __builtin_ctzll(moves);
+        positions[i].gs = gs;
+        positions[i].color = color;
+        positions[i].square = square;
+        ++i;
+        update_board(&gs, color, square / BOARD_SIZE, square % BOARD_SIZE);
+        color = (color == 1) ? 2 : 1;
+    }
+    return positions;
+}
+
+// --- 各関数の計測 ---
+// 局面の集合を1周する関数。戻り値: 呼び出した回数
+typedef uint64_t (*BenchPass)(BenchPosition* positions, int count);
+
+static uint64_t pass_is_valid_move(BenchPosition* positions, int count) {
+    uint64_t acc = 0;
+    for (int i = 0; i < count; ++i) {
+        for (int sq = 0; sq < BOARD_SIZE * BOARD_SIZE; ++sq) {
+            acc += is_valid_move(&positions[i].gs, positions[i].color,
+                                 sq / BOARD_SIZE, sq % BOARD_SIZE);
+        }
+    }
+    sink = acc;
+    return (uint64_t)count * BOARD_SIZE * BOARD_SIZE;
+}
+
+// 局面のコピーも含む (呼び出し側と同じく元の局面は残す使い方)
+static uint64_t pass_update_board(BenchPosition* positions, int count) {
+    uint64_t acc = 0;
+    for (int i = 0; i < count; ++i) {
+        GameState next = positions[i].gs;
+        acc += update_board(&next, positions[i].color,
+                            positions[i].square / BOARD_SIZE,
+                            positions[i].square % BOARD_SIZE);
+    }
+    sink = acc;
+    return count;
+}
+
+static uint64_t pass_copy_only(BenchPosition* positions, int count) {
+    uint64_t acc = 0;
+    for (int i = 0; i < count; ++i) {
+        GameState next = positions[i].gs;
+        acc += next.move_seq;
+    }
+    sink = acc;
+    return count;
+}
+
+static uint64_t pass_has_valid_moves(BenchPosition* positions, int count) {
+    uint64_t acc = 0;
+    for (int i = 0; i < count; ++i) {
+        acc += has_valid_moves(&positions[i].gs, 1);
+        acc += has_valid_moves(&positions[i].gs, 2);
+    }
+    sink = acc;
+    return (uint64_t)count * 2;
+}
+
+// 集合は終局前の局面だけなので、終局時のログ出力は含まない
+static uint64_t pass_check_game_over(BenchPosition* positions, int count) {
+    uint64_t acc = 0;
+    for (int i = 0; i < count; ++i) {
+        acc += check_game_over(&positions[i].gs);
+    }
+    sink = acc;
+    return count;
+}
+
+// BENCH_MIN_NS 以上になるまで集合を回し、1回あたりの時間を表示する
+static void bench(const char* name, BenchPass pass, BenchPosition* positions,
+                  int count) {
+    uint64_t ops = 0;
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    do {
+        ops += pass(positions, count);
+        elapsed = now_ns() - start;
+    } while (elapsed < BENCH_MIN_NS);
+    double ns_per_op = (double)elapsed / ops;
+    printf("  %-18s %10.1f ns/op %14.0f ops/s\n", name, ns_per_op,
+           1e9 / ns_per_op);
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-d depth] [-n positions]\n"
+            "  -d, --depth      perft の深さ (0 で省略、既定: %d、"
+            "%d まで照合)\n"
+            "  -n, --positions  計測に使う局面の数 (既定: %d)\n",
+            prog, DEFAULT_PERFT_DEPTH, KNOWN_PERFT_DEPTH,
+            DEFAULT_BENCH_POSITIONS);
+}
+
+int main(int argc, char* argv[]) {
+    int depth = DEFAULT_PERFT_DEPTH;
+    int count = DEFAULT_BENCH_POSITIONS;
+
+    static const struct option long_options[] = {
+        {"depth", required_argument, NULL, 'd'},
+        {"positions", required_argument, NULL, 'n'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:n:h", long_options, NULL)) !=
+           -1) {
+        switch (opt) {
+            case 'd':
+                depth = atoi(optarg);
+                break;
+            case 'n':
+                count = atoi(optarg);
+                break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (depth < 0 || depth > MAX_PERFT_DEPTH || count < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    zobrist_init();
+
+    BenchPosition* positions = make_positions(count);
+    printf("game_logic on %d positions:\n", count);
+    bench("is_valid_move", pass_is_valid_move, positions, count);
+    bench("update_board", pass_update_board, positions, count);
+    bench("  (state copy)", pass_copy_only, positions, count);
+    bench("has_valid_moves", pass_has_valid_moves, positions, count);
+    bench("check_game_over", pass_check_game_over, positions, count);
+    free(positions);
+
+    int mismatches = depth > 0 ? run_perft(depth) : 0;
+    if (mismatches > 0) {
+        printf("perft: %d depth(s) differ from the known counts.\n",
+               mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,751 @@
+// 負荷試験用のクライアント
+// 指定数の接続を2つずつ組にして部屋を作成・参加・開始させ、合法手を
+// ランダムに打ち合う。着手の往復時間 (PLACE を送ってから自分の着手の
+// 通知が届くまで) を集計し、毎秒の着手数・接続の入れ替わりと、終了時に
+// p50/p99/p999 を表示する。
+// 使い方: ./load_gen.out -n 1000 -T 4 -d 30 (サーバーは -C/-R を十分大きく)
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+
+#include "game_logic.h"
+#include "histogram.h"
+#include "server_common.h"
+
+#define DEFAULT_LOAD_CONNECTIONS 100
+#define DEFAULT_LOAD_THREADS 1
+#define DEFAULT_LOAD_DURATION_SEC 10
+#define DEFAULT_LOAD_GAMES 1  // 1つの接続で続けて打つ局数 (再戦で続ける)
+#define LOAD_RETRY_MS 1000    // 接続・部屋作成に失敗した組をやり直すまで
+#define LOAD_INBUF_SIZE (MAX_FRAME_SIZE * 8)
+#define LOAD_OUTBUF_SIZE (MAX_FRAME_SIZE * 4)
+#define LOAD_MAX_EVENTS 256
+
+typedef enum {
+    BOT_CLOSED,   // 未接続 (組のやり直し待ち)
+    BOT_LOBBY,    // 接続済み、部屋なし
+    BOT_IN_ROOM,  // 部屋に入った (開始待ち)
+    BOT_PLAYING,  // 対局中
+    BOT_GAMEOVER  // 終局、再戦の提案待ち
+} BotState;
+
+// 接続1つ分。bots[2i] が部屋を作り、bots[2i + 1] が参加する
+typedef struct {
+    int fd;
+    uint32_t gen;  // 接続し直すたびに進める (古い epoll イベントを捨てる)
+    BotState state;
+    int roomId;
+    int color;
+    int games_left;
+    Bitboard black;
+    Bitboard white;
+    int seq;           // 手元の盤面に反映した着手番号
+    int syncing;       // 1 なら全盤面の再送待ち
+    int my_turn;       // 1 なら手番が来ていてまだ打っていない
+    int queued;        // 1 なら思考時間の待ち行列に入っている
+    uint64_t sent_ns;  // 着手を送った時刻 (0 なら返事待ちなし)
+    size_t in_len;
+    size_t out_len;
+    uint8_t in[LOAD_INBUF_SIZE];
+    uint8_t out[LOAD_OUTBUF_SIZE];
+} Bot;
+
+// 集計値 (スレッドごと。主スレッドが毎秒読むので __atomic で足す)
+typedef struct {
+    uint64_t moves;
+    uint64_t games;
+    uint64_t chats;
+    uint64_t connects;
+    uint64_t disconnects;
+    uint64_t invalid_moves;
+    uint64_t errors;
+} LoadStats;
+
+// 思考時間を待っている着手 (思考時間は一定なので追加順に期限が来る)
+typedef struct {
+    int bot;
+    uint32_t gen;
+    uint64_t due_ns;
+} PendingMove;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    int epfd;
+    Bot* bots;
+    int bot_count;
+    uint64_t* retry_at_ns;  // 組ごとのやり直し時刻 (0 ならやり直し不要)
+    int retry_pending;      // やり直し待ちの組の数
+    PendingMove* pending;   // bot_count 件のリングバッファ
+    int pending_head;
+    int pending_count;
+    unsigned int seed;
+    LoadStats stats;
+    uint64_t hist[HIST_BUCKETS];  // スレッドの終了後に主スレッドが合算する
+} LoadThread;
+
+// --- 設定 (起動後は変わらない) ---
+static struct sockaddr_in server_addr;
+static int think_ms = 0;
+static int chat_percent = 0;
+static int games_per_connection = DEFAULT_LOAD_GAMES;
+static volatile int stopping = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stat_add(uint64_t* counter, uint64_t n) {
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+// --- 送信 ---
+// 送り切れない分は送信バッファに残し、EPOLLOUT で続きを送る
+static int flush_bot(LoadThread* t, int index) {
+    Bot* bot = &t->bots[index];
+    size_t sent = 0;
+    while (sent < bot->out_len) {
+        ssize_t n = send(bot->fd, bot->out + sent, bot->out_len - sent,
+                         MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+    memmove(bot->out, bot->out + sent, bot->out_len - sent);
+    bot->out_len -= sent;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (bot->out_len > 0 ? EPOLLOUT : 0);
+    ev.data.u64 = ((uint64_t)bot->gen << 32) | (uint32_t)index;
+    epoll_ctl(t->epfd, EPOLL_CTL_MOD, bot->fd, &ev);
+    return 0;
+}
+
+static int send_bot(LoadThread* t, int index, const Message* msg) {
+    Bot* bot = &t->bots[index];
+    int n = encodeMessage(msg, bot->out + bot->out_len,
+                          sizeof(bot->out) - bot->out_len);
+    if (n < 0) {
+        return -1;  // 相手が読まずに送信バッファが溢れた
+    }
+    bot->out_len += n;
+    return flush_bot(t, index);
+}
+
+// --- 接続と組のやり直し ---
+static void close_bot(LoadThread* t, int index) {
+    Bot* bot = &t->bots[index];
+    if (bot->fd < 0) {
+        return;
+    }
+    close(bot->fd);  // epoll の監視からも外れる
+    bot->fd = -1;
+    bot->state = BOT_CLOSED;
+    stat_add(&t->stats.disconnects, 1);
+}
+
+static int connect_bot(LoadThread* t, int index) {
+    Bot* bot = &t->bots[index];
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) <
+        0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    bot->fd = fd;
+    ++bot->gen;
+    bot->state = BOT_LOBBY;
+    bot->roomId = -1;
+    bot->color = 0;
+    bot->games_left = games_per_connection;
+    bot->syncing = 0;
+    bot->my_turn = 0;
+    bot->queued = 0;
+    bot->sent_ns = 0;
+    bot->in_len = 0;
+    bot->out_len = 0;
+    stat_add(&t->stats.connects, 1);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t)bot->gen << 32) | (uint32_t)index;
+    if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close_bot(t, index);
+        return -1;
+    }
+
+    // 着手は差分通知で受け取る (実際のクライアントと同じ)
+    Message sync;
+    sync.type = MSG_BOARD_SYNC_REQUEST;
+    sync.data.boardSyncReq.roomId = -1;
+    sync.data.boardSyncReq.wantDelta = 1;
+    return send_bot(t, index, &sync);
+}
+
+// 組の2接続を閉じ、delay_ms 後につなぎ直す
+static void reset_pair(LoadThread* t, int pair, int delay_ms) {
+    close_bot(t, pair * 2);
+    close_bot(t, pair * 2 + 1);
+    if (t->retry_at_ns[pair] == 0) {
+        ++t->retry_pending;
+    }
+    t->retry_at_ns[pair] = now_ns() + (uint64_t)delay_ms * 1000000ULL;
+}
+
+// 組をつなぎ直し、作成側が部屋を作る
+static void start_pair(LoadThread* t, int pair) {
+    int creator = pair * 2;
+    if (connect_bot(t, creator) < 0 || connect_bot(t, creator + 1) < 0) {
+        stat_add(&t->stats.errors, 1);
+        reset_pair(t, pair, LOAD_RETRY_MS);
+        return;
+    }
+    Message create;
+    create.type = MSG_CREATE_ROOM_REQUEST;
+    snprintf(create.data.createRoomReq.roomName,
+             sizeof(create.data.createRoomReq.roomName), "load-%d-%d", t->id,
+             pair);
+    if (send_bot(t, creator, &create) < 0) {
+        reset_pair(t, pair, LOAD_RETRY_MS);
+    }
+}
+
+static void retry_pairs(LoadThread* t) {
+    uint64_t now = now_ns();
+    for (int pair = 0; pair < t->bot_count / 2 && t->retry_pending > 0;
+         ++pair) {
+        if (t->retry_at_ns[pair] != 0 && t->retry_at_ns[pair] <= now) {
+            t->retry_at_ns[pair] = 0;
+            --t->retry_pending;
+            start_pair(t, pair);
+        }
+    }
+}
+
+// --- 対局 ---
+static void play_random_move(LoadThread* t, int index) {
+    Bot* bot = &t->bots[index];
+    bot->my_turn = 0;
+    Bitboard own = (bot->color == 1) ? bot->black : bot->white;
+    Bitboard opp = (bot->color == 1) ? bot->white : bot->black;
+    Bitboard legal = bitboard_legal_moves(own, opp);
+    if (legal == 0) {
+        stat_add(&t->stats.errors, 1);  // 手元の盤面がずれている
+        return;
+    }
+    int pick = rand_r(&t->seed) % __builtin_popcountll(legal);
+    while (pick-- > 0) {
+        legal &= legal - 1;
+    }
+    int square = __builtin_ctzll(legal);
+
+    if (chat_percent > 0 && rand_r(&t->seed) % 100 < chat_percent) {
+        Message chat;
+        chat.type = MSG_CHAT_MESSAGE_SEND_REQUEST;
+        chat.data.chatMessageSendReq.roomId = bot->roomId;
+        snprintf(chat.data.chatMessageSendReq.message_text,
+                 sizeof(chat.data.chatMessageSendReq.message_text), "move %d",
+                 bot->seq + 1);
+        send_bot(t, index, &chat);
+        stat_add(&t->stats.chats, 1);
+    }
+
+    Message place;
+    place.type = MSG_PLACE_PIECE_REQUEST;
+    place.data.placePieceReq.roomId = bot->roomId;
+    place.data.placePieceReq.row = square / BOARD_SIZE;
+    place.data.placePieceReq.col = square % BOARD_SIZE;
+    bot->sent_ns = now_ns();
+    send_bot(t, index, &place);
+}
+
+// 手番が来たら思考時間の後に打つ (盤面の再送待ちなら届いてから)
+static void schedule_move(LoadThread* t, int index) {
+    Bot* bot = &t->bots[index];
+    bot->my_turn = 1;
+    if (bot->syncing || bot->queued) {
+        return;
+    }
+    if (think_ms == 0) {
+        play_random_move(t, index);
+        return;
+    }
+    int tail = (t->pending_head + t->pending_count) % t->bot_count;
+    t->pending[tail].bot = index;
+    t->pending[tail].gen = bot->gen;
+    t->pending[tail].due_ns = now_ns() + (uint64_t)think_ms * 1000000ULL;
+    ++t->pending_count;
+    bot->queued = 1;
+}
+
+// 期限の来た着手を打ち、次の期限までのミリ秒を返す (なければ -1)
+static int run_pending_moves(LoadThread* t) {
+    uint64_t now = now_ns();
+    while (t->pending_count > 0) {
+        PendingMove* p = &t->pending[t->pending_head];
+        if (p->due_ns > now) {
+            return (int)((p->due_ns - now) / 1000000ULL) + 1;
+        }
+        Bot* bot = &t->bots[p->bot];
+        t->pending_head = (t->pending_head + 1) % t->bot_count;
+        --t->pending_count;
+        if (bot->gen != p->gen || bot->state != BOT_PLAYING) {
+            continue;  // 待っている間に切断・終局した
+        }
+        bot->queued = 0;
+        if (bot->my_turn && !bot->syncing) {
+            play_random_move(t, p->bot);
+        }
+    }
+    return -1;
+}
+
+static void request_resync(LoadThread* t, int index) {
+    Bot* bot = &t->bots[index];
+    Message sync;
+    sync.type = MSG_BOARD_SYNC_REQUEST;
+    sync.data.boardSyncReq.roomId = bot->roomId;
+    sync.data.boardSyncReq.wantDelta = 1;
+    bot->syncing = 1;
+    send_bot(t, index, &sync);
+}
+
+// 自分の着手の通知が届いたら往復時間を記録する
+static void record_own_move(LoadThread* t, Bot* bot, int color) {
+    if (color != bot->color || bot->sent_ns == 0) {
+        return;
+    }
+    uint64_t us = (now_ns() - bot->sent_ns) / 1000;
+    bot->sent_ns = 0;
+    ++t->hist[hist_bucket(us)];
+    stat_add(&t->stats.moves, 1);
+}
+
+static void handle_message(LoadThread* t, int index, const Message* msg) {
+    Bot* bot = &t->bots[index];
+    int pair = index / 2;
+    int partner = index ^ 1;
+
+    switch (msg->type) {
+        case MSG_CREATE_ROOM_RESPONSE: {
+            if (!msg->data.createRoomResp.success) {
+                stat_add(&t->stats.errors, 1);  // 部屋数の上限など
+                reset_pair(t, pair, LOAD_RETRY_MS);
+                return;
+            }
+            bot->state = BOT_IN_ROOM;
+            bot->roomId = msg->data.createRoomResp.roomId;
+            Message join;
+            join.type = MSG_JOIN_ROOM_REQUEST;
+            join.data.joinRoomReq.roomId = bot->roomId;
+            send_bot(t, partner, &join);
+            break;
+        }
+        case MSG_JOIN_ROOM_RESPONSE: {
+            if (!msg->data.joinRoomResp.success) {
+                stat_add(&t->stats.errors, 1);
+                reset_pair(t, pair, LOAD_RETRY_MS);
+                return;
+            }
+            bot->state = BOT_IN_ROOM;
+            bot->roomId = msg->data.joinRoomResp.roomId;
+            Message start;
+            start.type = MSG_START_GAME_REQUEST;
+            start.data.startGameReq.roomId = bot->roomId;
+            send_bot(t, partner, &start);
+            break;
+        }
+        case MSG_GAME_START_NOTICE:
+            bot->state = BOT_PLAYING;
+            bot->color = msg->data.gameStartNotice.yourColor;
+            bot->black = SQUARE_BIT(3, 4) | SQUARE_BIT(4, 3);
+            bot->white = SQUARE_BIT(3, 3) | SQUARE_BIT(4, 4);
+            bot->seq = 0;
+            bot->syncing = 0;
+            bot->my_turn = 0;
+            bot->sent_ns = 0;
+            break;
+        case MSG_YOUR_TURN_NOTICE:
+            if (bot->state == BOT_PLAYING) {
+                schedule_move(t, index);
+            }
+            break;
+        case MSG_BOARD_DELTA_NOTICE: {
+            const BoardDeltaNoticeData* d = &msg->data.boardDeltaNotice;
+            record_own_move(t, bot, d->playerColor);
+            if (bot->syncing) {
+                break;  // 全盤面の再送で追いつく
+            }
+            if (d->seq != bot->seq + 1) {
+                request_resync(t, index);
+                break;
+            }
+            Bitboard placed = SQUARE_BIT(d->row, d->col);
+            if (d->playerColor == 1) {
+                bot->black |= placed | d->flips;
+                bot->white &= ~d->flips;
+            } else {
+                bot->white |= placed | d->flips;
+                bot->black &= ~d->flips;
+            }
+            bot->seq = d->seq;
+            break;
+        }
+        case MSG_UPDATE_BOARD_NOTICE: {
+            const UpdateBoardNoticeData* u = &msg->data.updateBoardNotice;
+            if (u->playerColor != 0) {
+                record_own_move(t, bot, u->playerColor);
+            }
+            bot->black = 0;
+            bot->white = 0;
+            for (int r = 0; r < BOARD_SIZE; ++r) {
+                for (int c = 0; c < BOARD_SIZE; ++c) {
+                    if (u->board[r][c] == 1) {
+                        bot->black |= SQUARE_BIT(r, c);
+                    } else if (u->board[r][c] == 2) {
+                        bot->white |= SQUARE_BIT(r, c);
+                    }
+                }
+            }
+            bot->seq = u->seq;
+            if (bot->syncing) {
+                bot->syncing = 0;
+                if (bot->my_turn && bot->sent_ns == 0) {
+                    schedule_move(t, index);
+                }
+            }
+            break;
+        }
+        case MSG_INVALID_MOVE_NOTICE:
+            // 盤面がずれていたので取り直してから打ち直す
+            stat_add(&t->stats.invalid_moves, 1);
+            bot->sent_ns = 0;
+            bot->my_turn = 1;
+            request_resync(t, index);
+            break;
+        case MSG_GAME_OVER_NOTICE:
+            bot->state = BOT_GAMEOVER;
+            bot->my_turn = 0;
+            --bot->games_left;
+            if (t->bots[partner].state != BOT_GAMEOVER) {
+                stat_add(&t->stats.games, 1);  // 先に届いた側だけが数える
+            }
+            break;
+        case MSG_REMATCH_OFFER_NOTICE:
+            if (bot->games_left > 0) {
+                Message rematch;
+                rematch.type = MSG_REMATCH_REQUEST;
+                rematch.data.rematchReq.roomId = bot->roomId;
+                rematch.data.rematchReq.agree = 1;
+                send_bot(t, index, &rematch);
+            } else {
+                reset_pair(t, pair, 0);  // 接続ごと入れ替える
+            }
+            break;
+        case MSG_REMATCH_RESULT_NOTICE:
+            if (msg->data.rematchResultNotice.result != 1) {
+                reset_pair(t, pair, 0);
+            }
+            break;
+        case MSG_ROOM_CLOSED_NOTICE:
+            reset_pair(t, pair, 0);
+            break;
+        case MSG_ERROR_NOTICE:
+            stat_add(&t->stats.errors, 1);
+            break;
+        default:
+            break;  // チャットの配信や参加通知は読み捨てる
+    }
+}
+
+// 受信できるだけ読み、フレームごとに処理する
+static void read_bot(LoadThread* t, int index) {
+    Bot* bot = &t->bots[index];
+    uint32_t gen = bot->gen;
+    for (;;) {
+        ssize_t n =
+            recv(bot->fd, bot->in + bot->in_len, sizeof(bot->in) - bot->in_len,
+                 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                       errno != EINTR)) {
+            reset_pair(t, index / 2, LOAD_RETRY_MS);  // サーバーが切った
+            return;
+        }
+        if (n < 0) {
+            return;
+        }
+        bot->in_len += n;
+
+        size_t off = 0;
+        Message msg;
+        int used;
+        while ((used = decodeMessage(bot->in + off, bot->in_len - off,
+                                     &msg)) > 0) {
+            off += used;
+            handle_message(t, index, &msg);
+            if (bot->gen != gen || bot->fd < 0) {
+                return;  // 処理中に組ごと閉じた
+            }
+        }
+        if (used < 0) {
+            stat_add(&t->stats.errors, 1);
+            reset_pair(t, index / 2, LOAD_RETRY_MS);
+            return;
+        }
+        memmove(bot->in, bot->in + off, bot->in_len - off);
+        bot->in_len -= off;
+    }
+}
+
+static void* load_thread(void* arg) {
+    LoadThread* t = arg;
+    for (int pair = 0; pair < t->bot_count / 2; ++pair) {
+        start_pair(t, pair);
+    }
+
+    struct epoll_event events[LOAD_MAX_EVENTS];
+    while (!stopping) {
+        int timeout = run_pending_moves(t);
+        if (timeout < 0 || timeout > 100) {
+            timeout = 100;  // やり直しと終了の確認
+        }
+        int n = epoll_wait(t->epfd, events, LOAD_MAX_EVENTS, timeout);
+        for (int i = 0; i < n; ++i) {
+            int index = (int)(uint32_t)events[i].data.u64;
+            uint32_t gen = (uint32_t)(events[i].data.u64 >> 32);
+            Bot* bot = &t->bots[index];
+            if (bot->fd < 0 || bot->gen != gen) {
+                continue;  // 同じバッチ内で閉じた接続
+            }
+            if (events[i].events & EPOLLOUT) {
+                if (flush_bot(t, index) < 0) {
+                    reset_pair(t, index / 2, LOAD_RETRY_MS);
+                    continue;
+                }
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                read_bot(t, index);
+            }
+        }
+        if (t->retry_pending > 0) {
+            retry_pairs(t);
+        }
+    }
+
+    for (int i = 0; i < t->bot_count; ++i) {
+        close_bot(t, i);
+    }
+    return NULL;
+}
+
+static void sum_stats(const LoadThread* threads, int count, LoadStats* out) {
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < count; ++i) {
+        const LoadStats* s = &threads[i].stats;
+        out->moves += __atomic_load_n(&s->moves, __ATOMIC_RELAXED);
+        out->games += __atomic_load_n(&s->games, __ATOMIC_RELAXED);
+        out->chats += __atomic_load_n(&s->chats, __ATOMIC_RELAXED);
+        out->connects += __atomic_load_n(&s->connects, __ATOMIC_RELAXED);
+        out->disconnects += __atomic_load_n(&s->disconnects, __ATOMIC_RELAXED);
+        out->invalid_moves +=
+            __atomic_load_n(&s->invalid_moves, __ATOMIC_RELAXED);
+        out->errors += __atomic_load_n(&s->errors, __ATOMIC_RELAXED);
+    }
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-s host] [-p port] [-n connections] [-T threads] "
+            "[-d seconds] [-k think_ms] [-c chat_percent] [-g games]\n"
+            "  -s, --server       サーバーのアドレス (既定: 127.0.0.1)\n"
+            "  -p, --port         サーバーのポート (既定: %d)\n"
+            "  -n, --connections  同時接続数、2つで1部屋 (既定: %d)\n"
+            "  -T, --threads      負荷をかけるスレッド数 (既定: %d)\n"
+            "  -d, --duration     計測する秒数 (既定: %d)\n"
+            "  -k, --think-ms     手番が来てから打つまでの時間 (既定: 0)\n"
+            "  -c, --chat         1手ごとにチャットを送る確率 %% (既定: 0)\n"
+            "  -g, --games        接続し直すまでに再戦で続ける局数 "
+            "(既定: %d)\n",
+            prog, SERVER_PORT, DEFAULT_LOAD_CONNECTIONS, DEFAULT_LOAD_THREADS,
+            DEFAULT_LOAD_DURATION_SEC, DEFAULT_LOAD_GAMES);
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = "127.0.0.1";
+    int port = SERVER_PORT;
+    int connections = DEFAULT_LOAD_CONNECTIONS;
+    int thread_count = DEFAULT_LOAD_THREADS;
+    int duration = DEFAULT_LOAD_DURATION_SEC;
+
+    static const struct option long_options[] = {
+        {"server", required_argument, NULL, 's'},
+        {"port", required_argument, NULL, 'p'},
+        {"connections", required_argument, NULL, 'n'},
+        {"threads", required_argument, NULL, 'T'},
+        {"duration", required_argument, NULL, 'd'},
+        {"think-ms", required_argument, NULL, 'k'},
+        {"chat", required_argument, NULL, 'c'},
+        {"games", required_argument, NULL, 'g'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:p:n:T:d:k:c:g:h", long_options,
+                              NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                host = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'n':
+                connections = atoi(optarg);
+                break;
+            case 'T':
+                thread_count = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'k':
+                think_ms = atoi(optarg);
+                break;
+            case 'c':
+                chat_percent = atoi(optarg);
+                break;
+            case 'g':
+                games_per_connection = atoi(optarg);
+                break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (port <= 0 || port > 65535 || connections < 2 || thread_count < 1 ||
+        duration < 1 || think_ms < 0 || chat_percent < 0 ||
+        chat_percent > 100 || games_per_connection < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0) {
+        fprintf(stderr, "Cannot resolve %s.\n", host);
+        return 1;
+    }
+    memcpy(&server_addr, res->ai_addr, sizeof(server_addr));
+    server_addr.sin_port = htons(port);
+    freeaddrinfo(res);
+
+    // 組 (2接続) をスレッドに均等に振り分ける
+    int pairs = connections / 2;
+    if (thread_count > pairs) {
+        thread_count = pairs;
+    }
+    LoadThread* threads = calloc(thread_count, sizeof(LoadThread));
+    if (threads == NULL) {
+        perror("Failed to allocate load threads");
+        return 1;
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        LoadThread* t = &threads[i];
+        int my_pairs = pairs / thread_count + (i < pairs % thread_count);
+        t->id = i;
+        t->bot_count = my_pairs * 2;
+        t->bots = calloc(t->bot_count, sizeof(Bot));
+        t->retry_at_ns = calloc(my_pairs, sizeof(uint64_t));
+        t->pending = calloc(t->bot_count, sizeof(PendingMove));
+        t->epfd = epoll_create1(EPOLL_CLOEXEC);
+        t->seed = (unsigned int)now_ns() ^ (i * 2654435761u);
+        if (t->bots == NULL || t->retry_at_ns == NULL || t->pending == NULL ||
+            t->epfd < 0) {
+            perror("Failed to set up load thread");
+            return 1;
+        }
+        for (int b = 0; b < t->bot_count; ++b) {
+            t->bots[b].fd = -1;
+        }
+    }
+    printf("Load: %d connection(s) in %d room(s) on %d thread(s) against "
+           "%s:%d for %d s.\n",
+           pairs * 2, pairs, thread_count, host, port, duration);
+
+    uint64_t started = now_ns();
+    for (int i = 0; i < thread_count; ++i) {
+        if (pthread_create(&threads[i].thread, NULL, load_thread,
+                           &threads[i]) != 0) {
+            perror("Failed to create load thread");
+            return 1;
+        }
+    }
+
+    // 毎秒の増分を表示する
+    LoadStats prev, cur;
+    memset(&prev, 0, sizeof(prev));
+    for (int sec = 1; sec <= duration; ++sec) {
+        sleep(1);
+        sum_stats(threads, thread_count, &cur);
+        printf("[%3ds] moves %6" PRIu64 "/s  games %5" PRIu64
+               "/s  connects %5" PRIu64 "/s  disconnects %5" PRIu64
+               "/s  errors %" PRIu64 "\n",
+               sec, cur.moves - prev.moves, cur.games - prev.games,
+               cur.connects - prev.connects,
+               cur.disconnects - prev.disconnects, cur.errors);
+        fflush(stdout);
+        prev = cur;
+    }
+    stopping = 1;
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    double elapsed = (now_ns() - started) / 1e9;
+
+    // 各スレッドのヒストグラムを合算して結果を表示する
+    static uint64_t hist[HIST_BUCKETS];
+    for (int i = 0; i < thread_count; ++i) {
+        for (int b = 0; b < HIST_BUCKETS; ++b) {
+            hist[b] += threads[i].hist[b];
+        }
+    }
+    sum_stats(threads, thread_count, &cur);
+    printf("Total: %" PRIu64 " moves (%.0f/s), %" PRIu64 " games, %" PRIu64
+           " chats in %.1f s.\n",
+           cur.moves, cur.moves / elapsed, cur.games, cur.chats, elapsed);
+    printf("Churn: %" PRIu64 " connects, %" PRIu64
+           " disconnects (%.1f/s).\n",
+           cur.connects, cur.disconnects,
+           (cur.connects + cur.disconnects) / elapsed);
+    if (cur.moves > 0) {
+        printf("Move round trip: p50 %" PRIu64 " us, p99 %" PRIu64
+               " us, p999 %" PRIu64 " us, max %" PRIu64 " us.\n",
+               hist_percentile(hist, cur.moves, 0.50),
+               hist_percentile(hist, cur.moves, 0.99),
+               hist_percentile(hist, cur.moves, 0.999), hist_max(hist));
+    }
+    printf("Errors: %" PRIu64 " (invalid moves %" PRIu64 ").\n", cur.errors,
+           cur.invalid_moves);
+    return cur.errors > 0 ? 1 : 0;
+}
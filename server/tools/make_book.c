@@ -0,0 +1,167 @@
+// 定石ファイルの作成ツール
+// 初期局面から指定手数までに現れる全局面を ai_search で読み、最善手を
+// book.c の形式で書き出す。サーバーの -B/--book に渡して使う。
+#include <getopt.h>
+
+#include "ai_eval.h"
+#include "ai_search.h"
+#include "book.h"
+#include "transposition.h"
+
+#define DEFAULT_BOOK_PLIES 4       // 定石に入れる手数 (既定値)
+#define DEFAULT_BOOK_MOVE_MS 100   // 1局面あたりの思考時間 (既定値)
+#define DEFAULT_BOOK_PATH "opening_book.bin"
+
+// 定石に入れる局面 (手番 color)
+typedef struct {
+    Bitboard black;
+    Bitboard white;
+    int color;
+    uint64_t key;  // 手番込みのハッシュ
+} BookPosition;
+
+static BookPosition* positions = NULL;
+static size_t position_count = 0;
+static size_t position_capacity = 0;
+
+static void add_position(Bitboard black, Bitboard white, int color) {
+    if (position_count == position_capacity) {
+        position_capacity = position_capacity ? position_capacity * 2 : 1024;
+        positions =
+            realloc(positions, position_capacity * sizeof(BookPosition));
+        if (positions == NULL) {
+            perror("Failed to allocate positions");
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint64_t key = zobrist_hash(black, white);
+    if (color == 2) {
+        key ^= zobrist_side_key;
+    }
+    positions[position_count++] = (BookPosition){black, white, color, key};
+}
+
+// 手番 color の局面から plies 手先までの局面をすべて集める
+static void collect(Bitboard black, Bitboard white, int color, int plies) {
+    Bitboard player = (color == 1) ? black : white;
+    Bitboard opponent = (color == 1) ? white : black;
+    Bitboard moves = bitboard_legal_moves(player, opponent);
+    if (moves == 0) {
+        return;  // 序盤でパスは起きないので打ち切る
+    }
+    add_position(black, white, color);
+    if (plies == 0) {
+        return;
+    }
+    for (; moves; moves &= moves - 1) {
+        int sq = __builtin_ctzll(moves);
+        Bitboard flips = bitboard_flips(player, opponent, sq);
+        Bitboard next_player = player | flips | ((Bitboard)1 << sq);
+        Bitboard next_opponent = opponent & ~flips;
+        if (color == 1) {
+            collect(next_player, next_opponent, 2, plies - 1);
+        } else {
+            collect(next_opponent, next_player, 1, plies - 1);
+        }
+    }
+}
+
+static int compare_positions(const void* a, const void* b) {
+    uint64_t ka = ((const BookPosition*)a)->key;
+    uint64_t kb = ((const BookPosition*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-p plies] [-t move_ms] [-o path]\n"
+            "  -p, --plies    定石に入れる手数 (既定: %d)\n"
+            "  -t, --move-ms  1局面あたりの思考時間 (既定: %d)\n"
+            "  -o, --output   出力ファイル (既定: %s)\n",
+            prog, DEFAULT_BOOK_PLIES, DEFAULT_BOOK_MOVE_MS, DEFAULT_BOOK_PATH);
+}
+
+int main(int argc, char* argv[]) {
+    int plies = DEFAULT_BOOK_PLIES;
+    int move_ms = DEFAULT_BOOK_MOVE_MS;
+    const char* path = DEFAULT_BOOK_PATH;
+
+    static const struct option long_options[] = {
+        {"plies", required_argument, NULL, 'p'},
+        {"move-ms", required_argument, NULL, 't'},
+        {"output", required_argument, NULL, 'o'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:t:o:h", long_options, NULL)) !=
+           -1) {
+        switch (opt) {
+            case 'p':
+                plies = atoi(optarg);
+                break;
+            case 't':
+                move_ms = atoi(optarg);
+                break;
+            case 'o':
+                path = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (plies < 0 || move_ms < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    zobrist_init();
+    ai_eval_init();
+    if (tt_init(DEFAULT_TT_SIZE_MB) < 0) {
+        return 1;
+    }
+
+    GameState gs;
+    initialize_game_state(&gs);
+    collect(gs.black, gs.white, 1, plies);
+
+    // 手順違いで同じ局面になったものは1つにまとめる
+    qsort(positions, position_count, sizeof(BookPosition), compare_positions);
+    BookEntry* entries = malloc(position_count * sizeof(BookEntry));
+    if (entries == NULL) {
+        perror("Failed to allocate book entries");
+        return 1;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < position_count; ++i) {
+        if (count > 0 && entries[count - 1].key == positions[i].key) {
+            continue;
+        }
+        const BookPosition* pos = &positions[i];
+        Bitboard player = (pos->color == 1) ? pos->black : pos->white;
+        Bitboard opponent = (pos->color == 1) ? pos->white : pos->black;
+        AiSearchResult result;
+        ai_search(player, opponent, pos->color,
+                  zobrist_hash(pos->black, pos->white), move_ms, &result);
+
+        BookEntry* e = &entries[count++];
+        memset(e, 0, sizeof(*e));
+        e->key = pos->key;
+        e->score = (int16_t)result.score;
+        e->move = (uint8_t)result.move;
+        e->depth = (uint8_t)result.depth;
+        if (count % 100 == 0) {
+            printf("%zu positions searched...\n", count);
+        }
+    }
+
+    if (book_write(path, entries, count) < 0) {
+        return 1;
+    }
+    printf("Wrote %zu positions (up to %d plies) to %s.\n", count, plies,
+           path);
+    free(entries);
+    free(positions);
+    return 0;
+}
@@ -0,0 +1,96 @@
+// 棋譜ログの確認ツール
+// game_log.c の形式のファイルを先頭から読み、1局ずつ初期局面から着手を
+// 再生して合法性と最終的な石数を確かめ、棋譜を表示する。
+// 使い方: ./show_game_log.out game_log.bin
+#include "game_log.h"
+#include "game_logic.h"
+
+static const char* end_reason_name(int reason) {
+    switch (reason) {
+        case GAME_LOG_END_NORMAL:
+            return "normal";
+        case GAME_LOG_END_TIMEOUT:
+            return "timeout";
+        case GAME_LOG_END_DISCONNECT:
+            return "disconnect";
+        default:
+            return "unknown";
+    }
+}
+
+static const char* winner_name(int winner) {
+    switch (winner) {
+        case 1:
+            return "black";
+        case 2:
+            return "white";
+        case 3:
+            return "draw";
+        default:
+            return "none";
+    }
+}
+
+// 棋譜を初期局面から再生し、最終的な石数と照らし合わせる
+// 戻り値: 一致すれば 0、非合法手や石数の食い違いがあれば -1
+static int replay(const GameLogRecord* rec) {
+    GameState gs;
+    if (replay_moves(&gs, rec->moves, rec->move_count) < 0) {
+        fprintf(stderr, "  contains an illegal move.\n");
+        return -1;
+    }
+    if (gs.black_count != rec->black_count ||
+        gs.white_count != rec->white_count) {
+        fprintf(stderr, "  final counts differ from replay (%d-%d).\n",
+                gs.black_count, gs.white_count);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s game_log\n", argv[0]);
+        return 1;
+    }
+    FILE* fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        perror("Failed to open game log");
+        return 1;
+    }
+    zobrist_init();
+
+    GameLogRecord rec;
+    int games = 0;
+    int bad = 0;
+    int ret;
+    while ((ret = game_log_read(fp, &rec)) == 1) {
+        ++games;
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S",
+                 localtime(&rec.ended_at));
+        printf("#%d room %d %s %s, winner %s, black %d - white %d%s\n", games,
+               rec.roomId, when, end_reason_name(rec.end_reason),
+               winner_name(rec.winner), rec.black_count, rec.white_count,
+               (rec.flags & GAME_LOG_FLAG_WHITE_AI) ? " (white: AI)" : "");
+        printf("  ");
+        for (int i = 0; i < rec.move_count; ++i) {
+            printf("%c%d", 'a' + rec.moves[i] % BOARD_SIZE,
+                   rec.moves[i] / BOARD_SIZE + 1);
+        }
+        printf("\n");
+        if (replay(&rec) < 0) {
+            ++bad;
+        }
+    }
+    if (ret < 0) {
+        // 書き込み中に停止した場合は末尾のレコードが途中で切れている
+        fprintf(stderr,
+                "Stopped at a truncated or corrupt record after %d "
+                "game(s).\n",
+                games);
+    }
+    fclose(fp);
+    printf("%d game(s), %d inconsistent.\n", games, bad);
+    return (ret < 0 || bad > 0) ? 1 : 0;
+}